@@ -0,0 +1,975 @@
+/*
+ * bench.c — benchmark harness for sessionsnap, run with `make bench`
+ * talks to: capture.c, session.c (save/load in both formats), restore.c, procinfo.c, history.c, filter.c,
+ * writer.c (the daemon's save path), prefetch.c (cold-cache launches),
+ * winlist.c (synthetic lists), xenv.c (headless X), counters.c (allocations, round trips)
+ * imports: time.h for CLOCK_MONOTONIC, unistd/fcntl to keep sessionsnap chatter off stdout, dirent for /proc
+ * functions: main(), bench_capture(), bench_save(), bench_load(), bench_restore(),
+ * bench_proc_cache(), bench_history(), bench_filter(), bench_daemon_tick(), bench_cold_launch(),
+ * bench_cold_restore(), build_list(), report(), check_json_roundtrip(), check_history_roundtrip(),
+ * check_daemon_tick()
+ * output: one JSON object on stdout so CI can diff runs. capture and restore need Xvfb
+ * and are listed under "skipped" when it isn't installed.
+ * --check (make check) runs only the correctness checks and exits 1 if any of them fails.
+ * a full run also exits 1 if a warm daemon_tick allocated.
+ */
+
+#include "../include/capture.h"
+#include "../include/session.h"
+#include "../include/restore.h"
+#include "../include/procinfo.h"
+#include "../include/history.h"
+#include "../include/filter.h"
+#include "../include/writer.h"
+#include "../include/prefetch.h"
+#include "counters.h"
+#include "xenv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <ctype.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+#define LOAD_ITERATIONS 200
+#define SAVE_ITERATIONS 50
+#define CAPTURE_ITERATIONS 50
+#define RESTORE_ITERATIONS 5
+#define PROC_ITERATIONS 50
+#define FILTER_ITERATIONS 100
+#define FILTER_WINDOWS 1000
+#define TICK_ITERATIONS 50
+/* enough ticks for every pool and buffer on the save path to reach its working size */
+#define TICK_WARMUP 8
+/* distinct uncached binaries launched together by the cold-cache benchmarks */
+#define COLD_APPS 10
+#define COLD_ITERATIONS 5
+#define MAX_PIDS 4096
+#define CLIENT_START_TIMEOUT_MS 30000
+/* a week of one save a minute, on a desktop of HISTORY_WINDOWS windows */
+#define HISTORY_ENTRIES (7 * 24 * 60)
+#define HISTORY_WINDOWS 30
+
+static const int sizes[] = { 10, 100, 1000 };
+#define SIZE_COUNT (int)(sizeof(sizes) / sizeof(sizes[0]))
+
+/* filter rules on top of the built-in ones, the check should cost the same for each */
+static const int rule_counts[] = { 0, 100, 1000 };
+#define RULE_COUNT_COUNT (int)(sizeof(rule_counts) / sizeof(rule_counts[0]))
+
+static char self_exe[PATH_MAX];
+
+typedef struct {
+    double samples[LOAD_ITERATIONS];
+    int n;
+    BenchCounters start;
+    BenchCounters total;
+} Run;
+
+static double now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e6 + (double)ts.tv_nsec / 1e3;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(double *samples, int n, double p) {
+    qsort(samples, (size_t)n, sizeof(double), cmp_double);
+    int idx = (int)(p * (n - 1) + 0.5);
+    return samples[idx];
+}
+
+/* save_session() and restore report progress on stdout, which would corrupt the JSON report */
+static int mute_stdout(void) {
+    fflush(stdout);
+    int saved = dup(STDOUT_FILENO);
+    int null = open("/dev/null", O_WRONLY);
+    dup2(null, STDOUT_FILENO);
+    close(null);
+    return saved;
+}
+
+static void unmute_stdout(int saved) {
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+/* timing and counters bracket exactly the operation being measured */
+static void run_begin(Run *run, double *t0) {
+    read_counters(&run->start);
+    *t0 = now_us();
+}
+
+static void run_end(Run *run, double t0) {
+    double elapsed = now_us() - t0;
+    BenchCounters end;
+    read_counters(&end);
+
+    run->samples[run->n++] = elapsed;
+    run->total.allocs += end.allocs - run->start.allocs;
+    run->total.round_trips += end.round_trips - run->start.round_trips;
+}
+
+/* a list shaped like a real desktop: browser/editor/terminal style argv and titles */
+static WindowList *build_list(int n) {
+    WindowList *list = new_window_list();
+    if (!list) return NULL;
+
+    for (int i = 0; i < n; i++) {
+        WindowInfo *w = add_window(list);
+        if (!w) break;
+
+        char buf[256];
+        w->window_id = 0x3a00000u + (uint64_t)i;
+        w->pid = 10000 + i;
+        w->x = (i * 37) % 1920;
+        w->y = (i * 23) % 1080;
+        w->width = 800 + i % 400;
+        w->height = 600 + i % 300;
+        w->desktop = i % 6;
+        w->is_maximized = i % 5 == 0;
+
+        int len = snprintf(buf, sizeof(buf), "Document %d — \"notes\" — Editor", i);
+        w->title = store_string(list, buf, (size_t)len);
+        len = snprintf(buf, sizeof(buf), "/usr/lib/app%d/app%d", i % 20, i % 20);
+        w->exe_path = store_string(list, buf, (size_t)len);
+
+        add_window_arg(list, w, buf, (size_t)len);
+        add_window_arg(list, w, "--new-window", 12);
+        add_window_arg(list, w, "--profile-directory=Default", 27);
+        len = snprintf(buf, sizeof(buf), "/home/user/projects/project-%d/src/main.c", i);
+        add_window_arg(list, w, buf, (size_t)len);
+    }
+    return list;
+}
+
+/* reads every field so lazily mapped pages are actually touched */
+static long touch_list(const WindowList *list) {
+    long sum = 0;
+    for (int i = 0; i < list->count; i++) {
+        const WindowInfo *w = &list->windows[i];
+        sum += w->x + w->y + w->width + w->height + window_title(list, w)[0];
+        for (int j = 0; j < w->cmd_argc; j++) sum += window_arg(list, w, j)[0];
+    }
+    return sum;
+}
+
+/* a window whose strings need every kind of escaping, on a negative position */
+static void add_awkward_window(WindowList *list) {
+    static const char *title = "\"quoted\" \\back\\slash\\ \x01\x1f\t\n\r\b\f\x7f / "
+        "Ünïcødé — 日本語 🎉";
+    WindowInfo *w = add_window(list);
+    w->pid = 4242;
+    w->x = -1920;
+    w->y = -1;
+    w->width = 1;
+    w->height = 2147483647;
+    w->desktop = -1;
+    w->is_minimized = 1;
+    w->title = store_string(list, title, strlen(title));
+    w->exe_path = store_string(list, "/opt/ä app/bin/\"x\"", strlen("/opt/ä app/bin/\"x\""));
+    w->wm_class = store_string(list, "Ünï\tClass", strlen("Ünï\tClass"));
+    w->cwd = store_string(list, "/home/ü/dir with \"quotes\"", strlen("/home/ü/dir with \"quotes\""));
+
+    static const char *args[] = { "/opt/ä app/bin/\"x\"", "", "--title=a\\b\"c", "\x02\n" };
+    for (int i = 0; i < 4; i++) add_window_arg(list, w, args[i], strlen(args[i]));
+    add_window_job_arg(list, w, "vim", 3);
+    add_window_job_arg(list, w, "naïve \"file\".txt", strlen("naïve \"file\".txt"));
+    add_window_map(list, w, "/usr/lib/libü.so.1", strlen("/usr/lib/libü.so.1"));
+
+    /* and one with nothing in any of its lists */
+    w = add_window(list);
+    w->x = -5;
+    w->y = -7;
+}
+
+static int same_string(const char *what, int window, const char *a, const char *b) {
+    if (strcmp(a, b) == 0) return 1;
+    fprintf(stderr, "sessionsnap-bench: window %d: %s \"%s\" came back as \"%s\"\n", window, what, a, b);
+    return 0;
+}
+
+/* field by field, returns the number of mismatches */
+static int compare_lists(const WindowList *a, const WindowList *b) {
+    if (a->count != b->count) {
+        fprintf(stderr, "sessionsnap-bench: %d windows came back as %d\n", a->count, b->count);
+        return 1;
+    }
+
+    int bad = 0;
+    for (int i = 0; i < a->count; i++) {
+        const WindowInfo *x = &a->windows[i];
+        const WindowInfo *y = &b->windows[i];
+        if (x->pid != y->pid || x->x != y->x || x->y != y->y || x->width != y->width ||
+            x->height != y->height || x->desktop != y->desktop ||
+            x->is_maximized != y->is_maximized || x->is_minimized != y->is_minimized) {
+            fprintf(stderr, "sessionsnap-bench: window %d: pid, geometry, desktop or state differs\n", i);
+            bad++;
+        }
+        bad += !same_string("title", i, window_title(a, x), window_title(b, y));
+        bad += !same_string("exe_path", i, window_exe_path(a, x), window_exe_path(b, y));
+        bad += !same_string("wm_class", i, window_wm_class(a, x), window_wm_class(b, y));
+        bad += !same_string("cwd", i, window_cwd(a, x), window_cwd(b, y));
+
+        if (x->cmd_argc != y->cmd_argc || x->job_argc != y->job_argc || x->map_count != y->map_count) {
+            fprintf(stderr, "sessionsnap-bench: window %d: cmd, job or maps length differs\n", i);
+            bad++;
+            continue;
+        }
+        for (int j = 0; j < x->cmd_argc; j++) bad += !same_string("cmd", i, window_arg(a, x, j), window_arg(b, y, j));
+        for (int j = 0; j < x->job_argc; j++) {
+            bad += !same_string("job", i, window_job_arg(a, x, j), window_job_arg(b, y, j));
+        }
+        for (int j = 0; j < x->map_count; j++) bad += !same_string("maps", i, window_map(a, x, j), window_map(b, y, j));
+    }
+    return bad;
+}
+
+/* --export then --import must give back exactly what was saved, returns 0 if it does */
+static int check_json_roundtrip(const char *dir) {
+    WindowList *cases[3] = { new_window_list(), new_window_list(), build_list(100) };
+    static const char *names[3] = { "awkward strings", "empty list", "100 windows" };
+    if (cases[0]) add_awkward_window(cases[0]);
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/roundtrip.json", dir);
+
+    int failed = 0;
+    for (int c = 0; c < 3; c++) {
+        WindowList *back = NULL;
+        int bad = 1;
+        if (cases[c] && save_session_json(cases[c], path) == 0 && (back = load_session_json(path))) {
+            bad = compare_lists(cases[c], back);
+        }
+        fprintf(stderr, "sessionsnap-bench: json round trip, %s: %s\n", names[c], bad ? "FAIL" : "ok");
+        failed += bad != 0;
+        free_window_list(back);
+        free_window_list(cases[c]);
+    }
+    return failed ? -1 : 0;
+}
+
+/*
+ * the list after cur for the history check: windows close, move, get retitled, lose their
+ * id, swap order, and new ones open with a fresh id, no id or one that's already taken
+ */
+static WindowList *next_history_list(const WindowList *cur, unsigned *seed, uint64_t *fresh_id) {
+    WindowList *next = new_window_list();
+    if (!next) return NULL;
+
+    int reverse = rand_r(seed) % 10 == 0;
+    for (int k = 0; k < cur->count; k++) {
+        const WindowInfo *from = &cur->windows[reverse ? cur->count - 1 - k : k];
+        if (rand_r(seed) % 10 == 0) continue;
+
+        WindowInfo *w = copy_window(next, cur, from);
+        if (!w) break;
+        if (rand_r(seed) % 4 == 0) w->x = rand_r(seed) % 1920;
+        if (rand_r(seed) % 20 == 0) w->window_id = 0;
+        if (rand_r(seed) % 8 == 0) {
+            char title[64];
+            int len = snprintf(title, sizeof(title), "title %d", rand_r(seed) % 50);
+            w->title = store_string(next, title, (size_t)len);
+        }
+    }
+
+    while (next->count == 0 || rand_r(seed) % 3 == 0) {
+        WindowList *one = build_list(1);
+        if (!one) break;
+        WindowInfo *w = copy_window(next, one, &one->windows[0]);
+        free_window_list(one);
+        if (!w) break;
+
+        int kind = rand_r(seed) % 3;
+        w->window_id = kind == 0 ? 0 : (*fresh_id)++;
+        if (kind == 2 && next->count > 1) w->window_id = next->windows[rand_r(seed) % (next->count - 1)].window_id;
+        w->desktop = rand_r(seed) % 6;
+    }
+    return next;
+}
+
+/* appends a run of changing lists to the history, then every entry must load back unchanged */
+static int check_history_roundtrip(void) {
+    enum { STEPS = 3 * HISTORY_KEYFRAME_INTERVAL + 7 };
+    static WindowList *steps[STEPS];
+    time_t start = 1700000000;
+    unsigned seed = 7;
+    uint64_t fresh_id = 0x5200000u;
+    int bad = 0;
+
+    steps[0] = new_window_list();
+    if (steps[0]) add_awkward_window(steps[0]);
+    for (int i = 0; i < STEPS && steps[i] && !bad; i++) {
+        if (i > 0 && !(steps[i] = next_history_list(steps[i - 1], &seed, &fresh_id))) break;
+        if (history_append(steps[i], "check", start + (time_t)i * 60) != 0) {
+            fprintf(stderr, "sessionsnap-bench: history append %d failed\n", i);
+            bad++;
+        }
+    }
+
+    for (int i = 0; i < STEPS && steps[i] && !bad; i++) {
+        time_t found = 0;
+        WindowList *back = history_load_at("check", start + (time_t)i * 60, &found);
+        if (!back || found != start + (time_t)i * 60) {
+            fprintf(stderr, "sessionsnap-bench: history entry %d did not load\n", i);
+            bad++;
+        } else if (compare_lists(steps[i], back) != 0) {
+            fprintf(stderr, "sessionsnap-bench: history entry %d differs\n", i);
+            bad++;
+        } else {
+            for (int j = 0; j < back->count; j++) {
+                if (back->windows[j].window_id == steps[i]->windows[j].window_id) continue;
+                fprintf(stderr, "sessionsnap-bench: history entry %d: window %d has another id\n", i, j);
+                bad++;
+                break;
+            }
+        }
+        free_window_list(back);
+    }
+
+    for (int i = 0; i < STEPS; i++) free_window_list(steps[i]);
+    fprintf(stderr, "sessionsnap-bench: history round trip, %d entries: %s\n", STEPS, bad ? "FAIL" : "ok");
+    return bad ? -1 : 0;
+}
+
+static void report(const char *name, const char *format, int windows, Run *run, int *first) {
+    printf("%s    {\"bench\": \"%s\", \"format\": \"%s\", \"windows\": %d, "
+        "\"iterations\": %d, \"p50_us\": %.1f, \"p99_us\": %.1f, "
+        "\"allocs\": %.1f, \"x_round_trips\": %.1f}",
+        *first ? "" : ",\n", name, format, windows, run->n,
+        percentile(run->samples, run->n, 0.50), percentile(run->samples, run->n, 0.99),
+        (double)run->total.allocs / run->n, (double)run->total.round_trips / run->n);
+    *first = 0;
+}
+
+static void bench_save(int *first) {
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        int n = sizes[s];
+        WindowList *list = build_list(n);
+        if (!list) continue;
+
+        Run run = {0};
+        int saved = mute_stdout();
+        for (int i = 0; i < SAVE_ITERATIONS; i++) {
+            /* a moved window, otherwise the unchanged-fingerprint check skips the write */
+            list->windows[0].x = i;
+            double t0;
+            run_begin(&run, &t0);
+            save_session(list, "bench");
+            run_end(&run, t0);
+        }
+        unmute_stdout(saved);
+        free_window_list(list);
+
+        report("save", "snap", n, &run, first);
+    }
+}
+
+static void bench_load(int *first) {
+    volatile long sink = 0;
+
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        int n = sizes[s];
+        WindowList *list = build_list(n);
+        if (!list) continue;
+
+        char json_path[512];
+        get_session_json_path(json_path, sizeof(json_path), "bench");
+
+        int saved = mute_stdout();
+        save_session(list, "bench");
+        save_session_json(list, json_path);
+        unmute_stdout(saved);
+        free_window_list(list);
+
+        Run run = {0};
+        for (int i = 0; i < LOAD_ITERATIONS; i++) {
+            double t0;
+            run_begin(&run, &t0);
+            WindowList *loaded = load_session("bench");
+            if (loaded) sink += touch_list(loaded);
+            free_window_list(loaded);
+            run_end(&run, t0);
+        }
+        report("load", "snap", n, &run, first);
+
+        Run json_run = {0};
+        for (int i = 0; i < LOAD_ITERATIONS; i++) {
+            double t0;
+            run_begin(&json_run, &t0);
+            WindowList *loaded = load_session_json(json_path);
+            if (loaded) sink += touch_list(loaded);
+            free_window_list(loaded);
+            run_end(&json_run, t0);
+        }
+        report("load", "json", n, &json_run, first);
+    }
+    (void)sink;
+}
+
+static long long file_size(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? (long long)st.st_size : -1;
+}
+
+/* appends a week of snapshots that each move one window, then looks up random points in it */
+static void bench_history(int *first) {
+    WindowList *list = build_list(HISTORY_WINDOWS);
+    if (!list) return;
+
+    time_t start = 1700000000;
+    Run append = {0};
+    for (int i = 0; i < HISTORY_ENTRIES; i++) {
+        list->windows[i % HISTORY_WINDOWS].x = (i * 7) % 1920;
+
+        double t0;
+        int timed = i >= HISTORY_ENTRIES - LOAD_ITERATIONS;
+        if (timed) run_begin(&append, &t0);
+        history_append(list, "bench", start + (time_t)i * 60);
+        if (timed) run_end(&append, t0);
+    }
+    free_window_list(list);
+    report("history_append", "log", HISTORY_WINDOWS, &append, first);
+
+    volatile long sink = 0;
+    unsigned seed = 1;
+    Run lookup = {0};
+    for (int i = 0; i < LOAD_ITERATIONS; i++) {
+        time_t at = start + (time_t)(rand_r(&seed) % HISTORY_ENTRIES) * 60;
+        double t0;
+        run_begin(&lookup, &t0);
+        WindowList *loaded = history_load_at("bench", at, NULL);
+        if (loaded) sink += touch_list(loaded);
+        free_window_list(loaded);
+        run_end(&lookup, t0);
+    }
+    report("history_load_at", "log", HISTORY_WINDOWS, &lookup, first);
+    history_free();
+    (void)sink;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s/bench.log", getenv("HOME"), HISTORY_DIR);
+    long long log_bytes = file_size(path);
+    snprintf(path, sizeof(path), "%s%s/bench.idx", getenv("HOME"), HISTORY_DIR);
+    printf(",\n    {\"bench\": \"history_size\", \"format\": \"log\", \"windows\": %d, "
+        "\"entries\": %d, \"log_bytes\": %lld, \"index_bytes\": %lld}",
+        HISTORY_WINDOWS, HISTORY_ENTRIES, log_bytes, file_size(path));
+}
+
+/* captures n synthetic windows spread over several client processes */
+static void bench_capture(int *first) {
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        int n = sizes[s];
+        if (spawn_clients(self_exe, n) != 0 || wait_for_clients(n, CLIENT_START_TIMEOUT_MS) != 0) {
+            fprintf(stderr, "sessionsnap-bench: synthetic clients for N=%d did not map\n", n);
+            kill_children();
+            continue;
+        }
+
+        Display *display = XOpenDisplay(NULL);
+        if (!display) {
+            kill_children();
+            continue;
+        }
+
+        Run run = {0};
+        for (int i = 0; i < CAPTURE_ITERATIONS; i++) {
+            double t0;
+            run_begin(&run, &t0);
+            WindowList *list = capture_windows(display);
+            run_end(&run, t0);
+            free_window_list(list);
+        }
+        report("capture", "x11", n, &run, first);
+
+        XCloseDisplay(display);
+        kill_children();
+        wait_for_clients(0, CLIENT_START_TIMEOUT_MS);
+    }
+}
+
+/* a policy that launches everything at once, so restore timing measures sessionsnap, not the gate */
+static void write_restore_policy(const char *profile, int n) {
+    char path[512];
+    get_session_policy_path(path, sizeof(path), profile);
+
+    FILE *f = fopen(path, "w");
+    if (!f) return;
+    fprintf(f, "wave_size = %d\nwave_gap_ms = 0\nmin_mem_available_mb = 0\n"
+        "max_cpu_pressure = 100\nmax_memory_pressure = 100\nmax_io_pressure = 100\n"
+        "max_load_per_cpu = 1000\nbackground_nice = 0\nbackground_ionice = none\n", n);
+    fclose(f);
+}
+
+/* a saved session whose every entry relaunches one synthetic client window */
+static WindowList *build_restore_list(int n) {
+    WindowList *list = new_window_list();
+    if (!list) return NULL;
+
+    for (int i = 0; i < n; i++) {
+        WindowInfo *w = add_window(list);
+        if (!w) break;
+
+        char buf[64];
+        w->x = (i * 53) % 1600;
+        w->y = (i * 29) % 900;
+        w->width = 400;
+        w->height = 300;
+
+        int len = snprintf(buf, sizeof(buf), "bench window %d", i);
+        w->title = store_string(list, buf, (size_t)len);
+        w->wm_class = store_string(list, BENCH_WM_CLASS, strlen(BENCH_WM_CLASS));
+        w->exe_path = store_string(list, self_exe, strlen(self_exe));
+
+        add_window_arg(list, w, self_exe, strlen(self_exe));
+        add_window_arg(list, w, "--clients", 9);
+        len = snprintf(buf, sizeof(buf), "%d", i);
+        add_window_arg(list, w, buf, (size_t)len);
+        add_window_arg(list, w, "1", 1);
+    }
+    return list;
+}
+
+static void bench_restore(int *first) {
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        int n = sizes[s];
+        WindowList *list = build_restore_list(n);
+        if (!list) continue;
+
+        int saved = mute_stdout();
+        save_session(list, "bench-restore");
+        unmute_stdout(saved);
+        free_window_list(list);
+        write_restore_policy("bench-restore", n);
+
+        Run run = {0};
+        for (int i = 0; i < RESTORE_ITERATIONS; i++) {
+            saved = mute_stdout();
+            double t0;
+            run_begin(&run, &t0);
+            restore_session("bench-restore");
+            run_end(&run, t0);
+            unmute_stdout(saved);
+
+            kill_children();
+            wait_for_clients(0, CLIENT_START_TIMEOUT_MS);
+        }
+        report("restore", "x11", n, &run, first);
+    }
+}
+
+/* every live pid, standing in for the window owners of a busy desktop */
+static int list_pids(int *pids, int max) {
+    DIR *dir = opendir("/proc");
+    if (!dir) return 0;
+
+    int n = 0;
+    struct dirent *de;
+    while (n < max && (de = readdir(dir)) != NULL) {
+        if (isdigit((unsigned char)de->d_name[0])) pids[n++] = atoi(de->d_name);
+    }
+    closedir(dir);
+    return n;
+}
+
+/* one capture pass worth of argv/exe lookups, against an empty cache and a warm one */
+static void bench_proc_cache(int *first) {
+    static int pids[MAX_PIDS];
+    int n = list_pids(pids, MAX_PIDS);
+    volatile size_t sink = 0;
+
+    Run cold = {0};
+    for (int i = 0; i < PROC_ITERATIONS; i++) {
+        proc_cache_free();
+        double t0;
+        run_begin(&cold, &t0);
+        proc_cache_begin();
+        for (int j = 0; j < n; j++) {
+            const ProcInfo *p = proc_cache_lookup(pids[j]);
+            if (p) sink += p->argv_len;
+        }
+        run_end(&cold, t0);
+    }
+    report("proc_pass", "cold", n, &cold, first);
+
+    Run warm = {0};
+    for (int i = 0; i < PROC_ITERATIONS; i++) {
+        double t0;
+        run_begin(&warm, &t0);
+        proc_cache_begin();
+        for (int j = 0; j < n; j++) {
+            const ProcInfo *p = proc_cache_lookup(pids[j]);
+            if (p) sink += p->argv_len;
+        }
+        run_end(&warm, t0);
+    }
+    report("proc_pass", "warm", n, &warm, first);
+    proc_cache_free();
+    (void)sink;
+}
+
+/* writes n rules of every kind, none of which match build_list()'s windows */
+static void write_filter_rules(const char *home, int n) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/.sessionsnap", home);
+    mkdir(home, 0755);
+    mkdir(path, 0755);
+    snprintf(path, sizeof(path), "%s%s", home, FILTER_RULES_FILE);
+
+    FILE *f = fopen(path, "w");
+    if (!f) return;
+    for (int i = 0; i < n; i++) {
+        switch (i % 4) {
+        case 0: fprintf(f, "exclude name tool%d\n", i); break;
+        case 1: fprintf(f, "exclude class Vendor%d\n", i); break;
+        case 2: fprintf(f, "exclude glob /opt/vendor%d/*\n", i); break;
+        default: fprintf(f, "exclude title *Report %d —*\n", i); break;
+        }
+    }
+    fclose(f);
+}
+
+/* one capture pass worth of filter checks, rules are per home so each count gets its own */
+static void bench_filter(int *first) {
+    WindowList *list = build_list(FILTER_WINDOWS);
+    if (!list) return;
+
+    const char *home = getenv("HOME");
+    char saved[256];
+    snprintf(saved, sizeof(saved), "%s", home);
+    volatile int sink = 0;
+
+    for (int c = 0; c < RULE_COUNT_COUNT; c++) {
+        char rules_home[300];
+        snprintf(rules_home, sizeof(rules_home), "%s/filter-%d", saved, rule_counts[c]);
+        write_filter_rules(rules_home, rule_counts[c]);
+        setenv("HOME", rules_home, 1);
+
+        /* the first check compiles the rules */
+        sink += filter_window(list, &list->windows[0]);
+
+        Run run = {0};
+        for (int i = 0; i < FILTER_ITERATIONS; i++) {
+            double t0;
+            run_begin(&run, &t0);
+            for (int j = 0; j < list->count; j++) sink += filter_window(list, &list->windows[j]);
+            run_end(&run, t0);
+        }
+
+        char format[32];
+        snprintf(format, sizeof(format), "%d_rules", rule_counts[c]);
+        report("filter", format, list->count, &run, first);
+    }
+
+    setenv("HOME", saved, 1);
+    free_window_list(list);
+    (void)sink;
+}
+
+/* what the daemon does with its model when a window moved: copy it into a writer snapshot and save it */
+static void daemon_tick(const WindowList *model) {
+    WindowList *snapshot = writer_acquire();
+    if (!snapshot) return;
+    for (int i = 0; i < model->count; i++) copy_window(snapshot, model, &model->windows[i]);
+    writer_publish(snapshot, "tick", NULL);
+    writer_wait_idle();
+}
+
+/*
+ * the daemon's save path once warm, through the writer thread, fingerprint, .snap write
+ * and history append. it alternates between two states so every tick really writes, and
+ * must not allocate at all. the X side of a flush is left out: libxcb allocates every
+ * reply and event it hands back, however the caller is written.
+ * returns -1 if the lists can't be built
+ */
+static int run_daemon_ticks(int n, Run *run) {
+    WindowList *states[2] = { build_list(n), build_list(n) };
+    if (!states[0] || !states[1]) {
+        free_window_list(states[0]);
+        free_window_list(states[1]);
+        return -1;
+    }
+    states[1]->windows[0].x += 10;
+
+    int saved = mute_stdout();
+    writer_start();
+    for (int i = 0; i < TICK_WARMUP; i++) daemon_tick(states[i % 2]);
+
+    for (int i = 0; i < TICK_ITERATIONS; i++) {
+        double t0;
+        run_begin(run, &t0);
+        daemon_tick(states[i % 2]);
+        run_end(run, t0);
+    }
+    writer_stop();
+    unmute_stdout(saved);
+
+    free_window_list(states[0]);
+    free_window_list(states[1]);
+    return 0;
+}
+
+/* says FAIL on stderr for a warm tick that allocated, returns -1 then */
+static int check_tick_allocs(int n, const Run *run) {
+    if (run->total.allocs == 0) return 0;
+    fprintf(stderr, "sessionsnap-bench: daemon_tick at %d windows: FAIL, %lu allocations in %d warm ticks\n",
+        n, run->total.allocs, run->n);
+    return -1;
+}
+
+/* returns -1 if any size allocated once warm */
+static int bench_daemon_tick(int *first) {
+    int result = 0;
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        Run run = {0};
+        if (run_daemon_ticks(sizes[s], &run) != 0) continue;
+        report("daemon_tick", "snap", sizes[s], &run, first);
+        if (check_tick_allocs(sizes[s], &run) != 0) result = -1;
+    }
+    return result;
+}
+
+/* the same ticks for make check, without the timings */
+static int check_daemon_tick(void) {
+    int result = 0;
+    for (int s = 0; s < SIZE_COUNT; s++) {
+        Run run = {0};
+        if (run_daemon_ticks(sizes[s], &run) != 0 || check_tick_allocs(sizes[s], &run) != 0) result = -1;
+    }
+    fprintf(stderr, "sessionsnap-bench: daemon_tick allocations: %s\n", result == 0 ? "ok" : "FAIL");
+    return result;
+}
+
+/* copies of this binary in $HOME that nothing has mapped, standing in for apps not yet started */
+static int make_cold_apps(char apps[][PATH_MAX], int n) {
+    int in = open(self_exe, O_RDONLY | O_CLOEXEC);
+    if (in < 0) return -1;
+    struct stat st;
+    if (fstat(in, &st) != 0) {
+        close(in);
+        return -1;
+    }
+
+    int made = 0;
+    for (; made < n; made++) {
+        snprintf(apps[made], PATH_MAX, "%s/cold-app-%d", getenv("HOME"), made);
+        int out = open(apps[made], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0755);
+        if (out < 0) break;
+
+        char buf[65536];
+        ssize_t r;
+        off_t at = 0;
+        while ((r = pread(in, buf, sizeof(buf), at)) > 0 && write(out, buf, (size_t)r) == r) at += r;
+        /* only clean pages can be dropped */
+        fsync(out);
+        close(out);
+        if (at != st.st_size) break;
+    }
+    close(in);
+    return made == n ? 0 : -1;
+}
+
+/*
+ * evicts the apps from the page cache. as root the whole clean cache is dropped first;
+ * libraries this process has mapped stay resident either way, as they would on a
+ * desktop where the panel and the window manager already use them
+ */
+static void drop_cache(char apps[][PATH_MAX], int n) {
+    int fd = open("/proc/sys/vm/drop_caches", O_WRONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        sync();
+        if (write(fd, "1", 1) != 1) perror("sessionsnap-bench: drop_caches");
+        close(fd);
+    }
+
+    for (int i = 0; i < n; i++) {
+        fd = open(apps[i], O_RDONLY | O_CLOEXEC);
+        if (fd < 0) continue;
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/* one saved window per cold app, mapping the app and our libraries as a capture would record */
+static WindowList *build_cold_list(char apps[][PATH_MAX], int n) {
+    WindowList *list = new_window_list();
+    if (!list) return NULL;
+
+    proc_cache_begin();
+    const ProcInfo *self = proc_cache_lookup(getpid());
+
+    for (int i = 0; i < n; i++) {
+        WindowInfo *w = add_window(list);
+        if (!w) break;
+
+        char buf[64];
+        w->width = 400;
+        w->height = 300;
+        int len = snprintf(buf, sizeof(buf), "bench window %d", i);
+        w->title = store_string(list, buf, (size_t)len);
+        w->wm_class = store_string(list, BENCH_WM_CLASS, strlen(BENCH_WM_CLASS));
+        w->exe_path = store_string(list, apps[i], strlen(apps[i]));
+
+        add_window_arg(list, w, apps[i], strlen(apps[i]));
+        add_window_arg(list, w, "--clients", 9);
+        len = snprintf(buf, sizeof(buf), "%d", i);
+        add_window_arg(list, w, buf, (size_t)len);
+        add_window_arg(list, w, "1", 1);
+
+        add_window_map(list, w, apps[i], strlen(apps[i]));
+        for (size_t at = 0; self && at < self->maps_len; at += strlen(self->maps + at) + 1) {
+            if (strcmp(self->maps + at, self_exe) != 0) add_window_map(list, w, self->maps + at, strlen(self->maps + at));
+        }
+    }
+    return list;
+}
+
+/*
+ * time from starting COLD_APPS uncached apps to the first one running main(), with and
+ * without prefetch. needs no X server, so it runs everywhere the X benchmarks are skipped
+ */
+static void bench_cold_launch(int *first) {
+    static char apps[COLD_APPS][PATH_MAX];
+    if (make_cold_apps(apps, COLD_APPS) != 0) return;
+
+    WindowList *list = build_cold_list(apps, COLD_APPS);
+    if (!list) return;
+    int order[COLD_APPS];
+    for (int i = 0; i < COLD_APPS; i++) order[i] = i;
+
+    for (int threads = 0; threads <= 4; threads += 4) {
+        Run run = {0};
+        for (int i = 0; i < COLD_ITERATIONS; i++) {
+            drop_cache(apps, COLD_APPS);
+
+            double t0;
+            run_begin(&run, &t0);
+            Prefetch *prefetch = start_prefetch(list, order, COLD_APPS, threads);
+            for (int a = 0; a < COLD_APPS; a++) {
+                if (fork() == 0) {
+                    execl(apps[a], apps[a], "--noop", (char *)NULL);
+                    _exit(127);
+                }
+            }
+            wait(NULL);
+            run_end(&run, t0);
+
+            while (wait(NULL) > 0) {}
+            finish_prefetch(prefetch, NULL);
+        }
+        report("cold_launch", threads ? "exec+prefetch" : "exec", COLD_APPS, &run, first);
+    }
+    free_window_list(list);
+}
+
+/* time from restore starting on a cold cache to the first window mapping, with and without prefetch */
+static void bench_cold_restore(int *first) {
+    static char apps[COLD_APPS][PATH_MAX];
+    if (make_cold_apps(apps, COLD_APPS) != 0) return;
+
+    WindowList *list = build_cold_list(apps, COLD_APPS);
+    if (!list) return;
+    int saved = mute_stdout();
+    save_session(list, "bench-cold");
+    unmute_stdout(saved);
+    free_window_list(list);
+
+    for (int threads = 0; threads <= 4; threads += 4) {
+        write_restore_policy("bench-cold", COLD_APPS);
+        char path[512];
+        get_session_policy_path(path, sizeof(path), "bench-cold");
+        FILE *f = fopen(path, "a");
+        if (f) {
+            fprintf(f, "prefetch_threads = %d\n", threads);
+            fclose(f);
+        }
+
+        Run run = {0};
+        for (int i = 0; i < COLD_ITERATIONS; i++) {
+            drop_cache(apps, COLD_APPS);
+
+            double t0;
+            run_begin(&run, &t0);
+            pid_t restorer = fork();
+            if (restorer == 0) {
+                mute_stdout();
+                restore_session("bench-cold");
+                kill_children();
+                _exit(0);
+            }
+            int mapped = restorer > 0 && wait_for_first_client(CLIENT_START_TIMEOUT_MS) == 0;
+            if (mapped) run_end(&run, t0);
+
+            if (restorer > 0) waitpid(restorer, NULL, 0);
+            wait_for_clients(0, CLIENT_START_TIMEOUT_MS);
+        }
+        if (run.n > 0) report("cold_first_window", threads ? "x11+prefetch" : "x11", COLD_APPS, &run, first);
+    }
+}
+
+int main(int argc, char **argv) {
+    /* the bench re-executes itself as the stand-in WM and as synthetic clients */
+    if (argc == 2 && strcmp(argv[1], "--wm") == 0) return run_fake_wm();
+    if (argc == 4 && strcmp(argv[1], "--clients") == 0) return run_clients(atoi(argv[2]), atoi(argv[3]));
+    /* and as the cold apps of bench_cold_launch, which only need to get as far as main() */
+    if (argc == 2 && strcmp(argv[1], "--noop") == 0) return 0;
+
+    ssize_t len = readlink("/proc/self/exe", self_exe, sizeof(self_exe) - 1);
+    if (len <= 0) {
+        perror("sessionsnap-bench: readlink");
+        return 1;
+    }
+    self_exe[len] = '\0';
+
+    char home[] = "/tmp/sessionsnap-bench-XXXXXX";
+    if (!mkdtemp(home)) {
+        perror("sessionsnap-bench: mkdtemp");
+        return 1;
+    }
+    setenv("HOME", home, 1);
+
+    char cmd[600];
+    snprintf(cmd, sizeof(cmd), "rm -rf '%s'", home);
+
+    if (argc == 2 && strcmp(argv[1], "--check") == 0) {
+        int result = check_json_roundtrip(home);
+        if (check_history_roundtrip() != 0) result = -1;
+        if (check_daemon_tick() != 0) result = -1;
+        if (system(cmd) != 0) result = -1;
+        return result == 0 ? 0 : 1;
+    }
+
+    int first = 1;
+    printf("{\n  \"results\": [\n");
+    bench_save(&first);
+    bench_load(&first);
+    bench_proc_cache(&first);
+    bench_history(&first);
+    bench_filter(&first);
+    int ticks_ok = bench_daemon_tick(&first) == 0;
+    bench_cold_launch(&first);
+
+    int have_x = start_xenv(self_exe) == 0;
+    if (have_x) {
+        bench_capture(&first);
+        bench_restore(&first);
+        bench_cold_restore(&first);
+        stop_xenv();
+    } else {
+        fprintf(stderr, "sessionsnap-bench: could not start Xvfb, skipping capture and restore\n");
+    }
+    printf("\n  ],\n  \"skipped\": [%s]\n}\n", have_x ? "" : "\"capture\", \"restore\", \"cold_first_window\"");
+
+    if (system(cmd) != 0) return 1;
+    return ticks_ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+/*
+ * counters.c — counts heap allocations and blocking X replies for the benchmarks
+ * talks to: counters.h, bench.c
+ * imports: glibc's __libc_* allocator entry points, dlfcn.h to reach the real libxcb
+ * functions: malloc(), calloc(), realloc(), xcb_wait_for_reply(), xcb_wait_for_reply64(), read_counters()
+ *
+ * the bench binary is linked with -rdynamic, so these definitions win over libc and
+ * libxcb for every library in the process. a reply that is already buffered when it
+ * is asked for cost no round trip, only waits that find nothing count.
+ */
+
+#define _GNU_SOURCE
+#include "counters.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <dlfcn.h>
+#include <xcb/xcb.h>
+
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static unsigned long allocs = 0;
+static unsigned long round_trips = 0;
+
+static void count(unsigned long *counter) {
+    __atomic_add_fetch(counter, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t size) {
+    count(&allocs);
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size) {
+    count(&allocs);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+    count(&allocs);
+    return __libc_realloc(ptr, size);
+}
+
+typedef void *(*wait_fn)(xcb_connection_t *, unsigned int, xcb_generic_error_t **);
+typedef int (*poll_fn)(xcb_connection_t *, unsigned int, void **, xcb_generic_error_t **);
+typedef void *(*wait64_fn)(xcb_connection_t *, uint64_t, xcb_generic_error_t **);
+typedef int (*poll64_fn)(xcb_connection_t *, uint64_t, void **, xcb_generic_error_t **);
+
+void *xcb_wait_for_reply(xcb_connection_t *c, unsigned int request, xcb_generic_error_t **e) {
+    static wait_fn real_wait = NULL;
+    static poll_fn real_poll = NULL;
+    if (!real_wait) {
+        real_wait = (wait_fn)dlsym(RTLD_NEXT, "xcb_wait_for_reply");
+        real_poll = (poll_fn)dlsym(RTLD_NEXT, "xcb_poll_for_reply");
+    }
+
+    void *reply = NULL;
+    if (e && real_poll && real_poll(c, request, &reply, e)) return reply;
+
+    count(&round_trips);
+    return real_wait(c, request, e);
+}
+
+/* what libX11 uses for _XReply(), so every XGetWindowProperty() and friends lands here */
+void *xcb_wait_for_reply64(xcb_connection_t *c, uint64_t request, xcb_generic_error_t **e) {
+    static wait64_fn real_wait = NULL;
+    static poll64_fn real_poll = NULL;
+    if (!real_wait) {
+        real_wait = (wait64_fn)dlsym(RTLD_NEXT, "xcb_wait_for_reply64");
+        real_poll = (poll64_fn)dlsym(RTLD_NEXT, "xcb_poll_for_reply64");
+    }
+
+    void *reply = NULL;
+    if (e && real_poll && real_poll(c, request, &reply, e)) return reply;
+
+    count(&round_trips);
+    return real_wait(c, request, e);
+}
+
+void read_counters(BenchCounters *out) {
+    out->allocs = __atomic_load_n(&allocs, __ATOMIC_RELAXED);
+    out->round_trips = __atomic_load_n(&round_trips, __ATOMIC_RELAXED);
+}
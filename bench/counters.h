@@ -0,0 +1,19 @@
+/*
+ * counters.h — declares the allocation and X round-trip counters the benchmarks report
+ * talks to: counters.c, bench.c
+ * counters.c interposes malloc/calloc/realloc and xcb's reply waits for the whole
+ * bench process, so libX11 and libxcb are counted along with sessionsnap itself
+ * functions: read_counters()
+ */
+
+#ifndef BENCH_COUNTERS_H
+#define BENCH_COUNTERS_H
+
+typedef struct {
+    unsigned long allocs;        /* malloc, calloc and realloc calls */
+    unsigned long round_trips;   /* reply waits that had to block on the X server */
+} BenchCounters;
+
+void read_counters(BenchCounters *out);
+
+#endif
@@ -0,0 +1,423 @@
+/*
+ * xenv.c — headless X server, stand-in window manager and synthetic clients for the benchmarks
+ * talks to: xenv.h, bench.c
+ * imports: Xlib for the window manager and clients, fork/exec for Xvfb and the re-executed
+ * bench binary, dirent to find our children in /proc
+ * functions: start_xenv(), stop_xenv(), spawn_clients(), wait_for_clients(), wait_for_first_client(),
+ * kill_children(), run_fake_wm(), run_clients()
+ *
+ * the window manager does only what sessionsnap relies on: it maps and configures
+ * windows on request, keeps _NET_CLIENT_LIST current, puts every client on desktop 0
+ * and honours _NET_WM_STATE maximize requests. it does not reparent.
+ */
+
+#include "xenv.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <X11/Xlib.h>
+#include <X11/Xatom.h>
+#include <X11/Xutil.h>
+
+#define XVFB_START_TIMEOUT_MS 5000
+#define WM_START_TIMEOUT_MS 2000
+
+static pid_t xvfb_pid = 0;
+static pid_t wm_pid = 0;
+
+static void sleep_ms(int ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+static pid_t spawn(char *const argv[], int quiet) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (quiet) {
+            int null = open("/dev/null", O_WRONLY);
+            dup2(null, STDOUT_FILENO);
+            dup2(null, STDERR_FILENO);
+            close(null);
+        }
+        execvp(argv[0], argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+static int display_free(int n) {
+    char path[64];
+    struct stat st;
+    snprintf(path, sizeof(path), "/tmp/.X%d-lock", n);
+    if (stat(path, &st) == 0) return 0;
+    snprintf(path, sizeof(path), "/tmp/.X11-unix/X%d", n);
+    return stat(path, &st) != 0;
+}
+
+/* starts Xvfb on name and waits until it accepts connections, 0 on success */
+static int try_xvfb(const char *name, int many_clients) {
+    char *argv[] = {
+        "Xvfb", (char *)name, "-screen", "0", "1920x1080x24", "-nolisten", "tcp",
+        many_clients ? "-maxclients" : NULL, "2048", NULL
+    };
+    xvfb_pid = spawn(argv, 1);
+    if (xvfb_pid < 0) return -1;
+
+    for (int waited = 0; waited < XVFB_START_TIMEOUT_MS; waited += 20) {
+        Display *d = XOpenDisplay(name);
+        if (d) {
+            XCloseDisplay(d);
+            return 0;
+        }
+        if (waitpid(xvfb_pid, NULL, WNOHANG) == xvfb_pid) break;
+        sleep_ms(20);
+    }
+
+    kill(xvfb_pid, SIGKILL);
+    waitpid(xvfb_pid, NULL, 0);
+    xvfb_pid = 0;
+    return -1;
+}
+
+static int wm_running(Display *d) {
+    Atom check = XInternAtom(d, "_NET_SUPPORTING_WM_CHECK", True);
+    if (check == None) return 0;
+
+    Atom type;
+    int format;
+    unsigned long nitems, after;
+    unsigned char *data = NULL;
+    int found = XGetWindowProperty(d, DefaultRootWindow(d), check, 0, 1, False, XA_WINDOW,
+        &type, &format, &nitems, &after, &data) == Success && nitems == 1;
+    if (data) XFree(data);
+    return found;
+}
+
+/* returns 0 with DISPLAY pointing at a fresh Xvfb and the stand-in WM running, -1 if Xvfb is missing */
+int start_xenv(const char *self_exe) {
+    char name[16] = "";
+    for (int n = 90; n < 200; n++) {
+        if (!display_free(n)) continue;
+        snprintf(name, sizeof(name), ":%d", n);
+        break;
+    }
+    if (!name[0]) return -1;
+
+    /* older Xvfb builds reject -maxclients, restore at N=1000 just needs more than 256 */
+    if (try_xvfb(name, 1) != 0 && try_xvfb(name, 0) != 0) return -1;
+    setenv("DISPLAY", name, 1);
+
+    char *argv[] = { (char *)self_exe, "--wm", NULL };
+    wm_pid = spawn(argv, 0);
+
+    Display *d = XOpenDisplay(NULL);
+    int ready = 0;
+    for (int waited = 0; d && waited < WM_START_TIMEOUT_MS && !ready; waited += 10) {
+        ready = wm_running(d);
+        if (!ready) sleep_ms(10);
+    }
+    if (d) XCloseDisplay(d);
+
+    if (!ready) {
+        stop_xenv();
+        return -1;
+    }
+    return 0;
+}
+
+static void stop_pid(pid_t *pid) {
+    if (*pid <= 0) return;
+    kill(*pid, SIGTERM);
+    waitpid(*pid, NULL, 0);
+    *pid = 0;
+}
+
+void stop_xenv(void) {
+    kill_children();
+    stop_pid(&wm_pid);
+    stop_pid(&xvfb_pid);
+}
+
+/* starts enough client processes to map windows synthetic windows, titled by index */
+int spawn_clients(const char *self_exe, int windows) {
+    for (int first = 0; first < windows; first += BENCH_WINDOWS_PER_CLIENT) {
+        int count = windows - first < BENCH_WINDOWS_PER_CLIENT ? windows - first : BENCH_WINDOWS_PER_CLIENT;
+
+        char first_arg[16], count_arg[16];
+        snprintf(first_arg, sizeof(first_arg), "%d", first);
+        snprintf(count_arg, sizeof(count_arg), "%d", count);
+
+        char *argv[] = { (char *)self_exe, "--clients", first_arg, count_arg, NULL };
+        if (spawn(argv, 0) < 0) return -1;
+    }
+    return 0;
+}
+
+static long client_list_length(Display *d) {
+    Atom list = XInternAtom(d, "_NET_CLIENT_LIST", False);
+    Atom type;
+    int format;
+    unsigned long nitems = 0, after;
+    unsigned char *data = NULL;
+
+    if (XGetWindowProperty(d, DefaultRootWindow(d), list, 0, ~0L, False, XA_WINDOW,
+        &type, &format, &nitems, &after, &data) != Success) return -1;
+    if (data) XFree(data);
+    return (long)nitems;
+}
+
+/* waits until the WM lists exactly windows clients, 0 on success */
+int wait_for_clients(int windows, int timeout_ms) {
+    Display *d = XOpenDisplay(NULL);
+    if (!d) return -1;
+
+    int ok = 0;
+    for (int waited = 0; waited < timeout_ms; waited += 10) {
+        if (client_list_length(d) == windows) {
+            ok = 1;
+            break;
+        }
+        sleep_ms(10);
+    }
+    XCloseDisplay(d);
+    return ok ? 0 : -1;
+}
+
+/* waits until the WM lists any client at all, polling tightly since the wait is what's measured */
+int wait_for_first_client(int timeout_ms) {
+    Display *d = XOpenDisplay(NULL);
+    if (!d) return -1;
+
+    int ok = 0;
+    for (int waited = 0; waited < timeout_ms * 4; waited++) {
+        if (client_list_length(d) > 0) {
+            ok = 1;
+            break;
+        }
+        struct timespec ts = { 0, 250000L };
+        nanosleep(&ts, NULL);
+    }
+    XCloseDisplay(d);
+    return ok ? 0 : -1;
+}
+
+/* kills and reaps every child except Xvfb and the WM: synthetic clients and restored apps */
+void kill_children(void) {
+    DIR *dir = opendir("/proc");
+    if (!dir) return;
+
+    pid_t self = getpid();
+    struct dirent *de;
+    while ((de = readdir(dir)) != NULL) {
+        if (!isdigit((unsigned char)de->d_name[0])) continue;
+        pid_t pid = (pid_t)atoi(de->d_name);
+        if (pid == xvfb_pid || pid == wm_pid) continue;
+
+        char path[64], buf[512];
+        snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+        FILE *f = fopen(path, "r");
+        if (!f) continue;
+        size_t n = fread(buf, 1, sizeof(buf) - 1, f);
+        fclose(f);
+        buf[n] = '\0';
+
+        char *p = strrchr(buf, ')');
+        int ppid = 0;
+        if (p && sscanf(p + 1, " %*c %d", &ppid) == 1 && ppid == self) {
+            kill(pid, SIGKILL);
+            waitpid(pid, NULL, 0);
+        }
+    }
+    closedir(dir);
+}
+
+/* --- the stand-in window manager, run as `sessionsnap-bench --wm` --- */
+
+enum {
+    A_SUPPORTED, A_CLIENT_LIST, A_CHECK, A_WM_NAME, A_STATE, A_MAX_VERT, A_MAX_HORZ,
+    A_WM_DESKTOP, A_CURRENT_DESKTOP, A_NUMBER_OF_DESKTOPS, A_UTF8, A_COUNT
+};
+
+static char *wm_atom_names[A_COUNT] = {
+    "_NET_SUPPORTED", "_NET_CLIENT_LIST", "_NET_SUPPORTING_WM_CHECK", "_NET_WM_NAME",
+    "_NET_WM_STATE", "_NET_WM_STATE_MAXIMIZED_VERT", "_NET_WM_STATE_MAXIMIZED_HORZ",
+    "_NET_WM_DESKTOP", "_NET_CURRENT_DESKTOP", "_NET_NUMBER_OF_DESKTOPS", "UTF8_STRING",
+};
+
+static Window *clients = NULL;
+static int client_count = 0;
+static int client_cap = 0;
+
+static void publish_clients(Display *d, const Atom *a) {
+    XChangeProperty(d, DefaultRootWindow(d), a[A_CLIENT_LIST], XA_WINDOW, 32,
+        PropModeReplace, (unsigned char *)clients, client_count);
+}
+
+static void add_client(Display *d, const Atom *a, Window w) {
+    for (int i = 0; i < client_count; i++) {
+        if (clients[i] == w) return;
+    }
+    if (client_count == client_cap) {
+        int cap = client_cap ? client_cap * 2 : 256;
+        Window *grown = realloc(clients, (size_t)cap * sizeof(Window));
+        if (!grown) return;
+        clients = grown;
+        client_cap = cap;
+    }
+    clients[client_count++] = w;
+
+    long desktop = 0;
+    XChangeProperty(d, w, a[A_WM_DESKTOP], XA_CARDINAL, 32, PropModeReplace,
+        (unsigned char *)&desktop, 1);
+    publish_clients(d, a);
+}
+
+static void remove_client(Display *d, const Atom *a, Window w) {
+    for (int i = 0; i < client_count; i++) {
+        if (clients[i] != w) continue;
+        clients[i] = clients[--client_count];
+        publish_clients(d, a);
+        return;
+    }
+}
+
+/* applies a _NET_WM_STATE add/remove/toggle for the two maximize atoms */
+static void change_state(Display *d, const Atom *a, const XClientMessageEvent *msg) {
+    Window w = msg->window;
+    int vert = 0, horz = 0;
+
+    Atom type;
+    int format;
+    unsigned long nitems = 0, after;
+    unsigned char *data = NULL;
+    if (XGetWindowProperty(d, w, a[A_STATE], 0, 32, False, XA_ATOM,
+        &type, &format, &nitems, &after, &data) == Success && data) {
+        Atom *states = (Atom *)data;
+        for (unsigned long i = 0; i < nitems; i++) {
+            if (states[i] == a[A_MAX_VERT]) vert = 1;
+            if (states[i] == a[A_MAX_HORZ]) horz = 1;
+        }
+        XFree(data);
+    }
+
+    for (int i = 1; i <= 2; i++) {
+        int *flag = (Atom)msg->data.l[i] == a[A_MAX_VERT] ? &vert :
+                    (Atom)msg->data.l[i] == a[A_MAX_HORZ] ? &horz : NULL;
+        if (!flag) continue;
+        if (msg->data.l[0] == 0) *flag = 0;
+        else if (msg->data.l[0] == 1) *flag = 1;
+        else *flag = !*flag;
+    }
+
+    Atom states[2];
+    int n = 0;
+    if (vert) states[n++] = a[A_MAX_VERT];
+    if (horz) states[n++] = a[A_MAX_HORZ];
+    XChangeProperty(d, w, a[A_STATE], XA_ATOM, 32, PropModeReplace, (unsigned char *)states, n);
+
+    if (vert && horz) {
+        XMoveResizeWindow(d, w, 0, 0, (unsigned)DisplayWidth(d, DefaultScreen(d)),
+            (unsigned)DisplayHeight(d, DefaultScreen(d)));
+    }
+}
+
+int run_fake_wm(void) {
+    Display *d = XOpenDisplay(NULL);
+    if (!d) return 1;
+
+    Window root = DefaultRootWindow(d);
+    Atom a[A_COUNT];
+    XInternAtoms(d, wm_atom_names, A_COUNT, False, a);
+
+    XSelectInput(d, root, SubstructureRedirectMask | SubstructureNotifyMask);
+
+    Window check = XCreateSimpleWindow(d, root, -1, -1, 1, 1, 0, 0, 0);
+    XChangeProperty(d, check, a[A_CHECK], XA_WINDOW, 32, PropModeReplace, (unsigned char *)&check, 1);
+    XChangeProperty(d, check, a[A_WM_NAME], a[A_UTF8], 8, PropModeReplace,
+        (unsigned char *)"snapbench-wm", 12);
+
+    long zero = 0, one = 1;
+    XChangeProperty(d, root, a[A_SUPPORTED], XA_ATOM, 32, PropModeReplace, (unsigned char *)a, A_UTF8);
+    XChangeProperty(d, root, a[A_NUMBER_OF_DESKTOPS], XA_CARDINAL, 32, PropModeReplace,
+        (unsigned char *)&one, 1);
+    XChangeProperty(d, root, a[A_CURRENT_DESKTOP], XA_CARDINAL, 32, PropModeReplace,
+        (unsigned char *)&zero, 1);
+    publish_clients(d, a);
+    /* set last, start_xenv() takes it as the signal that the WM is ready */
+    XChangeProperty(d, root, a[A_CHECK], XA_WINDOW, 32, PropModeReplace, (unsigned char *)&check, 1);
+    XFlush(d);
+
+    for (;;) {
+        XEvent ev;
+        XNextEvent(d, &ev);
+
+        switch (ev.type) {
+        case MapRequest:
+            XMapWindow(d, ev.xmaprequest.window);
+            add_client(d, a, ev.xmaprequest.window);
+            break;
+        case ConfigureRequest: {
+            XWindowChanges wc = {
+                .x = ev.xconfigurerequest.x, .y = ev.xconfigurerequest.y,
+                .width = ev.xconfigurerequest.width, .height = ev.xconfigurerequest.height,
+                .border_width = ev.xconfigurerequest.border_width,
+                .sibling = ev.xconfigurerequest.above, .stack_mode = ev.xconfigurerequest.detail,
+            };
+            XConfigureWindow(d, ev.xconfigurerequest.window,
+                (unsigned)ev.xconfigurerequest.value_mask, &wc);
+            break;
+        }
+        case UnmapNotify:
+            remove_client(d, a, ev.xunmap.window);
+            break;
+        case DestroyNotify:
+            remove_client(d, a, ev.xdestroywindow.window);
+            break;
+        case ClientMessage:
+            if (ev.xclient.message_type == a[A_STATE]) change_state(d, a, &ev.xclient);
+            break;
+        default:
+            break;
+        }
+        XFlush(d);
+    }
+}
+
+/* --- synthetic clients, run as `sessionsnap-bench --clients <first> <count>` --- */
+
+int run_clients(int first, int count) {
+    Display *d = XOpenDisplay(NULL);
+    if (!d) return 1;
+
+    Window root = DefaultRootWindow(d);
+    Atom pid_atom = XInternAtom(d, "_NET_WM_PID", False);
+    long pid = (long)getpid();
+    XClassHint hint = { "snapbench", BENCH_WM_CLASS };
+
+    for (int i = 0; i < count; i++) {
+        int n = first + i;
+        Window w = XCreateSimpleWindow(d, root, (n * 37) % 1600, (n * 23) % 900, 320, 200, 0, 0, 0);
+
+        char title[64];
+        snprintf(title, sizeof(title), "bench window %d", n);
+        XStoreName(d, w, title);
+        XSetClassHint(d, w, &hint);
+        XChangeProperty(d, w, pid_atom, XA_CARDINAL, 32, PropModeReplace, (unsigned char *)&pid, 1);
+        XMapWindow(d, w);
+    }
+    XFlush(d);
+
+    /* stay mapped until the bench kills us, or exit with the server */
+    for (;;) {
+        XEvent ev;
+        XNextEvent(d, &ev);
+    }
+}
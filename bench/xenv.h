@@ -0,0 +1,32 @@
+/*
+ * xenv.h — declares the headless X environment the capture and restore benchmarks run in
+ * talks to: xenv.c, bench.c
+ * starts Xvfb on a free display, a minimal EWMH window manager that maintains
+ * _NET_CLIENT_LIST, and synthetic client processes with _NET_WM_PID set
+ * functions: start_xenv(), stop_xenv(), spawn_clients(), wait_for_clients(), wait_for_first_client(),
+ * kill_children(), run_fake_wm(), run_clients()
+ */
+
+#ifndef BENCH_XENV_H
+#define BENCH_XENV_H
+
+#include <sys/types.h>
+
+/* WM_CLASS of every synthetic window, restore matches on it */
+#define BENCH_WM_CLASS "SnapBench"
+/* windows per synthetic client process, so capture sees several windows per pid */
+#define BENCH_WINDOWS_PER_CLIENT 25
+
+int start_xenv(const char *self_exe);
+void stop_xenv(void);
+
+int spawn_clients(const char *self_exe, int windows);
+int wait_for_clients(int windows, int timeout_ms);
+int wait_for_first_client(int timeout_ms);
+void kill_children(void);
+
+/* entry points of the re-executed bench binary */
+int run_fake_wm(void);
+int run_clients(int first, int count);
+
+#endif
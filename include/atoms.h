@@ -0,0 +1,28 @@
+/*
+ * atoms.h — declares the per-connection table of X atoms used across sessionsnap
+ * talks to: atoms.c, capture.c, monitor.c, restore.c
+ * interns every atom in one XInternAtoms round trip and caches the result per Display
+ * functions: get_atoms(), release_atoms()
+ */
+
+#ifndef ATOMS_H
+#define ATOMS_H
+
+#include <X11/Xlib.h>
+
+typedef struct {
+    Atom net_client_list;
+    Atom net_wm_pid;
+    Atom net_wm_name;
+    Atom net_wm_state;
+    Atom net_wm_state_maximized_vert;
+    Atom net_wm_state_maximized_horz;
+    Atom net_wm_state_hidden;
+    Atom net_wm_desktop;
+    Atom net_current_desktop;
+} AtomTable;
+
+const AtomTable *get_atoms(Display *display);
+void release_atoms(Display *display);
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * catalog.h — declares the index of saved profiles behind --list-profiles and the GUI's picker
+ * talks to: catalog.c, session.c (updates a profile's entry after every write), main.c, gui.c
+ * one small file holds a summary of every profile, so listing them is one read however
+ * many there are. it remembers the state of the directories it describes and is rebuilt
+ * from the session files whenever something else changed them.
+ * functions: catalog_stamp(), catalog_update(), load_catalog(), print_profiles()
+ */
+
+#ifndef CATALOG_H
+#define CATALOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "winlist.h"
+
+#define CATALOG_FILE "/.sessionsnap/profiles.idx"
+/* distinct app names of a profile, comma-separated, longer lists are cut at a name */
+#define CATALOG_APPS_LEN 192
+
+typedef struct {
+    char name[128];
+    char apps[CATALOG_APPS_LEN];
+    int64_t saved;          /* mtime of the session file */
+    uint64_t size;          /* bytes on disk */
+    uint32_t windows;
+    uint32_t json;          /* 1 if the profile only exists as a .json file from an older version */
+} ProfileSummary;
+
+/* identifies one state of a directory or file: changed if any field differs */
+typedef struct {
+    int64_t sec;
+    int64_t nsec;
+    uint64_t size;
+    uint64_t ino;
+} CatalogStamp;
+
+void catalog_stamp(const char *profile_name, CatalogStamp *out);
+void catalog_update(const char *profile_name, const WindowList *list, const CatalogStamp *before);
+int load_catalog(ProfileSummary **out);
+int print_profiles(FILE *out);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * control.h — declares the per-user control socket the daemon answers CLI requests on
+ * talks to: control.c, monitor.c (serves requests from its live model), main.c (sends them)
+ * one request line per connection ("list", "snapshot <profile>", "stats", "pause", "resume"),
+ * answered by "ok" or "error <reason>" and a body, then the daemon closes the connection
+ * functions: get_control_path(), control_listen(), control_accept(), control_read(), control_close(),
+ * control_request(), write_window_list()
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <time.h>
+#include "winlist.h"
+
+/* in $XDG_RUNTIME_DIR when set, which is private to the user, else in ~/.sessionsnap */
+#define CONTROL_SOCKET "sessionsnap.sock"
+#define CONTROL_REQUEST_MAX 256
+/* how long either end waits on a silent peer before giving up on the connection */
+#define CONTROL_IO_TIMEOUT_MS 5000
+/* connections the daemon holds while their request line arrives, more are turned away */
+#define CONTROL_MAX_CLIENTS 8
+
+/* a connection whose request line is still arriving, fd -1 when the slot is free */
+typedef struct {
+    int fd;
+    size_t used;
+    struct timespec accepted;
+    char request[CONTROL_REQUEST_MAX];
+} ControlClient;
+
+/* control_request() results besides 0 */
+#define CONTROL_NO_DAEMON -1
+#define CONTROL_FAILED 1
+
+void get_control_path(char *out, size_t size);
+
+int control_listen(void);
+int control_accept(int listen_fd);
+int control_read(ControlClient *client);
+void control_close(int listen_fd);
+
+int control_request(const char *request, FILE *out);
+
+void write_window_list(FILE *out, const WindowList *list);
+
+#endif
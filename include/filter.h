@@ -0,0 +1,20 @@
+/*
+ * filter.h — declares the rules deciding which captured windows are kept
+ * talks to: filter.c, capture.c (one check per window), stats.c (per-rule hit counters)
+ * rules come from ~/.sessionsnap/filter-rules followed by the built-in ones, the first
+ * rule that matches a window decides whether it is kept or dropped
+ * functions: filter_window(), write_filter_stats()
+ */
+
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stdio.h>
+#include "winlist.h"
+
+#define FILTER_RULES_FILE "/.sessionsnap/filter-rules"
+
+int filter_window(const WindowList *list, const WindowInfo *w);
+void write_filter_stats(FILE *out);
+
+#endif
@@ -0,0 +1,20 @@
+/*
+ * fingerprint.h — declares the structural hash used to detect unchanged sessions
+ * talks to: fingerprint.c, session.c
+ * hashes geometry, state, desktop, exe and argv of every window plus a normalized title,
+ * where normalization strips the regexes listed in ~/.sessionsnap/title-rules
+ * functions: session_fingerprint(), normalize_title()
+ */
+
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stdint.h>
+#include "winlist.h"
+
+#define TITLE_RULES_FILE "/.sessionsnap/title-rules"
+
+uint64_t session_fingerprint(const WindowList *list);
+const char *normalize_title(const char *title);
+
+#endif
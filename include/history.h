@@ -0,0 +1,40 @@
+/*
+ * history.h — declares the append-only snapshot history kept next to each session
+ * talks to: history.c, session.c (appends every written session), main.c (--history, --at)
+ * layout: history/<profile>.log holds records that are either a keyframe (the whole
+ * session) or a delta against an earlier record, with strings interned per keyframe
+ * chain; history/<profile>.idx holds one fixed-size HistoryEntry per record so a point
+ * in time is found by binary search and rebuilt from at most one keyframe chain
+ * functions: history_append(), history_load_at(), print_history(), parse_history_time(), history_free()
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include "winlist.h"
+
+#define HISTORY_DIR "/.sessionsnap/history"
+/* a full keyframe after this many deltas bounds how many records one lookup replays */
+#define HISTORY_KEYFRAME_INTERVAL 64
+/* entries older than this are dropped when a keyframe is written, a day at a time */
+#define HISTORY_RETENTION_DAYS 7
+
+#define HISTORY_KEYFRAME 0xffffffffu
+
+typedef struct {
+    int64_t time;            /* unix seconds the session was saved */
+    uint64_t offset;         /* of the record in the .log file */
+    uint32_t base;           /* entry this delta applies to, HISTORY_KEYFRAME for a keyframe */
+    uint32_t window_count;
+} HistoryEntry;
+
+int history_append(const WindowList *list, const char *profile_name, time_t when);
+WindowList *history_load_at(const char *profile_name, time_t at, time_t *found);
+int print_history(const char *profile_name, FILE *out);
+int parse_history_time(const char *s, time_t now, time_t *out);
+void history_free(void);
+
+#endif
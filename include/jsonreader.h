@@ -0,0 +1,17 @@
+/*
+ * jsonreader.h — declares the single-pass session JSON loader
+ * talks to: jsonreader.c, session.c (load_session_json)
+ * tokenizes the session schema once, dispatching keys through a fixed table straight
+ * into a WindowList, and reports malformed input as path:line:column
+ * functions: parse_session_json()
+ */
+
+#ifndef JSONREADER_H
+#define JSONREADER_H
+
+#include <stddef.h>
+#include "winlist.h"
+
+WindowList *parse_session_json(const char *data, size_t len, const char *path);
+
+#endif
@@ -0,0 +1,28 @@
+/*
+ * jsonwriter.h — declares a streaming JSON emitter that writes into a reusable buffer
+ * talks to: jsonwriter.c, session.c (session export)
+ * escaping matches cJSON_PrintUnformatted byte for byte, so files written either way are identical
+ * functions: json_reset(), json_raw(), json_string(), json_int(), json_free()
+ */
+
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <stddef.h>
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    int failed;    /* set once an allocation fails, further output is dropped */
+} JsonBuf;
+
+void json_reset(JsonBuf *buf);
+void json_free(JsonBuf *buf);
+void json_raw(JsonBuf *buf, const char *s, size_t len);
+void json_string(JsonBuf *buf, const char *s);
+void json_int(JsonBuf *buf, long long v);
+
+#define json_lit(buf, s) json_raw((buf), (s), sizeof(s) - 1)
+
+#endif
@@ -0,0 +1,19 @@
+/*
+ * keyfile.h — declares the reader for the small "key value" config files in ~/.sessionsnap
+ * talks to: keyfile.c, scheduler.c (session.policy, "key = value"), planner.c (launch-hints, "app how")
+ * one setting per line, '#' starts a comment, blank lines are skipped
+ * functions: read_key_file()
+ */
+
+#ifndef KEYFILE_H
+#define KEYFILE_H
+
+/* KEY_SPACE as the separator splits at the first run of spaces or tabs */
+#define KEY_SPACE '\0'
+
+/* returns 0 if it took the setting, else the line is reported as bad */
+typedef int (*KeyLineFn)(void *data, const char *key, const char *value);
+
+void read_key_file(const char *path, char separator, const char *expected, KeyLineFn apply, void *data);
+
+#endif
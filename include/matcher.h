@@ -0,0 +1,55 @@
+/*
+ * matcher.h — declares the index restore uses to tie newly mapped windows to saved ones
+ * talks to: matcher.c, restore.c, capture.c (queries indexed windows), winlist.h
+ * the index is refreshed in one pipelined batch per client-list change and scored by
+ * launched pid (and its descendants), WM_CLASS, exe path and title similarity
+ * functions: new_match_index(), index_client_list(), index_mark_dirty(), assign_matches()
+ */
+
+#ifndef MATCHER_H
+#define MATCHER_H
+
+#include <sys/types.h>
+#include <X11/Xlib.h>
+#include "winlist.h"
+
+/* how a window was tied to its saved entry, strongest evidence first */
+typedef enum {
+    MATCH_NONE,
+    MATCH_PID,
+    MATCH_CLASS,
+    MATCH_EXE,
+    MATCH_TITLE,
+    MATCH_KINDS
+} MatchKind;
+
+/* one saved window restore is waiting for */
+typedef struct {
+    const WindowInfo *saved;
+    pid_t launched_pid;     /* 0 if the launch failed */
+    int waiting;            /* cleared by the caller once it gives up on this window */
+    Window window;          /* set by assign_matches() */
+    MatchKind kind;
+} MatchTarget;
+
+typedef struct {
+    unsigned long refreshes;        /* pipelined query batches sent */
+    unsigned long windows_queried;
+    unsigned long pairs_scored;
+    double total_ms;                /* time spent refreshing and scoring */
+    unsigned long by_kind[MATCH_KINDS];
+} MatchStats;
+
+typedef struct MatchIndex MatchIndex;
+
+MatchIndex *new_match_index(Display *display, const WindowList *saved);
+void free_match_index(MatchIndex *index);
+
+void index_client_list(MatchIndex *index);
+void index_mark_dirty(MatchIndex *index, Window window);
+int assign_matches(MatchIndex *index, MatchTarget *targets, int count, int *assigned);
+
+void get_match_stats(const MatchIndex *index, MatchStats *stats);
+const char *match_kind_name(MatchKind kind);
+
+#endif
@@ -1,16 +1,24 @@
 /*
- * monitor.h — declares the background monitoring loop and signal handlers
+ * monitor.h — declares the event-driven background monitor and signal handlers
  * talks to: monitor.c, main.c
- * uses capture.h and session.h to repeatedly snapshot and save window state
+ * uses capture.h and session.h to keep a live window model and save it on change, per display
+ * with --seats, where one process serves every X server on the host
  * functions: start_monitor(), stop_monitor(), snapshot_once()
  */
 
 #ifndef MONITOR_H
 #define MONITOR_H
 
-#define MONITOR_INTERVAL_SECONDS 60
+/* quiet period after the last X event before changed windows are re-queried and saved */
+#define MONITOR_SETTLE_MS 250
+/* upper bound on how long a steady stream of events can postpone a save */
+#define MONITOR_MAX_DELAY_MS 2000
+/* with --seats, how often displays that refused us are retried (new ones are seen via inotify) */
+#define MONITOR_RESCAN_MS 30000
+/* epoll events handled per wakeup */
+#define MONITOR_MAX_EVENTS 64
 
-void start_monitor(void);
+void start_monitor(int all_displays);
 void stop_monitor(void);
 void snapshot_once(void);
 
@@ -0,0 +1,45 @@
+/*
+ * planner.h — declares the launch plan that starts each saved process once for all of its windows
+ * talks to: planner.c, restore.c (launches groups instead of windows), session.c (whose home the hints come from)
+ * windows that had the same pid, exe and argv when saved form one group. the first of them
+ * restore reaches starts the app and the others wait for that one process. an app that
+ * doesn't bring all its windows back by itself is asked for each missing one, and a
+ * per-app hint says how: a new-window flag, running the command again, or not at all
+ * functions: build_launch_plan(), free_launch_plan()
+ */
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include "winlist.h"
+
+#define LAUNCH_HINTS_FILE "/.sessionsnap/launch-hints"
+
+/* how long a group's app gets after its first window maps to map the others by itself */
+#define PLAN_SETTLE_MS 1500
+
+typedef enum {
+    EXTRA_RELAUNCH,         /* run the saved command again for each missing window */
+    EXTRA_FLAG,             /* run it again with a new-window flag appended */
+    EXTRA_SELF,             /* the app reopens all of its windows itself */
+} ExtraWindowMode;
+
+typedef struct {
+    int first;              /* index into LaunchPlan.members of the group's first window */
+    int count;
+    ExtraWindowMode mode;
+    const char *flag;       /* EXTRA_FLAG only, owned by the plan or static */
+} LaunchGroup;
+
+typedef struct {
+    LaunchGroup *groups;
+    int group_count;
+    int *members;           /* list indices, each group's contiguous and in saved order */
+    int *group_of;          /* list index -> index into groups */
+    void *hints;            /* launch-hints entries the flags may point into */
+} LaunchPlan;
+
+int build_launch_plan(const WindowList *list, LaunchPlan *plan);
+void free_launch_plan(LaunchPlan *plan);
+
+#endif
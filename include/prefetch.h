@@ -0,0 +1,29 @@
+/*
+ * prefetch.h — declares the readahead of saved apps' files that runs alongside a restore
+ * talks to: prefetch.c, restore.c (starts it before the first launch, finishes it after the last placement),
+ * scheduler.h (prefetch_threads in the launch policy), winlist.h (each window's mapped files)
+ * functions: start_prefetch(), finish_prefetch()
+ */
+
+#ifndef PREFETCH_H
+#define PREFETCH_H
+
+#include "winlist.h"
+
+/* how much of one file is read ahead, so a mapped database doesn't fill the page cache */
+#define PREFETCH_MAX_FILE_BYTES (64L << 20)
+
+typedef struct Prefetch Prefetch;
+
+typedef struct {
+    int files;                  /* distinct paths queued */
+    int done;                   /* read ahead before finish_prefetch() */
+    int missing;                /* gone, unreadable, or not a regular file */
+    unsigned long long bytes;
+    double ms;                  /* from start_prefetch() to the last file */
+} PrefetchStats;
+
+Prefetch *start_prefetch(const WindowList *list, const int *order, int count, int threads);
+void finish_prefetch(Prefetch *p, PrefetchStats *stats);
+
+#endif
@@ -0,0 +1,52 @@
+/*
+ * procinfo.h — declares the per-process /proc metadata cache used by capture
+ * talks to: procinfo.c, capture.c (argv, exe and mapped files of window owners), matcher.c (parent pids)
+ * entries are keyed by pid plus the starttime from /proc/<pid>/stat, so a reused pid is
+ * detected, and each pid is re-validated at most once per capture pass. the process
+ * tree used to find a terminal's foreground job is built by one /proc scan per pass
+ * functions: proc_cache_begin(), proc_cache_lookup(), proc_foreground(), read_proc_cwd(), read_proc_stat(),
+ * get_proc_cache_stats()
+ */
+
+#ifndef PROCINFO_H
+#define PROCINFO_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+typedef struct {
+    const char *argv;       /* NUL-separated cmdline, argv_len bytes */
+    size_t argv_len;
+    const char *exe;        /* NUL-terminated /proc/<pid>/exe target, "" if unreadable */
+    size_t exe_len;
+    const char *maps;       /* NUL-separated paths of file-backed mappings, maps_len bytes */
+    size_t maps_len;
+} ProcInfo;
+
+typedef struct {
+    int ppid;
+    int pgrp;
+    int tty;                        /* device number of its controlling terminal, 0 without one */
+    int tpgid;                      /* foreground process group of its terminal, -1 without one */
+    unsigned long long starttime;   /* clock ticks after boot, unique per pid lifetime */
+} ProcStat;
+
+typedef struct {
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    unsigned long stat_reads;       /* /proc/<pid>/stat reads spent validating entries */
+    unsigned long tree_scans;       /* full /proc passes made to find foreground processes */
+    int entries;
+} ProcCacheStats;
+
+void proc_cache_begin(void);
+const ProcInfo *proc_cache_lookup(int pid);
+int proc_foreground(int pid);
+ssize_t read_proc_cwd(int pid, char *buf, size_t size);
+void proc_cache_free(void);
+
+int read_proc_stat(int pid, ProcStat *out);
+void get_proc_cache_stats(ProcCacheStats *stats);
+
+#endif
@@ -1,8 +1,8 @@
 /*
  * restore.h — declares functions to relaunch apps and reposition windows
  * talks to: restore.c, main.c, gui.c
- * uses session.h to load WindowList, uses fork/execvp to relaunch processes
- * functions: restore_session(), reposition_window()
+ * uses session.h to load WindowList, uses fork/execvp to relaunch processes and X events to place windows
+ * functions: restore_session(), restore_window_list(), reposition_window(), restore_status_name()
  */
 
 #ifndef RESTORE_H
@@ -10,7 +10,35 @@
 
 #include "capture.h"
 
+/* how long after its launch an app has to map a window matching its saved title */
+#define RESTORE_WINDOW_TIMEOUT_MS 10000
+
+/* where one saved window is in the restore, reported through RestoreControl.progress */
+typedef enum {
+    RESTORE_WAITING,        /* its wave hasn't started yet */
+    RESTORE_DEFERRED,       /* lazy restore: held until the user switches to its desktop */
+    RESTORE_LAUNCHING,      /* launched, no matching window has mapped yet */
+    RESTORE_PLACED,
+    RESTORE_TIMED_OUT,
+    RESTORE_SKIPPED,        /* skipped or cancelled before it was placed */
+} RestoreStatus;
+
+/*
+ * lets another thread follow and steer a restore. progress runs on the restoring thread
+ * every time a window's status changes. cancel and skip are polled at least every
+ * SCHEDULER_POLL_MS, set them with __atomic stores. a restore with a control leaves the
+ * Xlib error handler to its caller
+ */
+typedef struct {
+    void (*progress)(void *data, int window, RestoreStatus status);
+    void *data;
+    int cancel;                 /* launch nothing more and stop waiting for windows */
+    unsigned char *skip;        /* one per saved window: don't launch it, or stop waiting for it */
+} RestoreControl;
+
 int restore_session(const char *profile_name);
+int restore_window_list(WindowList *list, const char *profile_name, RestoreControl *control);
+const char *restore_status_name(RestoreStatus status);
 int reposition_window(Display *display, const char *title, int x, int y, int w, int h);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,39 @@
+/*
+ * scheduler.h — declares the launch policy that admits restored apps in waves
+ * talks to: scheduler.c, restore.c, session.c (policy file path)
+ * waves are gated on PSI (or loadavg) and MemAvailable, apps on the current desktop
+ * go first and later waves run niced and at idle I/O priority
+ * functions: load_launch_policy(), plan_launch_order(), check_pressure(), apply_background_priority()
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stddef.h>
+#include "winlist.h"
+
+/* how often pressure is re-read while a wave is being held back */
+#define SCHEDULER_POLL_MS 100
+
+typedef struct {
+    int wave_size;                  /* apps launched together */
+    int wave_gap_ms;                /* minimum time between waves unless the last one is all placed */
+    int max_hold_ms;                /* a held wave is admitted anyway after this long */
+    int min_mem_available_mb;
+    double max_cpu_pressure;        /* PSI "some avg10", percent */
+    double max_memory_pressure;
+    double max_io_pressure;
+    double max_load_per_cpu;        /* used instead of PSI on kernels without it */
+    int background_nice;            /* 0 leaves background waves at normal priority */
+    int background_ionice;          /* IOPRIO class: 0 none, 2 best-effort (level 7), 3 idle */
+    int prefetch_threads;           /* workers reading ahead the session's files, 0 turns prefetch off */
+    int lazy_desktops;              /* launch other desktops' apps only once the user switches there */
+    int lazy_idle_ms;               /* ... or after restore has been idle this long, 0 waits for the switch */
+} LaunchPolicy;
+
+void load_launch_policy(const char *profile_name, LaunchPolicy *policy);
+int plan_launch_order(const WindowList *list, int current_desktop, int *order);
+int check_pressure(const LaunchPolicy *policy, char *reason, size_t reason_size);
+void apply_background_priority(const LaunchPolicy *policy);
+
+#endif
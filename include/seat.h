@@ -0,0 +1,29 @@
+/*
+ * seat.h — declares discovery of the local X displays a multi-seat daemon attaches to
+ * talks to: seat.c, monitor.c (one seat per display), session.h (SessionOwner)
+ * every local X server listens on X11_SOCKET_DIR/X<n>, the socket's owner is the user
+ * whose ~/.sessionsnap that seat is saved to
+ * functions: find_displays(), watch_displays(), drain_display_watch(), get_seat_owner(), open_seat_display()
+ */
+
+#ifndef SEAT_H
+#define SEAT_H
+
+#include <X11/Xlib.h>
+#include <sys/types.h>
+#include "session.h"
+
+#define X11_SOCKET_DIR "/tmp/.X11-unix"
+
+typedef struct {
+    int number;     /* the n in ":n" */
+    uid_t uid;      /* owner of the listening socket */
+} DisplaySocket;
+
+int find_displays(DisplaySocket **out);
+int watch_displays(void);
+int drain_display_watch(int fd);
+int get_seat_owner(uid_t uid, SessionOwner *out);
+Display *open_seat_display(const char *name, const SessionOwner *owner);
+
+#endif
@@ -1,22 +1,47 @@
 /*
- * session.h — declares save and load functions for session JSON files
+ * session.h — declares save and load functions for session files
  * talks to: session.c, monitor.c, restore.c, main.c
- * imports capture.h for WindowList struct, uses cJSON for serialization
- * functions: save_session(), load_session(), free_loaded_session()
+ * sessions are stored as binary .snap files (snapfile.h), JSON is kept for export/import
+ * functions: save_session(), load_session(), save_session_json(), load_session_json(), get_session_write_stats(),
+ * set_session_owner(), get_session_home()
  */
 
 #ifndef SESSION_H
 #define SESSION_H
 
 #include "capture.h"
+#include <time.h>
+#include <sys/types.h>
 
 #define SESSION_DIR "/.sessionsnap"
-#define SESSION_FILE "/.sessionsnap/session.json"
+#define SESSION_BASE "/.sessionsnap/session"
 #define SESSIONS_DIR "/.sessionsnap/sessions"
 
+/* whose ~/.sessionsnap a save goes to, so one daemon can keep sessions for several users */
+typedef struct {
+    char home[256];
+    uid_t uid;
+    gid_t gid;
+} SessionOwner;
+
+typedef struct {
+    unsigned long writes;            /* session files actually rewritten */
+    unsigned long skipped;           /* saves dropped because the fingerprint was unchanged */
+    unsigned long long bytes_written;
+    time_t since;                    /* first save_session() call in this process */
+} SessionWriteStats;
+
 int save_session(const WindowList *list, const char *profile_name);
 WindowList *load_session(const char *profile_name);
+int save_session_json(const WindowList *list, const char *path);
+WindowList *load_session_json(const char *path);
 void get_session_path(char *out, size_t size, const char *profile_name);
+void get_session_policy_path(char *out, size_t size, const char *profile_name);
+void get_session_json_path(char *out, size_t size, const char *profile_name);
 int session_file_exists(const char *profile_name);
+int valid_profile_name(const char *name);
+void get_session_write_stats(SessionWriteStats *out);
+void set_session_owner(const SessionOwner *owner);
+const char *get_session_home(void);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,52 @@
+/*
+ * snapfile.h — defines the memory-mappable binary session format (.snap)
+ * talks to: snapfile.c, session.c (save/load), winlist.h (the window table is WindowInfo)
+ * layout: SnapHeader, window table (window_count * window_stride bytes), argv table
+ * (arg_count uint32 string offsets), string pool. all sections are 8-byte aligned and
+ * covered by a CRC-32 stored in the header. a file with the current version and stride
+ * is used in place with no parsing, older ones are upgraded by copying on load.
+ * functions: build_snapshot_header(), map_snapshot(), crc32_update()
+ */
+
+#ifndef SNAPFILE_H
+#define SNAPFILE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "winlist.h"
+
+#define SNAP_MAGIC "SSNP"
+#define SNAP_VERSION 4
+#define SNAP_ENDIAN_MARK 0x01020304u
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint16_t header_size;
+    uint32_t endian_mark;
+    uint32_t checksum;         /* CRC-32 of everything after the header */
+    uint32_t window_count;
+    uint32_t window_stride;    /* sizeof(WindowInfo) of the writer */
+    uint32_t arg_count;
+    uint32_t reserved;
+    uint64_t windows_offset;
+    uint64_t args_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+} SnapHeader;
+
+/* the pieces of a .snap file in write order, header first */
+typedef struct {
+    const void *data;
+    size_t len;
+} SnapPart;
+
+#define SNAP_PARTS 7
+
+void build_snapshot_header(const WindowList *list, SnapHeader *header, SnapPart parts[SNAP_PARTS]);
+WindowList *map_snapshot(const char *path);
+
+/* also checksums history records, see history.c */
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len);
+
+#endif
@@ -0,0 +1,49 @@
+/*
+ * stats.h — declares the per-phase latency histograms and counters kept by capture, save and the daemon
+ * talks to: stats.c, capture.c, session.c, monitor.c, main.c (--stats)
+ * recording is a few relaxed atomic adds, so it stays on in every build and any thread;
+ * the daemon rewrites a Prometheus textfile with everything every STATS_WRITE_INTERVAL_MS
+ * functions: stats_now_ns(), stats_record(), stats_count(), write_stats_text(), write_stats_file(),
+ * set_stats_path(), get_stats_path()
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stdint.h>
+
+/* how often the daemon rewrites the stats file, a typical node_exporter scrape interval */
+#define STATS_WRITE_INTERVAL_MS 15000
+/* relative to $HOME, next to the sessions, unless --stats-file points elsewhere */
+#define STATS_FILE "/.sessionsnap/sessionsnap.prom"
+
+typedef enum {
+    STAT_X_QUERY,       /* sending the pipelined X requests and reading every reply */
+    STAT_PROC,          /* /proc argv and exe lookups for window owners */
+    STAT_SERIALIZE,     /* fingerprinting and laying out the .snap parts */
+    STAT_WRITE,         /* writing the parts to the temp file */
+    STAT_FSYNC,         /* fsync, close and rename over the old file */
+    STAT_SNAPSHOT,      /* one whole capture in the daemon or snapshot_once() */
+    STAT_PHASES
+} StatPhase;
+
+typedef enum {
+    STAT_WINDOWS_CAPTURED,
+    STAT_WINDOWS_NO_PID,        /* no _NET_WM_PID, or the window vanished */
+    STAT_WINDOWS_NO_CMDLINE,    /* owner already gone or a kernel thread */
+    STAT_WINDOWS_SYSTEM,        /* excluded by a filter rule */
+    STAT_COUNTERS
+} StatCounter;
+
+uint64_t stats_now_ns(void);
+void stats_record(StatPhase phase, uint64_t ns);
+void stats_count(StatCounter counter, unsigned long n);
+
+void set_stats_path(const char *path);
+const char *get_stats_path(void);
+
+void write_stats_text(FILE *out);
+int write_stats_file(const char *path);
+
+#endif
@@ -0,0 +1,90 @@
+/*
+ * winlist.h — defines WindowInfo/WindowList and the string arena that backs them
+ * talks to: winlist.c, capture.c, session.c, monitor.c, restore.c, main.c
+ * hot per-window fields live in one contiguous array, titles/argv/paths live in a
+ * per-snapshot string arena and are referenced by offset, so nothing is size-capped
+ * functions: new_window_list(), add_window(), store_string(), add_window_arg(), add_window_job_arg(), add_window_map(),
+ * free_window_list()
+ */
+
+#ifndef WINLIST_H
+#define WINLIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * fixed-width so the same layout can be mapped straight from a .snap file (see snapfile.h),
+ * new fields go at the end so older files can still be upgraded on load
+ */
+typedef struct {
+    uint64_t window_id;
+    int32_t pid;
+    int32_t x, y;
+    int32_t width, height;
+    int32_t desktop;
+    int32_t is_maximized;
+    int32_t is_minimized;
+    uint32_t title;      /* offset into WindowList.strings */
+    uint32_t exe_path;   /* offset into WindowList.strings */
+    uint32_t cmd;        /* index of this window's first entry in WindowList.args */
+    int32_t cmd_argc;
+    uint32_t wm_class;   /* offset into WindowList.strings, the class half of WM_CLASS */
+    uint32_t cwd;        /* offset into WindowList.strings, working directory of the foreground process */
+    uint32_t job;        /* index of the foreground descendant's first argv entry in WindowList.args */
+    int32_t job_argc;    /* 0 unless the window's process has a foreground descendant, e.g. a terminal's shell */
+    uint32_t maps;       /* index of the first file the window's process had mapped in WindowList.args */
+    int32_t map_count;   /* executable, libraries and other file-backed mappings, prefetched on restore */
+} WindowInfo;
+
+typedef struct {
+    WindowInfo *windows;
+    int count;
+    int capacity;
+
+    char *strings;       /* NUL-terminated strings, offset 0 is always "" */
+    size_t strings_len;
+    size_t strings_cap;
+
+    uint32_t *args;      /* argv entries as string offsets, each window owns a contiguous run for its
+                            own argv, one for its foreground job's and one for its mapped files */
+    int args_len;
+    int args_cap;
+
+    /* set when the arrays above point into an mmap'd snapshot, such a list can't grow */
+    void *mapping;
+    size_t mapping_size;
+
+    /* open-addressed set of mapped-file path offsets, so a library every process maps is
+       stored in the arena once. only consulted while adding, never saved */
+    uint32_t *paths;
+    size_t paths_cap;
+    size_t paths_count;
+} WindowList;
+
+WindowList *new_window_list(void);
+void clear_window_list(WindowList *list);
+void free_window_list(WindowList *list);
+
+/* the returned pointer is only valid until the next add_window()/copy_window() */
+WindowInfo *add_window(WindowList *list);
+WindowInfo *copy_window(WindowList *dst, const WindowList *src, const WindowInfo *w);
+
+uint32_t store_string(WindowList *list, const char *s, size_t len);
+int reserve_strings(WindowList *list, size_t bytes);
+int add_window_arg(WindowList *list, WindowInfo *w, const char *s, size_t len);
+int add_window_job_arg(WindowList *list, WindowInfo *w, const char *s, size_t len);
+int add_window_map(WindowList *list, WindowInfo *w, const char *path, size_t len);
+
+const char *window_title(const WindowList *list, const WindowInfo *w);
+const char *window_exe_path(const WindowList *list, const WindowInfo *w);
+const char *window_wm_class(const WindowList *list, const WindowInfo *w);
+const char *window_cwd(const WindowList *list, const WindowInfo *w);
+const char *window_arg(const WindowList *list, const WindowInfo *w, int i);
+const char *window_job_arg(const WindowList *list, const WindowInfo *w, int i);
+const char *window_map(const WindowList *list, const WindowInfo *w, int i);
+
+int windows_equal(const WindowList *a_list, const WindowInfo *a,
+    const WindowList *b_list, const WindowInfo *b);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+ * writer.h — declares the background writer thread that persists published snapshots
+ * talks to: writer.c, monitor.c
+ * the capture side publishes an immutable WindowList per profile and owner, the writer thread
+ * saves only the latest one and coalesces any it never got to
+ * functions: writer_start(), writer_acquire(), writer_publish(), writer_wait_idle(), writer_stop(), get_writer_stats()
+ */
+
+#ifndef WRITER_H
+#define WRITER_H
+
+#include "winlist.h"
+#include "session.h"
+
+/* a write slower than this is logged as I/O backpressure */
+#define WRITER_SLOW_WRITE_MS 1000
+/* written lists kept for reuse: one being filled while another is still being written */
+#define WRITER_SPARE_LISTS 2
+
+typedef struct {
+    unsigned long published;   /* snapshots handed to the writer */
+    unsigned long coalesced;   /* snapshots replaced before the writer got to them */
+    unsigned long saved;       /* save_session() calls made by the writer */
+    unsigned long failed;      /* of those, how many returned an error */
+    int queue_depth;           /* snapshots currently waiting */
+    int max_queue_depth;
+    double last_write_ms;
+    double max_write_ms;
+    double total_write_ms;
+} WriterStats;
+
+int writer_start(void);
+WindowList *writer_acquire(void);
+void writer_publish(WindowList *snapshot, const char *profile_name, const SessionOwner *owner);
+void writer_wait_idle(void);
+void writer_stop(void);
+void get_writer_stats(WriterStats *out);
+
+#endif
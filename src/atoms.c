@@ -0,0 +1,74 @@
+/*
+ * atoms.c — interns all atoms sessionsnap needs once per X connection
+ * talks to: atoms.h, capture.c, monitor.c, restore.c
+ * imports: Xlib for XInternAtoms
+ * functions: get_atoms(), release_atoms()
+ */
+
+#include "../include/atoms.h"
+#include <stdlib.h>
+
+typedef struct AtomCache {
+    Display *display;
+    AtomTable atoms;
+    struct AtomCache *next;
+} AtomCache;
+
+static AtomCache *caches = NULL;
+
+/* same order as the fields of AtomTable */
+static char *atom_names[] = {
+    "_NET_CLIENT_LIST",
+    "_NET_WM_PID",
+    "_NET_WM_NAME",
+    "_NET_WM_STATE",
+    "_NET_WM_STATE_MAXIMIZED_VERT",
+    "_NET_WM_STATE_MAXIMIZED_HORZ",
+    "_NET_WM_STATE_HIDDEN",
+    "_NET_WM_DESKTOP",
+    "_NET_CURRENT_DESKTOP",
+};
+
+#define ATOM_COUNT (int)(sizeof(atom_names) / sizeof(atom_names[0]))
+
+const AtomTable *get_atoms(Display *display) {
+    for (AtomCache *c = caches; c; c = c->next) {
+        if (c->display == display) return &c->atoms;
+    }
+
+    AtomCache *c = calloc(1, sizeof(AtomCache));
+    if (!c) return NULL;
+
+    Atom atoms[ATOM_COUNT];
+    if (!XInternAtoms(display, atom_names, ATOM_COUNT, False, atoms)) {
+        free(c);
+        return NULL;
+    }
+
+    c->display = display;
+    c->atoms.net_client_list = atoms[0];
+    c->atoms.net_wm_pid = atoms[1];
+    c->atoms.net_wm_name = atoms[2];
+    c->atoms.net_wm_state = atoms[3];
+    c->atoms.net_wm_state_maximized_vert = atoms[4];
+    c->atoms.net_wm_state_maximized_horz = atoms[5];
+    c->atoms.net_wm_state_hidden = atoms[6];
+    c->atoms.net_wm_desktop = atoms[7];
+    c->atoms.net_current_desktop = atoms[8];
+
+    c->next = caches;
+    caches = c;
+    return &c->atoms;
+}
+
+/* drop the cached table before closing a display, its Display pointer may be reused */
+void release_atoms(Display *display) {
+    for (AtomCache **p = &caches; *p; p = &(*p)->next) {
+        if ((*p)->display == display) {
+            AtomCache *dead = *p;
+            *p = dead->next;
+            free(dead);
+            return;
+        }
+    }
+}
@@ -1,199 +1,349 @@
 /*
  * capture.c — scans all visible windows using X11 _NET_CLIENT_LIST property
  * talks to: capture.h, session.c (passes WindowList), monitor.c (called in loop)
- * imports: Xlib, Xatom, dirent (for /proc reading), psutil-equivalent via /proc
- * functions: capture_windows(), get_window_pid(), get_window_geometry(), get_process_cmd()
+ * imports: Xlib, XCB (pipelined property/geometry requests), atoms.h, procinfo.h for cached /proc argv/exe,
+ * mapped files and the foreground process and cwd of terminals, filter.h for which windows to keep,
+ * stats.h for the x_query/proc phase timings and window counters
+ * functions: capture_windows(), capture_window_set(), capture_window_set_into(), get_client_list(),
+ * collect_window(), get_process_cmd(), get_process_context(), get_process_maps()
  */
 
 #include "../include/capture.h"
+#include "../include/atoms.h"
+#include "../include/procinfo.h"
+#include "../include/filter.h"
+#include "../include/stats.h"
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
+#include <X11/Xlib-xcb.h>
+#include <xcb/xcb.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <unistd.h>
-#include <dirent.h>
-
-static int get_window_pid(Display *display, Window window) {
-    Atom net_wm_pid = XInternAtom(display, "_NET_WM_PID", True);
-    if (net_wm_pid == None) return -1;
-
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *prop = NULL;
+#include <limits.h>
+
+/* titles are fetched whole, this only bounds what a misbehaving client can make us allocate */
+#define TITLE_MAX_WORDS 16384
+#define WM_CLASS_MAX_WORDS 256
+
+/* reply cookies for one window, all requests are sent before any reply is read */
+typedef struct {
+    xcb_get_property_cookie_t pid;
+    xcb_get_property_cookie_t name;
+    xcb_get_property_cookie_t wm_class;
+    xcb_get_property_cookie_t state;
+    xcb_get_property_cookie_t desktop;
+    xcb_get_geometry_cookie_t geometry;
+    xcb_translate_coordinates_cookie_t origin;
+} WindowCookies;
+
+static xcb_get_property_cookie_t request_property(xcb_connection_t *conn,
+    xcb_window_t window, Atom property, xcb_atom_t type, uint32_t length) {
+    return xcb_get_property(conn, 0, window, (xcb_atom_t)property, type, 0, length);
+}
 
-    int result = XGetWindowProperty(display, window, net_wm_pid,
-        0, 1, False, XA_CARDINAL,
-        &actual_type, &actual_format, &nitems, &bytes_after, &prop);
+static void request_window(xcb_connection_t *conn, const AtomTable *atoms,
+    xcb_window_t root, xcb_window_t window, WindowCookies *c) {
+    c->pid = request_property(conn, window, atoms->net_wm_pid, XCB_ATOM_CARDINAL, 1);
+    c->name = request_property(conn, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, TITLE_MAX_WORDS);
+    c->wm_class = request_property(conn, window, XCB_ATOM_WM_CLASS, XCB_ATOM_STRING, WM_CLASS_MAX_WORDS);
+    c->state = request_property(conn, window, atoms->net_wm_state, XCB_ATOM_ATOM, 1024);
+    c->desktop = request_property(conn, window, atoms->net_wm_desktop, XCB_ATOM_CARDINAL, 1);
+    c->geometry = xcb_get_geometry(conn, window);
+    c->origin = xcb_translate_coordinates(conn, window, root, 0, 0);
+}
 
-    if (result != Success || !prop) return -1;
+/* returns the property reply only if it holds data, errors are swallowed (window may be gone) */
+static xcb_get_property_reply_t *property_reply(xcb_connection_t *conn,
+    xcb_get_property_cookie_t cookie) {
+    xcb_generic_error_t *err = NULL;
+    xcb_get_property_reply_t *reply = xcb_get_property_reply(conn, cookie, &err);
+    free(err);
 
-    int pid = (int)(*(unsigned long *)prop);
-    XFree(prop);
-    return pid;
+    if (reply && xcb_get_property_value_length(reply) == 0) {
+        free(reply);
+        return NULL;
+    }
+    return reply;
 }
 
-static void get_window_geometry(Display *display, Window window, WindowInfo *info) {
-    Window root_return, child_return;
-    int x, y;
-    unsigned int width, height, border, depth;
+static int read_cardinal(xcb_connection_t *conn, xcb_get_property_cookie_t cookie, int fallback) {
+    xcb_get_property_reply_t *reply = property_reply(conn, cookie);
+    if (!reply) return fallback;
 
-    XGetGeometry(display, window, &root_return, &x, &y, &width, &height, &border, &depth);
+    int value = fallback;
+    if (reply->format == 32) value = (int)*(uint32_t *)xcb_get_property_value(reply);
+    free(reply);
+    return value;
+}
 
-    int dest_x, dest_y;
-    XTranslateCoordinates(display, window, root_return, 0, 0, &dest_x, &dest_y, &child_return);
+static void read_title(xcb_connection_t *conn, xcb_get_property_cookie_t cookie,
+    WindowList *list, WindowInfo *info) {
+    xcb_get_property_reply_t *reply = property_reply(conn, cookie);
+    if (!reply) return;
 
-    info->x = dest_x;
-    info->y = dest_y;
-    info->width = (int)width;
-    info->height = (int)height;
+    info->title = store_string(list, xcb_get_property_value(reply),
+        (size_t)xcb_get_property_value_length(reply));
+    free(reply);
 }
 
-static void get_window_state(Display *display, Window window, WindowInfo *info) {
-    Atom net_wm_state = XInternAtom(display, "_NET_WM_STATE", True);
-    Atom maximized_vert = XInternAtom(display, "_NET_WM_STATE_MAXIMIZED_VERT", True);
-    Atom maximized_horz = XInternAtom(display, "_NET_WM_STATE_MAXIMIZED_HORZ", True);
-    Atom hidden = XInternAtom(display, "_NET_WM_STATE_HIDDEN", True);
-
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *prop = NULL;
+/* WM_CLASS is "instance\0class\0", only the class is kept, it is what apps agree on across launches */
+static void read_wm_class(xcb_connection_t *conn, xcb_get_property_cookie_t cookie,
+    WindowList *list, WindowInfo *info) {
+    xcb_get_property_reply_t *reply = property_reply(conn, cookie);
+    if (!reply) return;
+
+    const char *value = xcb_get_property_value(reply);
+    size_t len = (size_t)xcb_get_property_value_length(reply);
+    size_t instance_len = strnlen(value, len);
+    if (instance_len + 1 < len) {
+        const char *cls = value + instance_len + 1;
+        info->wm_class = store_string(list, cls, strnlen(cls, len - instance_len - 1));
+    }
+    free(reply);
+}
 
+static void read_state(xcb_connection_t *conn, const AtomTable *atoms,
+    xcb_get_property_cookie_t cookie, WindowInfo *info) {
     info->is_maximized = 0;
     info->is_minimized = 0;
 
-    if (XGetWindowProperty(display, window, net_wm_state,
-        0, 1024, False, XA_ATOM,
-        &actual_type, &actual_format, &nitems, &bytes_after, &prop) == Success && prop) {
+    xcb_get_property_reply_t *reply = property_reply(conn, cookie);
+    if (!reply) return;
 
-        Atom *states = (Atom *)prop;
-        int has_max_vert = 0, has_max_horz = 0;
-        for (unsigned long i = 0; i < nitems; i++) {
-            if (states[i] == maximized_vert) has_max_vert = 1;
-            if (states[i] == maximized_horz) has_max_horz = 1;
-            if (states[i] == hidden) info->is_minimized = 1;
-        }
-        if (has_max_vert && has_max_horz) info->is_maximized = 1;
-        XFree(prop);
+    xcb_atom_t *states = (xcb_atom_t *)xcb_get_property_value(reply);
+    int nitems = xcb_get_property_value_length(reply) / (int)sizeof(xcb_atom_t);
+    int has_max_vert = 0, has_max_horz = 0;
+    for (int i = 0; i < nitems; i++) {
+        if (states[i] == atoms->net_wm_state_maximized_vert) has_max_vert = 1;
+        if (states[i] == atoms->net_wm_state_maximized_horz) has_max_horz = 1;
+        if (states[i] == atoms->net_wm_state_hidden) info->is_minimized = 1;
     }
+    if (has_max_vert && has_max_horz) info->is_maximized = 1;
+    free(reply);
 }
 
-static int get_window_desktop(Display *display, Window window) {
-    Atom net_wm_desktop = XInternAtom(display, "_NET_WM_DESKTOP", True);
-    if (net_wm_desktop == None) return 0;
-
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *prop = NULL;
-
-    int result = XGetWindowProperty(display, window, net_wm_desktop,
-        0, 1, False, XA_CARDINAL,
-        &actual_type, &actual_format, &nitems, &bytes_after, &prop);
+static void read_geometry(xcb_connection_t *conn, const WindowCookies *c, WindowInfo *info) {
+    xcb_generic_error_t *err = NULL;
 
-    if (result != Success || !prop) return 0;
+    xcb_get_geometry_reply_t *geom = xcb_get_geometry_reply(conn, c->geometry, &err);
+    free(err);
+    err = NULL;
+    if (geom) {
+        info->width = geom->width;
+        info->height = geom->height;
+        free(geom);
+    }
 
-    int desktop = (int)(*(unsigned long *)prop);
-    XFree(prop);
-    return desktop;
+    xcb_translate_coordinates_reply_t *origin =
+        xcb_translate_coordinates_reply(conn, c->origin, &err);
+    free(err);
+    if (origin) {
+        info->x = origin->dst_x;
+        info->y = origin->dst_y;
+        free(origin);
+    }
 }
 
-static void get_process_cmd(int pid, WindowInfo *info) {
-    char path[256];
-    snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+/* collects every reply for one window, returns the window's pid or -1 if it has none */
+static int collect_window(xcb_connection_t *conn, const AtomTable *atoms,
+    const WindowCookies *c, Window window, WindowList *list, WindowInfo *info) {
+    info->window_id = window;
 
-    FILE *f = fopen(path, "r");
-    if (!f) return;
+    info->pid = read_cardinal(conn, c->pid, -1);
+    read_title(conn, c->name, list, info);
+    read_wm_class(conn, c->wm_class, list, info);
+    read_state(conn, atoms, c->state, info);
+    info->desktop = read_cardinal(conn, c->desktop, 0);
+    read_geometry(conn, c, info);
+
+    return info->pid;
+}
 
-    char buf[MAX_CMD_ARGS * MAX_ARG_LEN];
-    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
-    fclose(f);
-    buf[len] = '\0';
+static void get_process_cmd(int pid, WindowList *list, WindowInfo *info) {
+    const ProcInfo *proc = proc_cache_lookup(pid);
+    if (!proc) return;
 
-    info->cmd_argc = 0;
     size_t i = 0;
-    while (i < len && info->cmd_argc < MAX_CMD_ARGS) {
-        strncpy(info->cmd[info->cmd_argc], buf + i, MAX_ARG_LEN - 1);
-        info->cmd[info->cmd_argc][MAX_ARG_LEN - 1] = '\0';
-        i += strlen(buf + i) + 1;
-        info->cmd_argc++;
+    while (i < proc->argv_len) {
+        size_t arg_len = strnlen(proc->argv + i, proc->argv_len - i);
+        if (add_window_arg(list, info, proc->argv + i, arg_len) != 0) break;
+        i += arg_len + 1;
     }
 
-    char exe_path[256];
-    snprintf(exe_path, sizeof(exe_path), "/proc/%d/exe", pid);
-    ssize_t r = readlink(exe_path, info->exe_path, sizeof(info->exe_path) - 1);
-    if (r > 0) info->exe_path[r] = '\0';
+    if (proc->exe_len > 0) info->exe_path = store_string(list, proc->exe, proc->exe_len);
 }
 
-static int is_system_process(const char *cmd) {
-    const char *system_procs[] = {
-        "systemd", "dbus", "Xorg", "xfce4-session", "xfwm4",
-        "xfdesktop", "xfce4-panel", "pulseaudio", "pipewire",
-        "bash", "sh", "zsh", "fish", NULL
-    };
-    for (int i = 0; system_procs[i] != NULL; i++) {
-        if (strstr(cmd, system_procs[i])) return 1;
+/*
+ * where the window's work happens: for a terminal that is the command or shell in its
+ * foreground, so restore can reopen it in the same directory. other windows get their
+ * own process's cwd.
+ */
+static void get_process_context(int pid, WindowList *list, WindowInfo *info) {
+    int job = proc_foreground(pid);
+
+    char cwd[PATH_MAX];
+    ssize_t len = read_proc_cwd(job ? job : pid, cwd, sizeof(cwd));
+    if (len > 0) info->cwd = store_string(list, cwd, (size_t)len);
+
+    const ProcInfo *proc = job ? proc_cache_lookup(job) : NULL;
+    if (!proc) return;
+
+    size_t i = 0;
+    while (i < proc->argv_len) {
+        size_t arg_len = strnlen(proc->argv + i, proc->argv_len - i);
+        if (add_window_job_arg(list, info, proc->argv + i, arg_len) != 0) break;
+        i += arg_len + 1;
     }
-    return 0;
 }
 
-WindowList *capture_windows(Display *display) {
-    WindowList *list = calloc(1, sizeof(WindowList));
-    if (!list) return NULL;
+/* the files restore prefetches before relaunching the window's app, shared paths are stored once per list */
+static void get_process_maps(int pid, WindowList *list, WindowInfo *info) {
+    const ProcInfo *proc = proc_cache_lookup(pid);
+    if (!proc) return;
 
-    Window root = DefaultRootWindow(display);
-    Atom net_client_list = XInternAtom(display, "_NET_CLIENT_LIST", True);
-    if (net_client_list == None) {
-        fprintf(stderr, "sessionsnap: _NET_CLIENT_LIST not supported\n");
-        return list;
+    size_t i = 0;
+    while (i < proc->maps_len) {
+        size_t path_len = strnlen(proc->maps + i, proc->maps_len - i);
+        if (add_window_map(list, info, proc->maps + i, path_len) != 0) break;
+        i += path_len + 1;
     }
+}
+
+/* returns the root _NET_CLIENT_LIST, caller releases it with XFree */
+Window *get_client_list(Display *display, unsigned long *count) {
+    *count = 0;
+
+    const AtomTable *atoms = get_atoms(display);
+    if (!atoms) return NULL;
 
     Atom actual_type;
     int actual_format;
     unsigned long nitems, bytes_after;
     unsigned char *data = NULL;
 
-    if (XGetWindowProperty(display, root, net_client_list,
+    if (XGetWindowProperty(display, DefaultRootWindow(display), atoms->net_client_list,
         0, (~0L), False, XA_WINDOW,
         &actual_type, &actual_format, &nitems, &bytes_after, &data) != Success) {
-        return list;
+        return NULL;
     }
 
-    Window *windows = (Window *)data;
+    if (!data) {
+        fprintf(stderr, "sessionsnap: _NET_CLIENT_LIST not supported\n");
+        return NULL;
+    }
+
+    *count = nitems;
+    return (Window *)data;
+}
+
+/* grows the cookie array every capture reuses, capture only ever runs on one thread */
+static WindowCookies *reserve_cookies(unsigned long count) {
+    static WindowCookies *cookies = NULL;
+    static unsigned long cap = 0;
+
+    if (count > cap) {
+        unsigned long n = cap ? cap : 64;
+        while (n < count) n *= 2;
+        WindowCookies *grown = realloc(cookies, n * sizeof(WindowCookies));
+        if (!grown) return NULL;
+        cookies = grown;
+        cap = n;
+    }
+    return cookies;
+}
 
-    for (unsigned long i = 0; i < nitems && list->count < MAX_WINDOWS; i++) {
-        WindowInfo info;
-        memset(&info, 0, sizeof(info));
+/*
+ * captures the given client windows into list, which is cleared first, skipping those
+ * without a pid, without a cmdline, or excluded by a filter rule. every X request for
+ * every window is pipelined through XCB before the first reply is read, so the whole
+ * set costs about one round trip instead of several per window. a list that already
+ * has room is filled without allocating. returns the number of windows kept.
+ */
+int capture_window_set_into(Display *display, const Window *windows, unsigned long count, WindowList *list) {
+    clear_window_list(list);
+    if (count == 0) return 0;
 
-        info.window_id = windows[i];
-        info.pid = get_window_pid(display, windows[i]);
+    const AtomTable *atoms = get_atoms(display);
+    WindowCookies *cookies = reserve_cookies(count);
+    if (!atoms || !cookies) return 0;
 
-        if (info.pid <= 0) continue;
+    uint64_t start = stats_now_ns();
+    uint64_t proc_ns = 0;
+    unsigned long counted[STAT_COUNTERS] = {0};
 
-        char *name = NULL;
-        XFetchName(display, windows[i], &name);
-        if (name) {
-            strncpy(info.title, name, sizeof(info.title) - 1);
-            XFree(name);
-        }
+    /* drain Xlib's output buffer first so our requests are sequenced after it */
+    XFlush(display);
 
-        get_window_geometry(display, windows[i], &info);
-        get_window_state(display, windows[i], &info);
-        info.desktop = get_window_desktop(display, windows[i]);
-        get_process_cmd(info.pid, &info);
+    xcb_connection_t *conn = XGetXCBConnection(display);
+    xcb_window_t root = (xcb_window_t)DefaultRootWindow(display);
 
-        if (info.cmd_argc > 0 && is_system_process(info.cmd[0])) continue;
-        if (info.cmd_argc == 0) continue;
+    for (unsigned long i = 0; i < count; i++) {
+        request_window(conn, atoms, root, (xcb_window_t)windows[i], &cookies[i]);
+    }
+    xcb_flush(conn);
+
+    uint64_t proc_start = stats_now_ns();
+    proc_cache_begin();
+    proc_ns += stats_now_ns() - proc_start;
+
+    for (unsigned long i = 0; i < count; i++) {
+        /* a skipped window rolls the arena back to where it started */
+        size_t strings_mark = list->strings_len;
+        int args_mark = list->args_len;
+
+        /* replies must be drained even if the list can't grow */
+        WindowInfo scratch = {0};
+        WindowInfo *info = add_window(list);
+
+        int keep = collect_window(conn, atoms, &cookies[i], windows[i], list,
+            info ? info : &scratch) > 0 && info;
+        StatCounter outcome = keep ? STAT_WINDOWS_CAPTURED : STAT_WINDOWS_NO_PID;
+        if (keep) {
+            proc_start = stats_now_ns();
+            get_process_cmd(info->pid, list, info);
+            proc_ns += stats_now_ns() - proc_start;
+
+            if (info->cmd_argc == 0) outcome = STAT_WINDOWS_NO_CMDLINE;
+            else if (filter_window(list, info)) outcome = STAT_WINDOWS_SYSTEM;
+            keep = outcome == STAT_WINDOWS_CAPTURED;
+
+            if (keep) {
+                proc_start = stats_now_ns();
+                get_process_context(info->pid, list, info);
+                /* only once kept: a dropped window's strings are rolled back, interned paths can't be */
+                get_process_maps(info->pid, list, info);
+                proc_ns += stats_now_ns() - proc_start;
+            }
+        }
+        counted[outcome]++;
 
-        list->windows[list->count++] = info;
+        if (!keep) {
+            if (info) list->count--;
+            list->strings_len = strings_mark;
+            list->args_len = args_mark;
+        }
     }
 
-    XFree(data);
+    /* replies arrive while we read /proc, so the X phase is whatever the loop didn't spend there */
+    stats_record(STAT_X_QUERY, stats_now_ns() - start - proc_ns);
+    stats_record(STAT_PROC, proc_ns);
+    for (int c = 0; c < STAT_COUNTERS; c++) stats_count((StatCounter)c, counted[c]);
+    return list->count;
+}
+
+WindowList *capture_window_set(Display *display, const Window *windows, unsigned long count) {
+    WindowList *list = new_window_list();
+    if (list) capture_window_set_into(display, windows, count, list);
     return list;
 }
 
-void free_window_list(WindowList *list) {
-    free(list);
-}
\ No newline at end of file
+WindowList *capture_windows(Display *display) {
+    unsigned long nitems;
+    Window *windows = get_client_list(display, &nitems);
+
+    WindowList *list = capture_window_set(display, windows, nitems);
+    if (windows) XFree(windows);
+    return list;
+}
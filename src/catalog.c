@@ -0,0 +1,401 @@
+/*
+ * catalog.c — keeps ~/.sessionsnap/profiles.idx, a summary of every saved profile
+ * talks to: catalog.h, session.c (load_session for rebuilds, paths, whose home), snapfile.c (crc32_update)
+ * imports: sys/file.h for flock() so concurrent saves don't lose each other's entries, dirent.h to
+ * rebuild from the sessions dir, fcntl/unistd for pread/pwrite
+ * functions: catalog_stamp(), catalog_update(), load_catalog(), print_profiles(), rebuild_catalog(),
+ * read_catalog(), write_catalog(), summarize_apps()
+ *
+ * the file is a header and one fixed-size record per profile, sorted by name. the header
+ * holds the mtime, size and inode of the sessions dir and of the default profile's file
+ * as of the last time the records were known to match them. a reader stats those two and
+ * trusts the records if nothing moved, otherwise it rescans. a save stamps what it is
+ * about to change first, so afterwards it can tell its own change from someone else's
+ * and only touch its own record. the file is rewritten in place, never renamed, and a
+ * torn write fails the checksum and is rebuilt like any other stale index.
+ */
+
+#define _GNU_SOURCE
+#include "../include/catalog.h"
+#include "../include/session.h"
+#include "../include/snapfile.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#define CATALOG_MAGIC "SSPC"
+#define CATALOG_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t count;
+    uint32_t checksum;      /* CRC-32 of the records */
+    CatalogStamp dir;       /* SESSIONS_DIR when the records last matched it */
+    CatalogStamp base;      /* the default profile's session file, likewise */
+} CatalogHeader;
+
+/* grow-only, so once the index is loaded the daemon's saves don't allocate */
+static ProfileSummary *entries = NULL;
+static uint32_t entry_count = 0;
+static uint32_t entry_cap = 0;
+
+static int is_default(const char *name) {
+    return !name || strcmp(name, "default") == 0;
+}
+
+static void stamp_path(const char *path, CatalogStamp *out) {
+    struct stat st;
+    memset(out, 0, sizeof(*out));
+    if (stat(path, &st) != 0) return;
+
+    out->sec = st.st_mtim.tv_sec;
+    out->nsec = st.st_mtim.tv_nsec;
+    out->size = (uint64_t)st.st_size;
+    out->ino = (uint64_t)st.st_ino;
+}
+
+static void stamp_sessions_dir(CatalogStamp *out) {
+    const char *home = get_session_home();
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", home ? home : "/tmp", SESSIONS_DIR);
+    stamp_path(path, out);
+}
+
+/* load_session() reads the .snap file if there is one, else the .json */
+static void stamp_default(CatalogStamp *out) {
+    char path[512];
+    get_session_path(path, sizeof(path), "default");
+    stamp_path(path, out);
+    if (out->ino) return;
+
+    get_session_json_path(path, sizeof(path), "default");
+    stamp_path(path, out);
+}
+
+static int stamps_equal(const CatalogStamp *a, const CatalogStamp *b) {
+    return memcmp(a, b, sizeof(*a)) == 0;
+}
+
+/* what a save of profile_name is about to change: the default's own file, or the sessions dir */
+void catalog_stamp(const char *profile_name, CatalogStamp *out) {
+    if (is_default(profile_name)) stamp_default(out);
+    else stamp_sessions_dir(out);
+}
+
+static int reserve_entries(uint32_t count) {
+    if (count <= entry_cap) return 0;
+
+    uint32_t cap = entry_cap ? entry_cap : 64;
+    while (cap < count) cap *= 2;
+    ProfileSummary *grown = realloc(entries, (size_t)cap * sizeof(ProfileSummary));
+    if (!grown) return -1;
+    entries = grown;
+    entry_cap = cap;
+    return 0;
+}
+
+/* inserts s in name order, replacing the record of the same name */
+static int put_entry(const ProfileSummary *s) {
+    uint32_t at = 0;
+    while (at < entry_count && strcmp(entries[at].name, s->name) < 0) at++;
+
+    if (at < entry_count && strcmp(entries[at].name, s->name) == 0) {
+        entries[at] = *s;
+        return 0;
+    }
+    if (reserve_entries(entry_count + 1) != 0) return -1;
+
+    memmove(&entries[at + 1], &entries[at], (size_t)(entry_count - at) * sizeof(ProfileSummary));
+    entries[at] = *s;
+    entry_count++;
+    return 0;
+}
+
+static int has_app(const char *apps, const char *app, size_t n) {
+    for (const char *p = apps; *p; ) {
+        const char *end = strstr(p, ", ");
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+        if (len == n && memcmp(p, app, n) == 0) return 1;
+        if (!end) break;
+        p = end + 2;
+    }
+    return 0;
+}
+
+/* distinct app names in window order: argv[0]'s basename, or the WM class without an argv */
+static void summarize_apps(const WindowList *list, char *out, size_t size) {
+    size_t len = 0;
+    out[0] = '\0';
+
+    for (int i = 0; i < list->count; i++) {
+        const WindowInfo *w = &list->windows[i];
+        const char *app = w->cmd_argc > 0 ? window_arg(list, w, 0) : window_wm_class(list, w);
+        const char *slash = strrchr(app, '/');
+        if (slash) app = slash + 1;
+
+        size_t n = strlen(app);
+        if (n == 0 || has_app(out, app, n)) continue;
+
+        size_t sep = len ? 2 : 0;
+        if (len + sep + n + 1 > size) break;
+        memcpy(out + len, ", ", sep);
+        memcpy(out + len + sep, app, n);
+        len += sep + n;
+        out[len] = '\0';
+    }
+}
+
+static void summarize(const char *name, const WindowList *list, const char *path, int json, ProfileSummary *out) {
+    memset(out, 0, sizeof(*out));
+    snprintf(out->name, sizeof(out->name), "%s", name);
+    out->json = (uint32_t)json;
+
+    if (list) {
+        out->windows = (uint32_t)list->count;
+        summarize_apps(list, out->apps, sizeof(out->apps));
+    } else {
+        snprintf(out->apps, sizeof(out->apps), "(unreadable)");
+    }
+
+    struct stat st;
+    if (stat(path, &st) == 0) {
+        out->saved = (int64_t)st.st_mtime;
+        out->size = (uint64_t)st.st_size;
+    }
+}
+
+/* reads one profile back from disk, for rebuilds only */
+static int summarize_profile(const char *name, ProfileSummary *out) {
+    char path[512];
+    int json = 0;
+
+    get_session_path(path, sizeof(path), name);
+    if (access(path, F_OK) != 0) {
+        get_session_json_path(path, sizeof(path), name);
+        if (access(path, F_OK) != 0) return -1;
+        json = 1;
+    }
+
+    WindowList *list = load_session(name);
+    summarize(name, list, path, json, out);
+    free_window_list(list);
+    return 0;
+}
+
+/* replaces the records with what the session files say now */
+static void rebuild_catalog(void) {
+    entry_count = 0;
+
+    ProfileSummary s;
+    if (summarize_profile("default", &s) == 0) put_entry(&s);
+
+    const char *home = get_session_home();
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", home ? home : "/tmp", SESSIONS_DIR);
+    DIR *dir = opendir(path);
+    if (!dir) return;
+
+    struct dirent *de;
+    while ((de = readdir(dir))) {
+        char name[128];
+        size_t len = strlen(de->d_name);
+        if (len <= 5 || len - 5 >= sizeof(name)) continue;
+
+        const char *ext = de->d_name + len - 5;
+        if (strcmp(ext, ".snap") != 0 && strcmp(ext, ".json") != 0) continue;
+        memcpy(name, de->d_name, len - 5);
+        name[len - 5] = '\0';
+        if (!valid_profile_name(name) || is_default(name)) continue;
+
+        /* a profile saved since it was imported has both, the .snap is the one that's read */
+        if (ext[1] == 'j') {
+            snprintf(path, sizeof(path), "%s.snap", name);
+            if (faccessat(dirfd(dir), path, F_OK, 0) == 0) continue;
+        }
+        if (summarize_profile(name, &s) == 0) put_entry(&s);
+    }
+    closedir(dir);
+}
+
+static int read_all(int fd, void *buf, size_t len, off_t at) {
+    while (len > 0) {
+        ssize_t n = pread(fd, buf, len, at);
+        if (n <= 0) return -1;
+        buf = (char *)buf + n;
+        len -= (size_t)n;
+        at += n;
+    }
+    return 0;
+}
+
+static int write_all(int fd, const void *buf, size_t len, off_t at) {
+    while (len > 0) {
+        ssize_t n = pwrite(fd, buf, len, at);
+        if (n <= 0) return -1;
+        buf = (const char *)buf + n;
+        len -= (size_t)n;
+        at += n;
+    }
+    return 0;
+}
+
+/* loads the records into entries, -1 if the file is missing, foreign, truncated or torn */
+static int read_catalog(int fd, CatalogHeader *h) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(*h) || read_all(fd, h, sizeof(*h), 0) != 0) return -1;
+    if (memcmp(h->magic, CATALOG_MAGIC, 4) != 0 || h->version != CATALOG_VERSION) return -1;
+
+    size_t len = (size_t)h->count * sizeof(ProfileSummary);
+    if ((size_t)st.st_size != sizeof(*h) + len || reserve_entries(h->count) != 0) return -1;
+    if (len && read_all(fd, entries, len, sizeof(*h)) != 0) return -1;
+    if (crc32_update(0, entries, len) != h->checksum) return -1;
+
+    entry_count = h->count;
+    return 0;
+}
+
+static int write_catalog(int fd, CatalogHeader *h) {
+    size_t len = (size_t)entry_count * sizeof(ProfileSummary);
+    memcpy(h->magic, CATALOG_MAGIC, 4);
+    h->version = CATALOG_VERSION;
+    h->count = entry_count;
+    h->checksum = crc32_update(0, entries, len);
+
+    if (write_all(fd, h, sizeof(*h), 0) != 0 || (len && write_all(fd, entries, len, sizeof(*h)) != 0)) return -1;
+    return ftruncate(fd, (off_t)(sizeof(*h) + len));
+}
+
+static int open_catalog(int writable) {
+    const char *home = get_session_home();
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", home ? home : "/tmp", CATALOG_FILE);
+
+    int fd = open(path, (writable ? O_RDWR | O_CREAT : O_RDONLY) | O_CLOEXEC, 0644);
+    if (fd < 0) return -1;
+    if (flock(fd, writable ? LOCK_EX : LOCK_SH) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * called by save_session() once profile_name's file is written, with the stamp taken
+ * before it was. if the index was current up to that write, only this profile's record
+ * changes; if anything else moved in the meantime, it is rebuilt.
+ */
+void catalog_update(const char *profile_name, const WindowList *list, const CatalogStamp *before) {
+    CatalogStamp dir, base;
+    stamp_sessions_dir(&dir);
+    stamp_default(&base);
+
+    int fd = open_catalog(1);
+    if (fd < 0) return;
+
+    int def = is_default(profile_name);
+    CatalogHeader h;
+    int current = read_catalog(fd, &h) == 0 &&
+        stamps_equal(def ? &h.base : &h.dir, before) &&
+        stamps_equal(def ? &h.dir : &h.base, def ? &dir : &base);
+
+    if (current) {
+        char path[512];
+        ProfileSummary s;
+        get_session_path(path, sizeof(path), profile_name);
+        summarize(def ? "default" : profile_name, list, path, 0, &s);
+        put_entry(&s);
+    } else {
+        rebuild_catalog();
+    }
+
+    memset(&h, 0, sizeof(h));
+    h.dir = dir;
+    h.base = base;
+    if (write_catalog(fd, &h) != 0) fprintf(stderr, "sessionsnap: failed to write the profile index\n");
+    close(fd);
+}
+
+/*
+ * returns the number of profiles and a malloc'd copy of their summaries, sorted by name.
+ * one read of the index when it is current, a rescan of the session files when it isn't
+ */
+int load_catalog(ProfileSummary **out) {
+    *out = NULL;
+
+    CatalogStamp dir, base;
+    stamp_sessions_dir(&dir);
+    stamp_default(&base);
+
+    CatalogHeader h;
+    int fd = open_catalog(0);
+    int current = fd >= 0 && read_catalog(fd, &h) == 0 &&
+        stamps_equal(&h.dir, &dir) && stamps_equal(&h.base, &base);
+    if (fd >= 0) close(fd);
+
+    if (!current) {
+        /* without a ~/.sessionsnap there is nothing to index, the rescan just finds nothing */
+        fd = open_catalog(1);
+
+        /* whoever held the lock before us may have rebuilt it already */
+        stamp_sessions_dir(&dir);
+        stamp_default(&base);
+        current = fd >= 0 && read_catalog(fd, &h) == 0 &&
+            stamps_equal(&h.dir, &dir) && stamps_equal(&h.base, &base);
+
+        if (!current) {
+            rebuild_catalog();
+            memset(&h, 0, sizeof(h));
+            h.dir = dir;
+            h.base = base;
+            if (fd >= 0 && write_catalog(fd, &h) != 0) {
+                fprintf(stderr, "sessionsnap: failed to write the profile index\n");
+            }
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    if (entry_count == 0) return 0;
+    *out = malloc((size_t)entry_count * sizeof(ProfileSummary));
+    if (!*out) return -1;
+    memcpy(*out, entries, (size_t)entry_count * sizeof(ProfileSummary));
+    return (int)entry_count;
+}
+
+/* --list-profiles */
+int print_profiles(FILE *out) {
+    ProfileSummary *profiles;
+    int count = load_catalog(&profiles);
+    if (count < 0) {
+        fprintf(stderr, "sessionsnap: out of memory\n");
+        return -1;
+    }
+    if (count == 0) {
+        fprintf(out, "no saved profiles\n");
+        return 0;
+    }
+
+    int width = 7;
+    for (int i = 0; i < count; i++) {
+        int len = (int)strlen(profiles[i].name);
+        if (len > width) width = len < 32 ? len : 32;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const ProfileSummary *p = &profiles[i];
+        char when[32] = "-";
+        time_t t = (time_t)p->saved;
+        struct tm tm;
+        if (p->saved && localtime_r(&t, &tm)) strftime(when, sizeof(when), "%Y-%m-%d %H:%M", &tm);
+
+        fprintf(out, "%-*s  %4u windows  %s  %7.1f KB  %s%s\n", width, p->name, p->windows, when,
+            (double)p->size / 1024.0, p->apps, p->json ? " (json)" : "");
+    }
+    free(profiles);
+    return 0;
+}
@@ -0,0 +1,220 @@
+/*
+ * control.c — Unix domain socket between the CLI and a running daemon
+ * talks to: control.h, monitor.c (listen/accept side), main.c (control_request), session.h for the dir
+ * imports: sys/socket.h and sys/un.h, SO_PEERCRED so only our own uid is served
+ * functions: get_control_path(), control_listen(), control_accept(), control_read(), control_close(),
+ * control_request(), write_window_list(), set_timeouts()
+ *
+ * every request is one short line on a fresh connection and the daemon closes it
+ * after replying, so the CLI just reads to EOF. the daemon reads the line without
+ * blocking as it arrives, from its event loop, so a client that connects and then
+ * stalls holds a slot until CONTROL_IO_TIMEOUT_MS and never the loop itself.
+ */
+
+#define _GNU_SOURCE
+#include "../include/control.h"
+#include "../include/session.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+
+void get_control_path(char *out, size_t size) {
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && runtime[0]) {
+        snprintf(out, size, "%s/%s", runtime, CONTROL_SOCKET);
+        return;
+    }
+
+    const char *home = getenv("HOME");
+    snprintf(out, size, "%s%s/%s", home ? home : "/tmp", SESSION_DIR, CONTROL_SOCKET);
+}
+
+static int fill_address(struct sockaddr_un *addr) {
+    char path[512];
+    get_control_path(path, sizeof(path));
+
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        fprintf(stderr, "sessionsnap: control socket path too long: %s\n", path);
+        return -1;
+    }
+    memcpy(addr->sun_path, path, strlen(path) + 1);
+    return 0;
+}
+
+static void set_timeouts(int fd) {
+    struct timeval tv = { CONTROL_IO_TIMEOUT_MS / 1000, (CONTROL_IO_TIMEOUT_MS % 1000) * 1000 };
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+}
+
+static int connect_daemon(void) {
+    struct sockaddr_un addr;
+    if (fill_address(&addr) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * binds the control socket, returns the listening fd or -1. a socket file left by a
+ * daemon that died is replaced, one that still answers means a daemon is running.
+ */
+int control_listen(void) {
+    struct sockaddr_un addr;
+    if (fill_address(&addr) != 0) return -1;
+
+    int live = connect_daemon();
+    if (live >= 0) {
+        close(live);
+        fprintf(stderr, "sessionsnap: another daemon is already listening on %s\n", addr.sun_path);
+        return -1;
+    }
+    unlink(addr.sun_path);
+
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    const char *home = getenv("HOME");
+    if (!(runtime && runtime[0]) && home) {
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s%s", home, SESSION_DIR);
+        mkdir(dir, 0755);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC | SOCK_NONBLOCK, 0);
+    if (fd < 0) return -1;
+
+    mode_t old_mask = umask(0077);
+    int bound = bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+    umask(old_mask);
+
+    if (bound != 0 || listen(fd, 8) != 0) {
+        fprintf(stderr, "sessionsnap: cannot listen on %s\n", addr.sun_path);
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * accepts one pending client, returns its non-blocking fd, -2 for a connection from
+ * another uid that was closed, or -1 once none is left
+ */
+int control_accept(int listen_fd) {
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC | SOCK_NONBLOCK);
+    if (fd < 0) return -1;
+
+    struct ucred cred;
+    socklen_t len = sizeof(cred);
+    if (getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0 || cred.uid != getuid()) {
+        close(fd);
+        return -2;
+    }
+    return fd;
+}
+
+/*
+ * reads what has arrived of client's request line. returns 1 once the whole line is in
+ * client->request, with the fd switched to blocking writes bounded by CONTROL_IO_TIMEOUT_MS
+ * for the reply, 0 while more is to come, -1 if the client hung up or sent too much
+ */
+int control_read(ControlClient *client) {
+    for (;;) {
+        ssize_t n = read(client->fd, client->request + client->used, sizeof(client->request) - 1 - client->used);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return 0;
+        if (n <= 0) return -1;
+
+        char *end = memchr(client->request + client->used, '\n', (size_t)n);
+        client->used += (size_t)n;
+        if (end) {
+            *end = '\0';
+            int flags = fcntl(client->fd, F_GETFL);
+            if (flags < 0 || fcntl(client->fd, F_SETFL, flags & ~O_NONBLOCK) != 0) return -1;
+            set_timeouts(client->fd);
+            return 1;
+        }
+        if (client->used + 1 >= sizeof(client->request)) return -1;
+    }
+}
+
+void control_close(int listen_fd) {
+    if (listen_fd < 0) return;
+    close(listen_fd);
+
+    char path[512];
+    get_control_path(path, sizeof(path));
+    unlink(path);
+}
+
+/*
+ * sends request to the running daemon and copies the reply body to out. returns 0 on
+ * success, CONTROL_FAILED if the daemon refused, CONTROL_NO_DAEMON if none is listening
+ * so the caller can do the work itself.
+ */
+int control_request(const char *request, FILE *out) {
+    int fd = connect_daemon();
+    if (fd < 0) return CONTROL_NO_DAEMON;
+    set_timeouts(fd);
+
+    char line[CONTROL_REQUEST_MAX + 1];
+    int len = snprintf(line, sizeof(line), "%s\n", request);
+    if (len < 0 || (size_t)len >= sizeof(line) || write(fd, line, (size_t)len) != len) {
+        close(fd);
+        return CONTROL_NO_DAEMON;
+    }
+
+    FILE *in = fdopen(fd, "r");
+    if (!in) {
+        close(fd);
+        return CONTROL_NO_DAEMON;
+    }
+
+    char status[CONTROL_REQUEST_MAX];
+    if (!fgets(status, sizeof(status), in)) {
+        fclose(in);
+        fprintf(stderr, "sessionsnap: daemon closed the connection without replying\n");
+        return CONTROL_FAILED;
+    }
+    status[strcspn(status, "\n")] = '\0';
+
+    if (strcmp(status, "ok") != 0) {
+        fclose(in);
+        const char *reason = strncmp(status, "error ", 6) == 0 ? status + 6 : status;
+        fprintf(stderr, "sessionsnap: daemon: %s\n", reason);
+        return CONTROL_FAILED;
+    }
+
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) fwrite(buf, 1, n, out);
+    fclose(in);
+    return 0;
+}
+
+/* the --list output, shared by the direct path and the daemon so both print the same thing */
+void write_window_list(FILE *out, const WindowList *list) {
+    fprintf(out, "Found %d user windows:\n\n", list->count);
+    for (int j = 0; j < list->count; j++) {
+        const WindowInfo *w = &list->windows[j];
+        const char *title = window_title(list, w);
+        fprintf(out, "[%d] %s\n", j + 1, title[0] ? title : "(no title)");
+        fprintf(out, "    PID: %d  |  pos: %d,%d  |  size: %dx%d  |  desktop: %d\n",
+            w->pid, w->x, w->y, w->width, w->height, w->desktop);
+        fprintf(out, "    cmd: %s\n", w->cmd_argc > 0 ? window_arg(list, w, 0) : "(unknown)");
+        if (w->job_argc > 0) fprintf(out, "    running: %s\n", window_job_arg(list, w, 0));
+        if (window_cwd(list, w)[0]) fprintf(out, "    cwd: %s\n", window_cwd(list, w));
+        fputc('\n', out);
+    }
+}
@@ -0,0 +1,448 @@
+/*
+ * filter.c — compiles the filter rules and checks captured windows against them
+ * talks to: filter.h, capture.c (filter_window per window), session.c (whose home the rules come from),
+ *           stats.c (write_filter_stats)
+ * imports: fnmatch.h to confirm glob and title candidates
+ * functions: filter_window(), write_filter_stats(), load_filter_rules(), compile_rules(), build_automaton(),
+ * scan_automaton()
+ *
+ * filter-rules holds one "<include|exclude> <name|glob|class|title> <pattern>" per line,
+ * lines starting with '#' are comments. name (basename of argv[0]) and class (WM_CLASS)
+ * rules are exact and share one hash table, so each costs a single probe however many
+ * there are. glob rules match argv[0], or only its basename when the pattern has no '/',
+ * and title rules match the title, both with fnmatch(). the longest literal run of each
+ * of those goes into an Aho-Corasick automaton, so one pass over argv[0] and one over the
+ * title name the few rules that could match and only those are fnmatch'd.
+ */
+
+#include "../include/filter.h"
+#include "../include/session.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fnmatch.h>
+
+#define FNV_OFFSET 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+
+typedef enum { MATCH_NAME, MATCH_GLOB, MATCH_CLASS, MATCH_TITLE } MatchKind;
+
+static const char *kind_names[] = { "name", "glob", "class", "title" };
+
+typedef struct {
+    char *pattern;
+    MatchKind kind;
+    int exclude;
+    int line;               /* in the rules file, 0 for a built-in rule */
+    int full_path;          /* a glob with a '/' matches all of argv[0], not just its basename */
+    unsigned long hits;
+    unsigned long tried;    /* the check that last fnmatch'd this rule */
+} FilterRule;
+
+/*
+ * a dense DFA over the bytes that occur in some literal, every other byte is class 0.
+ * head/next chain the rules whose literal ends in a state, dict links a state to the
+ * nearest suffix state that has rules of its own (0 for none).
+ */
+typedef struct {
+    unsigned char byte_class[256];
+    int classes;
+    int states;
+    int patterns;
+    int *delta;
+    int *dict;
+    int *head;
+    int *next;
+} Automaton;
+
+typedef struct {
+    uint64_t hash;
+    int rule;               /* -1 for an empty slot */
+} ExactSlot;
+
+/* rules are read from the home being captured for, each user of a multi-seat daemon has their own */
+typedef struct FilterSet {
+    char home[256];
+    char path[512];
+    FilterRule *rules;
+    int count;
+    ExactSlot *exact;
+    size_t exact_mask;
+    Automaton argv0;
+    Automaton title;
+    int *unanchored;        /* globs without a literal run, candidates for every window */
+    int unanchored_count;
+    unsigned long checks;
+    struct FilterSet *next;
+} FilterSet;
+
+typedef struct {
+    const char *argv0;
+    const char *base;
+    const char *title;
+} FilterSubject;
+
+/* what the old hardcoded list meant, as whole names, so "ssh-askpass" or "flash" no longer match "sh" */
+static const char *default_rules[] = {
+    "exclude glob systemd*",
+    "exclude glob dbus-*",
+    "exclude name Xorg",
+    "exclude name xfce4-session",
+    "exclude name xfwm4",
+    "exclude name xfdesktop",
+    "exclude name xfce4-panel",
+    "exclude name pulseaudio",
+    "exclude name pipewire",
+    "exclude name bash",
+    "exclude name sh",
+    "exclude name zsh",
+    "exclude name fish",
+    NULL
+};
+
+static FilterSet *filter_sets = NULL;
+
+static uint64_t hash_key(MatchKind kind, const char *s) {
+    uint64_t h = (FNV_OFFSET ^ (uint64_t)kind) * FNV_PRIME;
+    for (; *s; s++) {
+        h ^= (unsigned char)*s;
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static char *next_word(char **p) {
+    char *s = *p + strspn(*p, " \t");
+    char *end = s + strcspn(s, " \t");
+    *p = *end ? end + 1 : end;
+    *end = '\0';
+    return s;
+}
+
+/* parses one rule line in place, returns -1 if it isn't one */
+static int add_rule(FilterSet *set, char *line, int lineno) {
+    char *p = line;
+    char *action = next_word(&p);
+    char *kind = next_word(&p);
+    char *pattern = p + strspn(p, " \t");
+    size_t len = strlen(pattern);
+    while (len > 0 && (pattern[len - 1] == ' ' || pattern[len - 1] == '\t')) pattern[--len] = '\0';
+
+    FilterRule rule = {0};
+    if (strcmp(action, "exclude") == 0) rule.exclude = 1;
+    else if (strcmp(action, "include") != 0) return -1;
+
+    int k;
+    for (k = 0; k <= MATCH_TITLE; k++) {
+        if (strcmp(kind, kind_names[k]) == 0) break;
+    }
+    if (k > MATCH_TITLE || len == 0) return -1;
+    rule.kind = (MatchKind)k;
+    rule.line = lineno;
+    rule.full_path = rule.kind == MATCH_GLOB && strchr(pattern, '/') != NULL;
+
+    FilterRule *grown = realloc(set->rules, (size_t)(set->count + 1) * sizeof(FilterRule));
+    if (!grown) return 0;
+    set->rules = grown;
+
+    rule.pattern = strdup(pattern);
+    if (!rule.pattern) return 0;
+    set->rules[set->count++] = rule;
+    return 0;
+}
+
+/* the longest run of plain characters in a glob, any string it matches contains that run */
+static size_t longest_literal(const char *glob, const char **start) {
+    size_t best = 0;
+    const char *run = glob;
+    *start = glob;
+
+    for (const char *p = glob; ; p++) {
+        if (*p != '\0' && *p != '*' && *p != '?' && *p != '[' && *p != '\\') continue;
+
+        if ((size_t)(p - run) > best) {
+            best = (size_t)(p - run);
+            *start = run;
+        }
+        if (*p == '\0') break;
+
+        if (*p == '\\' && p[1]) {
+            p++;
+        } else if (*p == '[') {
+            const char *q = p + 1;
+            if (*q == '!' || *q == '^') q++;
+            if (*q == ']') q++;
+            while (*q && *q != ']') q++;
+            if (*q) p = q;
+        }
+        run = p + 1;
+    }
+    return best;
+}
+
+static void free_automaton(Automaton *a) {
+    free(a->delta);
+    free(a->dict);
+    free(a->head);
+    free(a->next);
+    memset(a, 0, sizeof(*a));
+}
+
+/* builds the automaton over the literal runs of every rule of one kind */
+static int build_automaton(Automaton *a, FilterSet *set, MatchKind kind) {
+    memset(a, 0, sizeof(*a));
+
+    size_t total = 1;
+    int used[256] = {0};
+    for (int r = 0; r < set->count; r++) {
+        if (set->rules[r].kind != kind) continue;
+        const char *lit;
+        size_t len = longest_literal(set->rules[r].pattern, &lit);
+        total += len;
+        for (size_t i = 0; i < len; i++) used[(unsigned char)lit[i]] = 1;
+    }
+
+    a->classes = 1;
+    for (int b = 0; b < 256; b++) {
+        if (used[b]) a->byte_class[b] = (unsigned char)a->classes++;
+    }
+
+    a->delta = malloc(total * (size_t)a->classes * sizeof(int));
+    a->dict = calloc(total, sizeof(int));
+    a->head = malloc(total * sizeof(int));
+    a->next = malloc((size_t)set->count * sizeof(int));
+    int *fail = calloc(total, sizeof(int));
+    int *queue = malloc(total * sizeof(int));
+    if (!a->delta || !a->dict || !a->head || !a->next || !fail || !queue) {
+        free(fail);
+        free(queue);
+        free_automaton(a);
+        return -1;
+    }
+    memset(a->delta, 0xff, total * (size_t)a->classes * sizeof(int));
+    memset(a->head, 0xff, total * sizeof(int));
+    memset(a->next, 0xff, (size_t)set->count * sizeof(int));
+    a->states = 1;
+
+    int C = a->classes;
+    for (int r = 0; r < set->count; r++) {
+        if (set->rules[r].kind != kind) continue;
+        const char *lit;
+        size_t len = longest_literal(set->rules[r].pattern, &lit);
+        if (len == 0) continue;
+
+        int s = 0;
+        for (size_t i = 0; i < len; i++) {
+            int *t = &a->delta[s * C + a->byte_class[(unsigned char)lit[i]]];
+            if (*t < 0) *t = a->states++;
+            s = *t;
+        }
+        a->next[r] = a->head[s];
+        a->head[s] = r;
+        a->patterns++;
+    }
+
+    /* breadth first, so a state's failure target is complete before the state itself */
+    int qhead = 0, qtail = 0;
+    for (int c = 0; c < C; c++) {
+        int t = a->delta[c];
+        if (t < 0) {
+            a->delta[c] = 0;
+        } else {
+            fail[t] = 0;
+            queue[qtail++] = t;
+        }
+    }
+    while (qhead < qtail) {
+        int s = queue[qhead++];
+        for (int c = 0; c < C; c++) {
+            int t = a->delta[s * C + c];
+            int f = a->delta[fail[s] * C + c];
+            if (t < 0) {
+                a->delta[s * C + c] = f;
+                continue;
+            }
+            fail[t] = f;
+            a->dict[t] = a->head[f] >= 0 ? f : a->dict[f];
+            queue[qtail++] = t;
+        }
+    }
+
+    free(fail);
+    free(queue);
+    return 0;
+}
+
+static int compile_rules(FilterSet *set) {
+    size_t cap = 8;
+    while (cap < (size_t)set->count * 2) cap *= 2;
+    set->exact = malloc(cap * sizeof(ExactSlot));
+    set->unanchored = malloc((size_t)(set->count ? set->count : 1) * sizeof(int));
+    if (!set->exact || !set->unanchored) return -1;
+    set->exact_mask = cap - 1;
+    for (size_t i = 0; i < cap; i++) set->exact[i].rule = -1;
+
+    for (int r = 0; r < set->count; r++) {
+        FilterRule *rule = &set->rules[r];
+        if (rule->kind == MATCH_GLOB || rule->kind == MATCH_TITLE) {
+            const char *lit;
+            if (longest_literal(rule->pattern, &lit) == 0) set->unanchored[set->unanchored_count++] = r;
+            continue;
+        }
+
+        /* only the first rule for a key can ever decide, later duplicates are left out */
+        uint64_t h = hash_key(rule->kind, rule->pattern);
+        size_t i = h & set->exact_mask;
+        int duplicate = 0;
+        while (set->exact[i].rule >= 0 && !duplicate) {
+            const FilterRule *other = &set->rules[set->exact[i].rule];
+            duplicate = set->exact[i].hash == h && other->kind == rule->kind &&
+                strcmp(other->pattern, rule->pattern) == 0;
+            i = (i + 1) & set->exact_mask;
+        }
+        if (duplicate) continue;
+        set->exact[i].hash = h;
+        set->exact[i].rule = r;
+    }
+
+    if (build_automaton(&set->argv0, set, MATCH_GLOB) != 0) return -1;
+    if (build_automaton(&set->title, set, MATCH_TITLE) != 0) return -1;
+    return 0;
+}
+
+static FilterSet *load_filter_rules(void) {
+    const char *home = get_session_home();
+    if (!home) home = "/tmp";
+
+    for (FilterSet *set = filter_sets; set; set = set->next) {
+        if (strcmp(set->home, home) == 0) return set;
+    }
+
+    FilterSet *set = calloc(1, sizeof(FilterSet));
+    if (!set) return NULL;
+    snprintf(set->home, sizeof(set->home), "%s", home);
+    snprintf(set->path, sizeof(set->path), "%s%s", home, FILTER_RULES_FILE);
+    set->next = filter_sets;
+    filter_sets = set;
+
+    char line[1024], parsed[1024];
+    FILE *f = fopen(set->path, "r");
+    int lineno = 0;
+    while (f && fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "\r\n")] = '\0';
+        const char *s = line + strspn(line, " \t");
+        if (*s == '\0' || *s == '#') continue;
+
+        memcpy(parsed, line, sizeof(parsed));
+        if (add_rule(set, parsed, lineno) != 0) {
+            fprintf(stderr, "sessionsnap: %s:%d: bad filter rule '%s'\n", set->path, lineno, s);
+        }
+    }
+    if (f) fclose(f);
+
+    for (int i = 0; default_rules[i]; i++) {
+        snprintf(parsed, sizeof(parsed), "%s", default_rules[i]);
+        add_rule(set, parsed, 0);
+    }
+
+    if (compile_rules(set) != 0) {
+        fprintf(stderr, "sessionsnap: cannot compile filter rules, keeping every window\n");
+        set->count = 0;
+    }
+    return set;
+}
+
+static int lookup_exact(const FilterSet *set, MatchKind kind, const char *key) {
+    uint64_t h = hash_key(kind, key);
+    for (size_t i = h & set->exact_mask; set->exact[i].rule >= 0; i = (i + 1) & set->exact_mask) {
+        const FilterRule *rule = &set->rules[set->exact[i].rule];
+        if (set->exact[i].hash == h && rule->kind == kind && strcmp(rule->pattern, key) == 0) {
+            return set->exact[i].rule;
+        }
+    }
+    return -1;
+}
+
+/* fnmatch's rule r unless an earlier rule already matched or r was tried in this check */
+static void try_rule(FilterSet *set, int r, const FilterSubject *subject, int *best) {
+    FilterRule *rule = &set->rules[r];
+    if (r >= *best || rule->tried == set->checks) return;
+    rule->tried = set->checks;
+
+    const char *text = rule->kind == MATCH_TITLE ? subject->title :
+        rule->full_path ? subject->argv0 : subject->base;
+    if (fnmatch(rule->pattern, text, 0) == 0) *best = r;
+}
+
+static void scan_automaton(FilterSet *set, const Automaton *a, const char *text,
+    const FilterSubject *subject, int *best) {
+    int s = 0;
+    for (const unsigned char *p = (const unsigned char *)text; *p; p++) {
+        s = a->delta[s * a->classes + a->byte_class[*p]];
+        for (int u = a->head[s] >= 0 ? s : a->dict[s]; u; u = a->dict[u]) {
+            for (int r = a->head[u]; r >= 0; r = a->next[r]) try_rule(set, r, subject, best);
+        }
+    }
+}
+
+/* returns 1 if the first rule matching w excludes it, 0 if one includes it or none matches */
+int filter_window(const WindowList *list, const WindowInfo *w) {
+    FilterSet *set = load_filter_rules();
+    if (!set || set->count == 0) return 0;
+
+    FilterSubject subject;
+    subject.argv0 = w->cmd_argc > 0 ? window_arg(list, w, 0) : "";
+    const char *slash = strrchr(subject.argv0, '/');
+    subject.base = slash ? slash + 1 : subject.argv0;
+    subject.title = window_title(list, w);
+    const char *wm_class = window_wm_class(list, w);
+
+    set->checks++;
+    int best = set->count;
+
+    int r = lookup_exact(set, MATCH_NAME, subject.base);
+    if (r >= 0 && r < best) best = r;
+    if (wm_class[0]) {
+        r = lookup_exact(set, MATCH_CLASS, wm_class);
+        if (r >= 0 && r < best) best = r;
+    }
+
+    if (set->argv0.patterns) scan_automaton(set, &set->argv0, subject.argv0, &subject, &best);
+    if (set->title.patterns) scan_automaton(set, &set->title, subject.title, &subject, &best);
+    for (int i = 0; i < set->unanchored_count; i++) try_rule(set, set->unanchored[i], &subject, &best);
+
+    if (best == set->count) return 0;
+    __atomic_add_fetch(&set->rules[best].hits, 1, __ATOMIC_RELAXED);
+    return set->rules[best].exclude;
+}
+
+static void write_label(FILE *out, const char *s) {
+    for (; *s; s++) {
+        if (*s == '\\' || *s == '"') fputc('\\', out);
+        if (*s == '\n') fputs("\\n", out);
+        else fputc(*s, out);
+    }
+}
+
+/* one counter per rule of every loaded set, labelled with where the rule came from */
+void write_filter_stats(FILE *out) {
+    fprintf(out, "# HELP sessionsnap_filter_rule_hits_total Windows decided by each filter rule.\n");
+    fprintf(out, "# TYPE sessionsnap_filter_rule_hits_total counter\n");
+
+    for (const FilterSet *set = filter_sets; set; set = set->next) {
+        for (int r = 0; r < set->count; r++) {
+            const FilterRule *rule = &set->rules[r];
+            fputs("sessionsnap_filter_rule_hits_total{source=\"", out);
+            if (rule->line > 0) {
+                write_label(out, set->path);
+                fprintf(out, ":%d", rule->line);
+            } else {
+                fputs("built-in", out);
+            }
+            fprintf(out, "\",rule=\"%s %s ", rule->exclude ? "exclude" : "include", kind_names[rule->kind]);
+            write_label(out, rule->pattern);
+            fprintf(out, "\"} %lu\n", __atomic_load_n(&rule->hits, __ATOMIC_RELAXED));
+        }
+    }
+}
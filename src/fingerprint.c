@@ -0,0 +1,193 @@
+/*
+ * fingerprint.c — computes a structural FNV-1a hash of a WindowList
+ * talks to: fingerprint.h, winlist.h, session.c (skips writes when the hash is unchanged, whose home the rules come from)
+ * imports: regex.h for title normalization rules
+ * functions: session_fingerprint(), normalize_title(), load_title_rules()
+ *
+ * title-rules holds one POSIX extended regex per line, '#' starts a comment.
+ * every match is cut out of a title before hashing, so a tab title like
+ * "(3) Inbox" or a ticking clock doesn't count as a session change.
+ *
+ * regexec() allocates on every call, so the normalized hash of each title is
+ * remembered by the raw title's hash and only titles that changed are matched again.
+ */
+
+#include "../include/fingerprint.h"
+#include "../include/session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <regex.h>
+
+#define FNV_OFFSET 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+/* direct-mapped, a few times the windows of any real desktop */
+#define TITLE_MEMO_SLOTS 1024
+
+typedef struct {
+    uint64_t raw;           /* hash of the title as captured, 0 for an empty slot */
+    uint64_t normalized;    /* hash of what normalize_title() made of it */
+} TitleMemo;
+
+typedef struct {
+    regex_t re;
+} TitleRule;
+
+/* rules are read from the home being saved into, each user of a multi-seat daemon has their own */
+typedef struct RuleSet {
+    char home[256];
+    TitleRule *rules;
+    int count;
+    TitleMemo *memo;
+    struct RuleSet *next;
+} RuleSet;
+
+static const char *default_rules[] = {
+    "^\\([0-9]+\\) ",                  /* unread counters: "(3) Inbox" */
+    "[0-9]{1,2}:[0-9]{2}(:[0-9]{2})?", /* clocks and timers */
+    "[0-9]{1,3}(\\.[0-9]+)?%",         /* progress percentages */
+    NULL
+};
+
+static RuleSet *rule_sets = NULL;
+
+static void add_rule(RuleSet *set, const char *pattern) {
+    TitleRule *grown = realloc(set->rules, (size_t)(set->count + 1) * sizeof(TitleRule));
+    if (!grown) return;
+    set->rules = grown;
+
+    if (regcomp(&set->rules[set->count].re, pattern, REG_EXTENDED) != 0) {
+        fprintf(stderr, "sessionsnap: ignoring bad title rule '%s'\n", pattern);
+        return;
+    }
+    set->count++;
+}
+
+static RuleSet *load_title_rules(void) {
+    const char *home = get_session_home();
+    if (!home) home = "/tmp";
+
+    for (RuleSet *set = rule_sets; set; set = set->next) {
+        if (strcmp(set->home, home) == 0) return set;
+    }
+
+    RuleSet *set = calloc(1, sizeof(RuleSet));
+    if (!set) return NULL;
+    snprintf(set->home, sizeof(set->home), "%s", home);
+    set->memo = calloc(TITLE_MEMO_SLOTS, sizeof(TitleMemo));
+    set->next = rule_sets;
+    rule_sets = set;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", home, TITLE_RULES_FILE);
+
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        for (int i = 0; default_rules[i]; i++) add_rule(set, default_rules[i]);
+        return set;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), f)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] == '\0' || line[0] == '#') continue;
+        add_rule(set, line);
+    }
+    fclose(f);
+    return set;
+}
+
+/* returns title with every rule match removed, valid until the next call */
+const char *normalize_title(const char *title) {
+    static char *buf = NULL;
+    static size_t cap = 0;
+
+    const RuleSet *set = load_title_rules();
+    if (!set || set->count == 0) return title;
+
+    size_t len = strlen(title);
+    if (len + 1 > cap) {
+        char *grown = realloc(buf, len + 1);
+        if (!grown) return title;
+        buf = grown;
+        cap = len + 1;
+    }
+    memcpy(buf, title, len + 1);
+
+    for (int i = 0; i < set->count; i++) {
+        size_t from = 0;
+        regmatch_t m;
+        while (from < len && regexec(&set->rules[i].re, buf + from, 1, &m,
+            from > 0 ? REG_NOTBOL : 0) == 0) {
+            if (m.rm_eo == m.rm_so) break;
+            size_t start = from + (size_t)m.rm_so;
+            size_t end = from + (size_t)m.rm_eo;
+            memmove(buf + start, buf + end, len - end + 1);
+            len -= end - start;
+            from = start;
+        }
+    }
+    return buf;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t len) {
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static uint64_t hash_int(uint64_t h, int v) {
+    return hash_bytes(h, &v, sizeof(v));
+}
+
+/* strings are hashed with their terminator so ("ab","c") and ("a","bc") differ */
+static uint64_t hash_string(uint64_t h, const char *s) {
+    return hash_bytes(h, s, strlen(s) + 1);
+}
+
+static uint64_t hash_title(uint64_t h, const char *title) {
+    RuleSet *set = load_title_rules();
+    if (!set || !set->memo) return hash_string(h, normalize_title(title));
+
+    uint64_t raw = hash_string(FNV_OFFSET, title);
+    TitleMemo *m = &set->memo[raw & (TITLE_MEMO_SLOTS - 1)];
+    if (m->raw != raw) {
+        m->raw = raw;
+        m->normalized = hash_string(FNV_OFFSET, normalize_title(title));
+    }
+    return hash_bytes(h, &m->normalized, sizeof(m->normalized));
+}
+
+uint64_t session_fingerprint(const WindowList *list) {
+    uint64_t h = hash_int(FNV_OFFSET, list->count);
+
+    for (int i = 0; i < list->count; i++) {
+        const WindowInfo *w = &list->windows[i];
+
+        h = hash_int(h, w->x);
+        h = hash_int(h, w->y);
+        h = hash_int(h, w->width);
+        h = hash_int(h, w->height);
+        h = hash_int(h, w->desktop);
+        h = hash_int(h, w->is_maximized);
+        h = hash_int(h, w->is_minimized);
+        h = hash_string(h, window_exe_path(list, w));
+        h = hash_string(h, window_wm_class(list, w));
+        h = hash_title(h, window_title(list, w));
+
+        h = hash_int(h, w->cmd_argc);
+        for (int j = 0; j < w->cmd_argc; j++) {
+            h = hash_string(h, window_arg(list, w, j));
+        }
+
+        h = hash_string(h, window_cwd(list, w));
+        h = hash_int(h, w->job_argc);
+        for (int j = 0; j < w->job_argc; j++) {
+            h = hash_string(h, window_job_arg(list, w, j));
+        }
+    }
+    return h;
+}
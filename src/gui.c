@@ -1,16 +1,54 @@
 /*
- * gui.c — shows a GTK dialog asking user to restore session on startup
- * talks to: restore.c (restore_session), session.c (session_file_exists), gui.h
- * imports: gtk/gtk.h for UI widgets, restore.h to trigger session restore
- * functions: show_restore_dialog(), run_gui()
+ * gui.c — shows a GTK dialog asking user to restore session on startup, then its progress
+ * talks to: restore.c (restore_window_list on a worker thread), session.c (load_session),
+ * catalog.c (load_catalog, the saved profiles), gui.h
+ * imports: gtk/gtk.h for UI widgets, restore.h to trigger session restore, pthread for the worker
+ * functions: show_restore_dialog(), run_gui(), format_preview(), on_profile_changed(),
+ * show_restore_progress(), restore_main(), post_status(), apply_status()
+ *
+ * restore blocks in select() on its X connection for the whole run, so it runs on its own
+ * thread. it reports every status change through post_status(), which hands it to the GTK
+ * main loop with g_idle_add; only the main thread touches widgets. skip and cancel go the
+ * other way, as flags in the RestoreControl that restore polls.
  */
 
 #include "../include/gui.h"
 #include "../include/restore.h"
 #include "../include/session.h"
+#include "../include/catalog.h"
 #include <gtk/gtk.h>
+#include <X11/Xlib.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+typedef struct {
+    const ProfileSummary *profiles;
+    GtkWidget *preview;
+} Picker;
+
+/* what the chosen profile will bring back, straight from the index */
+static void format_preview(const ProfileSummary *p, char *out, size_t size) {
+    char when[32] = "unknown";
+    time_t t = (time_t)p->saved;
+    struct tm tm;
+    if (p->saved && localtime_r(&t, &tm)) strftime(when, sizeof(when), "%Y-%m-%d %H:%M", &tm);
+
+    snprintf(out, size, "%u window%s, saved %s\n%s", p->windows, p->windows == 1 ? "" : "s",
+        when, p->apps);
+}
+
+static void on_profile_changed(GtkComboBox *combo, gpointer data) {
+    Picker *picker = data;
+    int i = gtk_combo_box_get_active(combo);
+    if (i < 0) return;
+
+    char preview[CATALOG_APPS_LEN + 64];
+    format_preview(&picker->profiles[i], preview, sizeof(preview));
+    gtk_label_set_text(GTK_LABEL(picker->preview), preview);
+}
 
 static void on_restore_clicked(GtkWidget *widget, gpointer data) {
     (void)widget;
@@ -24,7 +62,8 @@ static void on_skip_clicked(GtkWidget *widget, gpointer data) {
     gtk_dialog_response(GTK_DIALOG(dialog), GTK_RESPONSE_NO);
 }
 
-int show_restore_dialog(const char *profile_name) {
+/* returns the index of the profile to restore, or -1 if the user skipped */
+int show_restore_dialog(const ProfileSummary *profiles, int count, int selected) {
     GtkWidget *dialog = gtk_dialog_new();
     gtk_window_set_title(GTK_WINDOW(dialog), "SessionSnap");
     gtk_window_set_position(GTK_WINDOW(dialog), GTK_WIN_POS_CENTER);
@@ -49,16 +88,45 @@ int show_restore_dialog(const char *profile_name) {
         "<span size='large' weight='bold'>Restore Previous Session?</span>");
     gtk_box_pack_start(GTK_BOX(vbox), title_label, FALSE, FALSE, 0);
 
+    const char *only = count == 1 ? profiles[0].name : NULL;
     char msg[256];
     snprintf(msg, sizeof(msg),
-        "SessionSnap found a saved workspace%s%s.\nWould you like to restore it?",
-        profile_name && strcmp(profile_name, "default") != 0 ? ": " : "",
-        profile_name && strcmp(profile_name, "default") != 0 ? profile_name : "");
+        "SessionSnap found %s%s%s.\nWould you like to restore %s?",
+        count > 1 ? "several saved workspaces" : "a saved workspace",
+        only && strcmp(only, "default") != 0 ? ": " : "",
+        only && strcmp(only, "default") != 0 ? only : "",
+        count > 1 ? "one of them" : "it");
 
     GtkWidget *sub_label = gtk_label_new(msg);
     gtk_label_set_justify(GTK_LABEL(sub_label), GTK_JUSTIFY_CENTER);
     gtk_box_pack_start(GTK_BOX(vbox), sub_label, FALSE, FALSE, 0);
 
+    GtkWidget *combo = NULL;
+    if (count > 1) {
+        combo = gtk_combo_box_text_new();
+        for (int i = 0; i < count; i++) {
+            char item[192];
+            snprintf(item, sizeof(item), "%s (%u window%s)", profiles[i].name, profiles[i].windows,
+                profiles[i].windows == 1 ? "" : "s");
+            gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo), item);
+        }
+        gtk_box_pack_start(GTK_BOX(vbox), combo, FALSE, FALSE, 0);
+    }
+
+    char preview_text[CATALOG_APPS_LEN + 64];
+    format_preview(&profiles[selected], preview_text, sizeof(preview_text));
+    GtkWidget *preview = gtk_label_new(preview_text);
+    gtk_label_set_justify(GTK_LABEL(preview), GTK_JUSTIFY_CENTER);
+    gtk_label_set_line_wrap(GTK_LABEL(preview), TRUE);
+    gtk_label_set_max_width_chars(GTK_LABEL(preview), 48);
+    gtk_box_pack_start(GTK_BOX(vbox), preview, FALSE, FALSE, 0);
+
+    Picker picker = { profiles, preview };
+    if (combo) {
+        gtk_combo_box_set_active(GTK_COMBO_BOX(combo), selected);
+        g_signal_connect(combo, "changed", G_CALLBACK(on_profile_changed), &picker);
+    }
+
     GtkWidget *btn_box = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 8);
     gtk_widget_set_halign(btn_box, GTK_ALIGN_CENTER);
     gtk_box_pack_start(GTK_BOX(vbox), btn_box, FALSE, FALSE, 8);
@@ -78,25 +146,293 @@ int show_restore_dialog(const char *profile_name) {
     gtk_widget_show_all(dialog);
 
     gint response = gtk_dialog_run(GTK_DIALOG(dialog));
+    int chosen = combo ? gtk_combo_box_get_active(GTK_COMBO_BOX(combo)) : selected;
     gtk_widget_destroy(dialog);
 
-    return (response == GTK_RESPONSE_YES) ? 1 : 0;
+    return response == GTK_RESPONSE_YES && chosen >= 0 ? chosen : -1;
+}
+
+typedef struct RestoreProgress RestoreProgress;
+
+typedef struct {
+    RestoreProgress *progress;
+    int window;
+    GtkWidget *status;
+    GtkWidget *skip;
+} ProgressRow;
+
+struct RestoreProgress {
+    GtkWidget *window;
+    GtkWidget *summary;
+    GtkWidget *cancel;
+    ProgressRow *rows;
+    RestoreStatus *statuses;
+    int count;
+    int done;               /* the worker has returned */
+    int closing;            /* closed while running, quit as soon as the worker returns */
+    RestoreControl control;
+    WindowList *list;       /* handed to the worker, which frees it */
+    const char *profile;
+    int result;
+};
+
+/* one status change, carried from the worker to the main loop */
+typedef struct {
+    RestoreProgress *progress;
+    int window;
+    RestoreStatus status;
+} StatusUpdate;
+
+static void update_summary(RestoreProgress *p) {
+    int by_status[RESTORE_SKIPPED + 1] = {0};
+    for (int i = 0; i < p->count; i++) by_status[p->statuses[i]]++;
+
+    char text[200];
+    int len = snprintf(text, sizeof(text), "%s%d of %d placed, %d timed out, %d skipped",
+        !p->done ? "" : p->result == 0 ? "Done: " : "Restore failed: ", by_status[RESTORE_PLACED], p->count,
+        by_status[RESTORE_TIMED_OUT], by_status[RESTORE_SKIPPED]);
+    if (by_status[RESTORE_DEFERRED] > 0) {
+        snprintf(text + len, sizeof(text) - (size_t)len, ", %d waiting for their desktop",
+            by_status[RESTORE_DEFERRED]);
+    }
+    gtk_label_set_text(GTK_LABEL(p->summary), text);
+}
+
+static gboolean apply_status(gpointer data) {
+    StatusUpdate *u = data;
+    RestoreProgress *p = u->progress;
+    ProgressRow *row = &p->rows[u->window];
+
+    p->statuses[u->window] = u->status;
+    gtk_label_set_text(GTK_LABEL(row->status), restore_status_name(u->status));
+    if (u->status >= RESTORE_PLACED) gtk_widget_set_sensitive(row->skip, FALSE);
+    update_summary(p);
+
+    g_free(u);
+    return G_SOURCE_REMOVE;
+}
+
+/* RestoreControl.progress, called on the worker */
+static void post_status(void *data, int window, RestoreStatus status) {
+    StatusUpdate *u = g_new(StatusUpdate, 1);
+    u->progress = data;
+    u->window = window;
+    u->status = status;
+    g_idle_add(apply_status, u);
+}
+
+/* queued after every status update the worker posted, so it runs last */
+static gboolean on_restore_done(gpointer data) {
+    RestoreProgress *p = data;
+    p->done = 1;
+    update_summary(p);
+
+    int placed_all = 1;
+    for (int i = 0; i < p->count; i++) {
+        if (p->statuses[i] != RESTORE_PLACED) placed_all = 0;
+    }
+
+    /* leave the list up when something is missing, so the user can see what */
+    if (p->closing || placed_all) {
+        gtk_main_quit();
+    } else {
+        gtk_button_set_label(GTK_BUTTON(p->cancel), "  Close  ");
+        gtk_widget_set_sensitive(p->cancel, TRUE);
+    }
+    return G_SOURCE_REMOVE;
+}
+
+static void *restore_main(void *arg) {
+    RestoreProgress *p = arg;
+    p->result = restore_window_list(p->list, p->profile, &p->control);
+    g_idle_add(on_restore_done, p);
+    return NULL;
+}
+
+static void on_app_skip_clicked(GtkWidget *widget, gpointer data) {
+    ProgressRow *row = data;
+    __atomic_store_n(&row->progress->control.skip[row->window], 1, __ATOMIC_RELAXED);
+    gtk_widget_set_sensitive(widget, FALSE);
+    gtk_label_set_text(GTK_LABEL(row->status), "skipping");
+}
+
+static void request_cancel(RestoreProgress *p) {
+    __atomic_store_n(&p->control.cancel, 1, __ATOMIC_RELAXED);
+    gtk_button_set_label(GTK_BUTTON(p->cancel), "  Cancelling...  ");
+    gtk_widget_set_sensitive(p->cancel, FALSE);
+}
+
+static void on_cancel_clicked(GtkWidget *widget, gpointer data) {
+    (void)widget;
+    RestoreProgress *p = data;
+    if (p->done) gtk_main_quit();
+    else request_cancel(p);
+}
+
+/* closing the window cancels the restore, the process exits once the worker is back */
+static gboolean on_progress_delete(GtkWidget *widget, GdkEvent *event, gpointer data) {
+    (void)event;
+    RestoreProgress *p = data;
+    if (p->done) {
+        gtk_main_quit();
+    } else {
+        p->closing = 1;
+        request_cancel(p);
+        gtk_widget_hide(widget);
+    }
+    /* show_restore_progress() destroys the window itself */
+    return TRUE;
+}
+
+static const char *app_name(const WindowList *list, const WindowInfo *w) {
+    const char *app = w->cmd_argc > 0 ? window_arg(list, w, 0) : window_wm_class(list, w);
+    const char *slash = strrchr(app, '/');
+    return slash ? slash + 1 : app;
+}
+
+/* one row per saved window: app, title, status and a skip button */
+static void build_progress_window(RestoreProgress *p) {
+    p->window = gtk_window_new(GTK_WINDOW_TOPLEVEL);
+    gtk_window_set_title(GTK_WINDOW(p->window), "SessionSnap");
+    gtk_window_set_position(GTK_WINDOW(p->window), GTK_WIN_POS_CENTER);
+    gtk_window_set_default_size(GTK_WINDOW(p->window), 560, 360);
+    gtk_container_set_border_width(GTK_CONTAINER(p->window), 16);
+    g_signal_connect(p->window, "delete-event", G_CALLBACK(on_progress_delete), p);
+
+    GtkWidget *vbox = gtk_box_new(GTK_ORIENTATION_VERTICAL, 12);
+    gtk_container_add(GTK_CONTAINER(p->window), vbox);
+
+    GtkWidget *title_label = gtk_label_new(NULL);
+    gtk_label_set_markup(GTK_LABEL(title_label),
+        "<span size='large' weight='bold'>Restoring Session</span>");
+    gtk_box_pack_start(GTK_BOX(vbox), title_label, FALSE, FALSE, 0);
+
+    GtkWidget *scroll = gtk_scrolled_window_new(NULL, NULL);
+    gtk_scrolled_window_set_policy(GTK_SCROLLED_WINDOW(scroll), GTK_POLICY_NEVER, GTK_POLICY_AUTOMATIC);
+    gtk_box_pack_start(GTK_BOX(vbox), scroll, TRUE, TRUE, 0);
+
+    GtkWidget *grid = gtk_grid_new();
+    gtk_grid_set_row_spacing(GTK_GRID(grid), 4);
+    gtk_grid_set_column_spacing(GTK_GRID(grid), 12);
+    gtk_container_add(GTK_CONTAINER(scroll), grid);
+
+    for (int i = 0; i < p->count; i++) {
+        const WindowInfo *w = &p->list->windows[i];
+        ProgressRow *row = &p->rows[i];
+        row->progress = p;
+        row->window = i;
+
+        GtkWidget *app = gtk_label_new(app_name(p->list, w));
+        gtk_label_set_xalign(GTK_LABEL(app), 0.0f);
+
+        GtkWidget *title = gtk_label_new(window_title(p->list, w));
+        gtk_label_set_xalign(GTK_LABEL(title), 0.0f);
+        gtk_label_set_ellipsize(GTK_LABEL(title), PANGO_ELLIPSIZE_END);
+        gtk_widget_set_hexpand(title, TRUE);
+
+        row->status = gtk_label_new(restore_status_name(RESTORE_WAITING));
+        gtk_label_set_width_chars(GTK_LABEL(row->status), 10);
+        row->skip = gtk_button_new_with_label("Skip");
+        g_signal_connect(row->skip, "clicked", G_CALLBACK(on_app_skip_clicked), row);
+
+        gtk_grid_attach(GTK_GRID(grid), app, 0, i, 1, 1);
+        gtk_grid_attach(GTK_GRID(grid), title, 1, i, 1, 1);
+        gtk_grid_attach(GTK_GRID(grid), row->status, 2, i, 1, 1);
+        gtk_grid_attach(GTK_GRID(grid), row->skip, 3, i, 1, 1);
+    }
+
+    p->summary = gtk_label_new(NULL);
+    gtk_box_pack_start(GTK_BOX(vbox), p->summary, FALSE, FALSE, 0);
+    update_summary(p);
+
+    p->cancel = gtk_button_new_with_label("  Cancel  ");
+    gtk_widget_set_halign(p->cancel, GTK_ALIGN_CENTER);
+    g_signal_connect(p->cancel, "clicked", G_CALLBACK(on_cancel_clicked), p);
+    gtk_box_pack_start(GTK_BOX(vbox), p->cancel, FALSE, FALSE, 0);
+
+    gtk_widget_show_all(p->window);
+}
+
+/* restores profile_name on a worker while the main loop keeps the progress window live */
+static int show_restore_progress(const char *profile_name) {
+    WindowList *list = load_session(profile_name);
+    if (!list) return -1;
+    if (list->count == 0) {
+        printf("sessionsnap: no windows in saved session\n");
+        free_window_list(list);
+        return 0;
+    }
+
+    RestoreProgress p = {0};
+    p.list = list;
+    p.profile = profile_name;
+    p.count = list->count;
+    p.rows = calloc((size_t)p.count, sizeof(ProgressRow));
+    p.statuses = calloc((size_t)p.count, sizeof(RestoreStatus));
+    p.control.skip = calloc((size_t)p.count, 1);
+    p.control.progress = post_status;
+    p.control.data = &p;
+    if (!p.rows || !p.statuses || !p.control.skip) {
+        fprintf(stderr, "sessionsnap: out of memory\n");
+        free(p.rows);
+        free(p.statuses);
+        free(p.control.skip);
+        free_window_list(list);
+        return -1;
+    }
+
+    /* the rows copy what they show, the worker owns list from here on */
+    build_progress_window(&p);
+
+    pthread_t worker;
+    if (pthread_create(&worker, NULL, restore_main, &p) != 0) {
+        fprintf(stderr, "sessionsnap: cannot start restore thread\n");
+        gtk_widget_destroy(p.window);
+        free(p.rows);
+        free(p.statuses);
+        free(p.control.skip);
+        free_window_list(list);
+        return -1;
+    }
+
+    gtk_main();
+    pthread_join(worker, NULL);
+
+    gtk_widget_destroy(p.window);
+    free(p.rows);
+    free(p.statuses);
+    free(p.control.skip);
+    return p.result;
 }
 
-void run_gui(void) {
+/* offers preferred if it was saved, else the most recently saved profile */
+void run_gui(const char *preferred) {
+    /* restore opens its own display on the worker, Xlib must know about threads before anything else */
+    XInitThreads();
     gtk_init(NULL, NULL);
 
-    if (!session_file_exists("default")) {
+    ProfileSummary *profiles;
+    int count = load_catalog(&profiles);
+    if (count <= 0) {
         printf("sessionsnap: no saved session found, skipping restore prompt\n");
         return;
     }
 
-    int should_restore = show_restore_dialog("default");
+    int selected = 0;
+    for (int i = 1; i < count; i++) {
+        if (profiles[i].saved > profiles[selected].saved) selected = i;
+    }
+    for (int i = 0; i < count; i++) {
+        if (preferred && strcmp(profiles[i].name, preferred) == 0) selected = i;
+    }
+
+    int chosen = show_restore_dialog(profiles, count, selected);
 
-    if (should_restore) {
-        printf("sessionsnap: user chose to restore session\n");
-        restore_session("default");
+    if (chosen >= 0) {
+        printf("sessionsnap: user chose to restore profile '%s'\n", profiles[chosen].name);
+        show_restore_progress(profiles[chosen].name);
     } else {
         printf("sessionsnap: user skipped restore\n");
     }
+    free(profiles);
 }
\ No newline at end of file
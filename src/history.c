@@ -0,0 +1,1106 @@
+/*
+ * history.c — delta-encoded, append-only session history with an index for point-in-time lookups
+ * talks to: history.h, session.c (history_append after each session write), main.c (--history, --at),
+ *           snapfile.c (crc32_update), winlist.c (lists handed in and rebuilt), session.c (whose home)
+ * imports: sys/file.h for flock() so a daemon and a CLI never interleave records, fcntl/unistd for pread/pwrite
+ * functions: history_append(), history_load_at(), print_history(), parse_history_time(), history_free(),
+ * encode_record(), apply_record(), read_record(), open_history(), rebuild_index(), compact_history()
+ *
+ * a keyframe resets the chain's string table and window set; a delta lists the strings
+ * it introduces and then only the windows that were added, removed, or changed, with
+ * just the fields that differ. argv is interned as one NUL-separated string, so an
+ * unchanged command line costs a one-byte id. every record carries the index of the
+ * record it applies to, so a lookup follows one chain back to its keyframe and never
+ * replays more than HISTORY_KEYFRAME_INTERVAL records. records store that link as a
+ * distance, so it survives compaction and a lost index can be rebuilt from the log.
+ */
+
+#define _GNU_SOURCE
+#include "../include/history.h"
+#include "../include/snapfile.h"
+#include "../include/session.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+
+#define LOG_MAGIC "SSHL"
+#define INDEX_MAGIC "SSHI"
+#define HISTORY_VERSION 1
+/* compaction waits until this much has piled up past the retention window */
+#define HISTORY_COMPACT_SLACK (24 * 3600)
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t log_id;        /* new whenever the log is rewritten, an index is only valid for the same id */
+} FileHeader;
+
+typedef struct {
+    uint32_t length;        /* payload bytes after this header */
+    uint32_t back;          /* entries back to the one this delta applies to, 0 for a keyframe */
+    int64_t time;
+    uint32_t window_count;
+    uint32_t checksum;      /* CRC-32 of the payload */
+} RecordHeader;
+
+enum { OP_STRING = 1, OP_WINDOW, OP_REMOVE, OP_ORDER };
+
+enum { F_PID, F_TITLE, F_EXE, F_CLASS, F_X, F_Y, F_WIDTH, F_HEIGHT, F_DESKTOP, F_FLAGS, F_CMD, F_CWD, F_JOB, F_MAPS, FIELDS };
+#define ALL_FIELDS ((1u << FIELDS) - 1)
+
+/*
+ * a window's key in the log is its X id. an id of 0 (JSON sessions never store one) or
+ * one already taken in the same list gets this bit, its position above bit 32 and the
+ * id's low bits below, so no two windows of a list ever share a key
+ */
+#define KEY_SYNTHETIC (1ull << 63)
+
+typedef struct {
+    uint64_t window_id;     /* the key, see KEY_SYNTHETIC */
+    int64_t v[FIELDS];      /* string fields hold ids into the chain's string table */
+} HistWindow;
+
+typedef struct {
+    HistWindow *items;
+    int count;
+    int cap;
+} HistState;
+
+typedef struct {
+    char *data;
+    size_t len;
+    size_t cap;
+    uint32_t *offsets;
+    uint32_t *lengths;
+    uint32_t count;
+    uint32_t id_cap;
+    uint32_t *slots;        /* open addressing on id + 1, only the writer hashes */
+    uint32_t slot_cap;
+} StringTable;
+
+typedef struct {
+    unsigned char *data;
+    size_t len;
+    size_t cap;
+    int failed;
+} ByteBuf;
+
+typedef struct {
+    const unsigned char *p;
+    const unsigned char *end;
+    int bad;
+} Reader;
+
+/* what this process last appended to a log, deltas are encoded against it */
+typedef struct HistoryWriter {
+    char log_path[512];     /* keyed by path, a multi-seat daemon has one "default" per user */
+    StringTable strings;
+    HistState prev;
+    HistState next;
+    ByteBuf record;
+    ByteBuf argv;
+    ByteBuf ops;            /* these and entries are kept between appends so a warm append doesn't allocate */
+    ByteBuf scratch;
+    ByteBuf keys;           /* open addressing on the X ids of the list being encoded */
+    HistoryEntry *entries;
+    uint32_t entries_cap;
+    uint64_t log_id;        /* log the chain lives in, 0 forces a keyframe */
+    uint32_t last_entry;
+    int since_keyframe;
+    struct HistoryWriter *link;
+} HistoryWriter;
+
+typedef struct {
+    int lock_fd;
+    int log_fd;
+    int idx_fd;
+    FileHeader header;
+    uint64_t log_size;
+    HistoryEntry *entries;
+    uint32_t count;
+    uint32_t cap;
+    char log_path[512];
+    char idx_path[512];
+} HistoryFiles;
+
+static HistoryWriter *writers = NULL;
+
+/* makes room for need bytes in total, keeping what is there */
+static int buf_reserve(ByteBuf *b, size_t need) {
+    if (need <= b->cap) return 0;
+
+    size_t cap = b->cap ? b->cap : 1024;
+    while (cap < need) cap *= 2;
+
+    unsigned char *grown = realloc(b->data, cap);
+    if (!grown) return -1;
+    b->data = grown;
+    b->cap = cap;
+    return 0;
+}
+
+static void buf_put(ByteBuf *b, const void *p, size_t n) {
+    if (b->failed) return;
+
+    if (buf_reserve(b, b->len + n) != 0) {
+        b->failed = 1;
+        return;
+    }
+    if (n) memcpy(b->data + b->len, p, n);
+    b->len += n;
+}
+
+static void put_varint(ByteBuf *b, uint64_t v) {
+    unsigned char tmp[10];
+    size_t n = 0;
+    do {
+        unsigned char c = v & 0x7f;
+        v >>= 7;
+        tmp[n++] = c | (v ? 0x80 : 0);
+    } while (v);
+    buf_put(b, tmp, n);
+}
+
+/* zigzag, so small negative coordinates stay one byte */
+static void put_signed(ByteBuf *b, int64_t v) {
+    put_varint(b, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+static uint64_t get_varint(Reader *r) {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64 && r->p < r->end; shift += 7) {
+        unsigned char c = *r->p++;
+        v |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) return v;
+    }
+    r->bad = 1;
+    return 0;
+}
+
+static int64_t get_signed(Reader *r) {
+    uint64_t u = get_varint(r);
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+static uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static void strings_reset(StringTable *t) {
+    t->len = 0;
+    t->count = 0;
+    if (t->slots) memset(t->slots, 0, t->slot_cap * sizeof(uint32_t));
+}
+
+static void strings_free(StringTable *t) {
+    free(t->data);
+    free(t->offsets);
+    free(t->lengths);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+static int64_t strings_add(StringTable *t, const char *s, size_t len) {
+    if (t->len + len > t->cap) {
+        size_t cap = t->cap ? t->cap : 4096;
+        while (cap < t->len + len) cap *= 2;
+        char *grown = realloc(t->data, cap);
+        if (!grown) return -1;
+        t->data = grown;
+        t->cap = cap;
+    }
+    if (t->count == t->id_cap) {
+        uint32_t cap = t->id_cap ? t->id_cap * 2 : 128;
+        uint32_t *offsets = realloc(t->offsets, cap * sizeof(uint32_t));
+        if (!offsets) return -1;
+        t->offsets = offsets;
+        uint32_t *lengths = realloc(t->lengths, cap * sizeof(uint32_t));
+        if (!lengths) return -1;
+        t->lengths = lengths;
+        t->id_cap = cap;
+    }
+
+    if (len) memcpy(t->data + t->len, s, len);
+    t->offsets[t->count] = (uint32_t)t->len;
+    t->lengths[t->count] = (uint32_t)len;
+    t->len += len;
+    return t->count++;
+}
+
+static const char *string_at(const StringTable *t, int64_t id, size_t *len) {
+    if (id < 0 || id >= (int64_t)t->count) {
+        *len = 0;
+        return "";
+    }
+    *len = t->lengths[id];
+    return t->data + t->offsets[id];
+}
+
+static int strings_rehash(StringTable *t, uint32_t cap) {
+    uint32_t *slots = calloc(cap, sizeof(uint32_t));
+    if (!slots) return -1;
+
+    for (uint32_t id = 0; id < t->count; id++) {
+        uint32_t h = hash_bytes(t->data + t->offsets[id], t->lengths[id]) & (cap - 1);
+        while (slots[h]) h = (h + 1) & (cap - 1);
+        slots[h] = id + 1;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->slot_cap = cap;
+    return 0;
+}
+
+/* returns the id of s, adding it if the chain hasn't seen it yet */
+static int64_t strings_intern(StringTable *t, const char *s, size_t len) {
+    if ((t->count + 1) * 2 > t->slot_cap &&
+        strings_rehash(t, t->slot_cap ? t->slot_cap * 2 : 256) != 0) {
+        return -1;
+    }
+
+    uint32_t mask = t->slot_cap - 1;
+    uint32_t h = hash_bytes(s, len) & mask;
+    while (t->slots[h]) {
+        uint32_t id = t->slots[h] - 1;
+        if (t->lengths[id] == len && memcmp(t->data + t->offsets[id], s, len) == 0) return id;
+        h = (h + 1) & mask;
+    }
+
+    int64_t id = strings_add(t, s, len);
+    if (id >= 0) t->slots[h] = (uint32_t)id + 1;
+    return id;
+}
+
+static HistWindow *state_add(HistState *st, uint64_t window_id) {
+    if (st->count == st->cap) {
+        int cap = st->cap ? st->cap * 2 : 32;
+        HistWindow *grown = realloc(st->items, (size_t)cap * sizeof(HistWindow));
+        if (!grown) return NULL;
+        st->items = grown;
+        st->cap = cap;
+    }
+    HistWindow *w = &st->items[st->count++];
+    memset(w, 0, sizeof(*w));
+    w->window_id = window_id;
+    /* records from before cwd, job and maps existed never set them, -1 reads back as "" */
+    w->v[F_CWD] = -1;
+    w->v[F_JOB] = -1;
+    w->v[F_MAPS] = -1;
+    return w;
+}
+
+static int state_find(const HistState *st, uint64_t window_id, int hint) {
+    if (hint >= 0 && hint < st->count && st->items[hint].window_id == window_id) return hint;
+    for (int i = 0; i < st->count; i++) {
+        if (st->items[i].window_id == window_id) return i;
+    }
+    return -1;
+}
+
+/* fills keys[] with one distinct key per window of list, returns -1 if out of memory */
+static int assign_keys(HistoryWriter *hw, const WindowList *list, uint64_t *keys) {
+    uint32_t cap = 64;
+    while (cap < (uint32_t)list->count * 2) cap *= 2;
+    if (buf_reserve(&hw->keys, (size_t)cap * sizeof(uint64_t)) != 0) return -1;
+    uint64_t *slots = (uint64_t *)hw->keys.data;
+    memset(slots, 0, (size_t)cap * sizeof(uint64_t));
+
+    for (int i = 0; i < list->count; i++) {
+        uint64_t id = list->windows[i].window_id;
+        keys[i] = KEY_SYNTHETIC | (uint64_t)i << 32 | (id & 0xffffffffu);
+        if (id == 0 || (id & KEY_SYNTHETIC)) continue;
+
+        uint32_t h = (uint32_t)((id * 0x9e3779b97f4a7c15ull) >> 32) & (cap - 1);
+        while (slots[h] && slots[h] != id) h = (h + 1) & (cap - 1);
+        if (slots[h]) continue;
+        slots[h] = id;
+        keys[i] = id;
+    }
+    return 0;
+}
+
+/*
+ * argv as one NUL-separated string in hw->argv, so a whole command line interns as one id.
+ * field picks the run: F_CMD, F_JOB, or F_MAPS for the mapped files
+ */
+static int64_t intern_argv(HistoryWriter *hw, const WindowList *list, const WindowInfo *w, int field) {
+    int argc = field == F_JOB ? w->job_argc : field == F_MAPS ? w->map_count : w->cmd_argc;
+
+    hw->argv.len = 0;
+    for (int j = 0; j < argc; j++) {
+        const char *arg = field == F_JOB ? window_job_arg(list, w, j) :
+            field == F_MAPS ? window_map(list, w, j) : window_arg(list, w, j);
+        buf_put(&hw->argv, arg, strlen(arg) + 1);
+    }
+    if (hw->argv.failed) return -1;
+    return strings_intern(&hw->strings, (const char *)hw->argv.data, hw->argv.len);
+}
+
+static int intern_window(HistoryWriter *hw, const WindowList *list, const WindowInfo *w, HistWindow *out) {
+    const char *title = window_title(list, w);
+    const char *exe = window_exe_path(list, w);
+    const char *wm_class = window_wm_class(list, w);
+    const char *cwd = window_cwd(list, w);
+
+    out->v[F_PID] = w->pid;
+    out->v[F_TITLE] = strings_intern(&hw->strings, title, strlen(title));
+    out->v[F_EXE] = strings_intern(&hw->strings, exe, strlen(exe));
+    out->v[F_CLASS] = strings_intern(&hw->strings, wm_class, strlen(wm_class));
+    out->v[F_X] = w->x;
+    out->v[F_Y] = w->y;
+    out->v[F_WIDTH] = w->width;
+    out->v[F_HEIGHT] = w->height;
+    out->v[F_DESKTOP] = w->desktop;
+    out->v[F_FLAGS] = (w->is_maximized ? 1 : 0) | (w->is_minimized ? 2 : 0);
+    out->v[F_CMD] = intern_argv(hw, list, w, F_CMD);
+    out->v[F_CWD] = strings_intern(&hw->strings, cwd, strlen(cwd));
+    out->v[F_JOB] = intern_argv(hw, list, w, F_JOB);
+    out->v[F_MAPS] = intern_argv(hw, list, w, F_MAPS);
+
+    if (out->v[F_TITLE] < 0 || out->v[F_EXE] < 0 || out->v[F_CLASS] < 0 || out->v[F_CMD] < 0 ||
+        out->v[F_CWD] < 0 || out->v[F_JOB] < 0 || out->v[F_MAPS] < 0) return -1;
+    return 0;
+}
+
+static void put_window(ByteBuf *b, const HistWindow *w, uint32_t mask) {
+    put_varint(b, OP_WINDOW);
+    put_varint(b, w->window_id);
+    put_varint(b, mask);
+    for (int f = 0; f < FIELDS; f++) {
+        if (mask & (1u << f)) put_signed(b, w->v[f]);
+    }
+}
+
+/*
+ * encodes list against the writer's previous state into hw->record, after room for
+ * the record header. a keyframe is a delta against an empty state and table.
+ */
+static int encode_record(HistoryWriter *hw, const WindowList *list, int keyframe) {
+    if (keyframe) {
+        strings_reset(&hw->strings);
+        hw->prev.count = 0;
+    }
+    uint32_t first_new = hw->strings.count;
+
+    /* the keys borrow scratch until the windows are in next, the diff below reuses it */
+    if (buf_reserve(&hw->scratch, ((size_t)list->count + 1) * sizeof(uint64_t)) != 0) return -1;
+    uint64_t *keys = (uint64_t *)hw->scratch.data;
+    if (assign_keys(hw, list, keys) != 0) return -1;
+
+    hw->next.count = 0;
+    for (int i = 0; i < list->count; i++) {
+        HistWindow *w = state_add(&hw->next, keys[i]);
+        if (!w || intern_window(hw, list, &list->windows[i], w) != 0) return -1;
+    }
+
+    const HistState *prev = &hw->prev;
+    const HistState *next = &hw->next;
+    ByteBuf *ops = &hw->ops;
+    ops->len = 0;
+    ops->failed = 0;
+
+    /* expected ids first, so they stay aligned, then one matched flag per previous window */
+    size_t expected_len = ((size_t)next->count + 1) * sizeof(uint64_t);
+    if (buf_reserve(&hw->scratch, expected_len + (size_t)prev->count + 1) != 0) return -1;
+    uint64_t *expected = (uint64_t *)hw->scratch.data;
+    char *matched = (char *)hw->scratch.data + expected_len;
+    memset(matched, 0, (size_t)prev->count + 1);
+
+    int added = 0;
+    for (int i = 0; i < next->count; i++) {
+        const HistWindow *w = &next->items[i];
+        int j = state_find(prev, w->window_id, i);
+        if (j < 0) {
+            put_window(ops, w, ALL_FIELDS);
+            added++;
+            continue;
+        }
+
+        matched[j] = 1;
+        uint32_t mask = 0;
+        for (int f = 0; f < FIELDS; f++) {
+            if (w->v[f] != prev->items[j].v[f]) mask |= 1u << f;
+        }
+        if (mask) put_window(ops, w, mask);
+    }
+
+    /* the reader keeps survivors in their old order and appends new windows, anything else needs an order op */
+    int n = 0;
+    for (int j = 0; j < prev->count; j++) {
+        if (matched[j]) {
+            expected[n++] = prev->items[j].window_id;
+        } else {
+            put_varint(ops, OP_REMOVE);
+            put_varint(ops, prev->items[j].window_id);
+        }
+    }
+    for (int i = 0; i < next->count && added > 0; i++) {
+        if (state_find(prev, next->items[i].window_id, i) < 0) expected[n++] = next->items[i].window_id;
+    }
+
+    int reordered = 0;
+    for (int i = 0; i < next->count; i++) {
+        if (expected[i] != next->items[i].window_id) reordered = 1;
+    }
+    if (reordered) {
+        put_varint(ops, OP_ORDER);
+        put_varint(ops, (uint64_t)next->count);
+        for (int i = 0; i < next->count; i++) put_varint(ops, next->items[i].window_id);
+    }
+    hw->record.len = 0;
+    hw->record.failed = 0;
+    RecordHeader blank = {0};
+    buf_put(&hw->record, &blank, sizeof(blank));
+    for (uint32_t id = first_new; id < hw->strings.count; id++) {
+        size_t len;
+        const char *s = string_at(&hw->strings, id, &len);
+        put_varint(&hw->record, OP_STRING);
+        put_varint(&hw->record, len);
+        buf_put(&hw->record, s, len);
+    }
+    buf_put(&hw->record, ops->data, ops->len);
+
+    return ops->failed || hw->record.failed ? -1 : 0;
+}
+
+static int apply_record(HistState *st, StringTable *strings, const unsigned char *data, size_t len) {
+    Reader r = { data, data + len, 0 };
+
+    while (r.p < r.end && !r.bad) {
+        uint64_t op = get_varint(&r);
+
+        if (op == OP_STRING) {
+            uint64_t n = get_varint(&r);
+            if (r.bad || n > (uint64_t)(r.end - r.p) || strings_add(strings, (const char *)r.p, n) < 0) return -1;
+            r.p += n;
+        } else if (op == OP_WINDOW) {
+            uint64_t id = get_varint(&r);
+            uint64_t mask = get_varint(&r);
+            if (mask & ~(uint64_t)ALL_FIELDS) return -1;
+
+            int i = state_find(st, id, -1);
+            HistWindow *w = i >= 0 ? &st->items[i] : state_add(st, id);
+            if (!w) return -1;
+            for (int f = 0; f < FIELDS; f++) {
+                if (mask & (1u << f)) w->v[f] = get_signed(&r);
+            }
+        } else if (op == OP_REMOVE) {
+            int i = state_find(st, get_varint(&r), -1);
+            if (i < 0) return -1;
+            memmove(&st->items[i], &st->items[i + 1], (size_t)(st->count - i - 1) * sizeof(HistWindow));
+            st->count--;
+        } else if (op == OP_ORDER) {
+            uint64_t n = get_varint(&r);
+            if (n != (uint64_t)st->count) return -1;
+
+            HistWindow *ordered = malloc(((size_t)n + 1) * sizeof(HistWindow));
+            if (!ordered) return -1;
+            for (uint64_t k = 0; k < n; k++) {
+                int i = state_find(st, get_varint(&r), (int)k);
+                if (i < 0) {
+                    free(ordered);
+                    return -1;
+                }
+                ordered[k] = st->items[i];
+            }
+            memcpy(st->items, ordered, (size_t)n * sizeof(HistWindow));
+            free(ordered);
+        } else {
+            return -1;
+        }
+    }
+    return r.bad ? -1 : 0;
+}
+
+static WindowList *state_to_list(const HistState *st, const StringTable *strings) {
+    WindowList *list = new_window_list();
+    if (!list) return NULL;
+
+    for (int i = 0; i < st->count; i++) {
+        const HistWindow *h = &st->items[i];
+        WindowInfo *w = add_window(list);
+        if (!w) break;
+
+        size_t len;
+        const char *s;
+        w->window_id = h->window_id & KEY_SYNTHETIC ? h->window_id & 0xffffffffu : h->window_id;
+        w->pid = (int32_t)h->v[F_PID];
+        s = string_at(strings, h->v[F_TITLE], &len);
+        w->title = store_string(list, s, len);
+        s = string_at(strings, h->v[F_EXE], &len);
+        w->exe_path = store_string(list, s, len);
+        s = string_at(strings, h->v[F_CLASS], &len);
+        w->wm_class = store_string(list, s, len);
+        w->x = (int32_t)h->v[F_X];
+        w->y = (int32_t)h->v[F_Y];
+        w->width = (int32_t)h->v[F_WIDTH];
+        w->height = (int32_t)h->v[F_HEIGHT];
+        w->desktop = (int32_t)h->v[F_DESKTOP];
+        w->is_maximized = (h->v[F_FLAGS] & 1) != 0;
+        w->is_minimized = (h->v[F_FLAGS] & 2) != 0;
+
+        s = string_at(strings, h->v[F_CWD], &len);
+        w->cwd = store_string(list, s, len);
+
+        const char *argv = string_at(strings, h->v[F_CMD], &len);
+        size_t at = 0;
+        while (at < len) {
+            size_t arg_len = strnlen(argv + at, len - at);
+            if (add_window_arg(list, w, argv + at, arg_len) != 0) break;
+            at += arg_len + 1;
+        }
+
+        argv = string_at(strings, h->v[F_JOB], &len);
+        at = 0;
+        while (at < len) {
+            size_t arg_len = strnlen(argv + at, len - at);
+            if (add_window_job_arg(list, w, argv + at, arg_len) != 0) break;
+            at += arg_len + 1;
+        }
+
+        argv = string_at(strings, h->v[F_MAPS], &len);
+        at = 0;
+        while (at < len) {
+            size_t arg_len = strnlen(argv + at, len - at);
+            if (add_window_map(list, w, argv + at, arg_len) != 0) break;
+            at += arg_len + 1;
+        }
+    }
+    return list;
+}
+
+static void history_path(char *out, size_t size, const char *profile_name, const char *ext) {
+    const char *home = get_session_home();
+    if (!home) home = "/tmp";
+    snprintf(out, size, "%s%s/%s%s", home, HISTORY_DIR, profile_name ? profile_name : "default", ext);
+}
+
+static uint64_t new_log_id(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ((uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec) ^ ((uint64_t)getpid() << 48);
+}
+
+static int write_all(int fd, const void *data, size_t len, uint64_t offset) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = pwrite(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+static int read_all(int fd, void *data, size_t len, uint64_t offset) {
+    char *p = data;
+    while (len > 0) {
+        ssize_t n = pread(fd, p, len, (off_t)offset);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        p += n;
+        len -= (size_t)n;
+        offset += (uint64_t)n;
+    }
+    return 0;
+}
+
+/* reads the record at offset into payload and checks it against its checksum */
+static int read_record(const HistoryFiles *f, uint64_t offset, RecordHeader *rh, ByteBuf *payload) {
+    if (offset + sizeof(*rh) > f->log_size || read_all(f->log_fd, rh, sizeof(*rh), offset) != 0 ||
+        rh->length > f->log_size - offset - sizeof(*rh)) {
+        return -1;
+    }
+
+    if (payload->cap < rh->length) {
+        unsigned char *grown = realloc(payload->data, rh->length);
+        if (!grown) return -1;
+        payload->data = grown;
+        payload->cap = rh->length;
+    }
+    payload->len = rh->length;
+
+    if (rh->length && read_all(f->log_fd, payload->data, rh->length, offset + sizeof(*rh)) != 0) return -1;
+    return crc32_update(0, payload->data, rh->length) == rh->checksum ? 0 : -1;
+}
+
+static int write_index(HistoryFiles *f) {
+    FileHeader h = f->header;
+    memcpy(h.magic, INDEX_MAGIC, 4);
+
+    if (ftruncate(f->idx_fd, 0) != 0 || write_all(f->idx_fd, &h, sizeof(h), 0) != 0) return -1;
+    if (f->count == 0) return 0;
+    return write_all(f->idx_fd, f->entries, (size_t)f->count * sizeof(HistoryEntry), sizeof(h));
+}
+
+/* grows f->entries to hold count entries, doubling so a log that gains one entry per save rarely moves */
+static int reserve_entries(HistoryFiles *f, uint32_t count) {
+    if (count <= f->cap) return 0;
+
+    uint32_t cap = f->cap ? f->cap : 256;
+    while (cap < count) cap *= 2;
+
+    HistoryEntry *grown = realloc(f->entries, (size_t)cap * sizeof(HistoryEntry));
+    if (!grown) return -1;
+    f->entries = grown;
+    f->cap = cap;
+    return 0;
+}
+
+static int add_entry(HistoryFiles *f, const HistoryEntry *e) {
+    if (reserve_entries(f, f->count + 1) != 0) return -1;
+    f->entries[f->count++] = *e;
+    return 0;
+}
+
+/*
+ * recovers the index from the log after a crash or an interrupted compaction: every
+ * record that checks out is indexed, a torn tail is cut off if we may write
+ */
+static int rebuild_index(HistoryFiles *f, int writable) {
+    uint64_t offset = sizeof(FileHeader);
+    ByteBuf payload = {0};
+
+    f->count = 0;
+
+    while (offset + sizeof(RecordHeader) <= f->log_size) {
+        RecordHeader rh;
+        if (read_record(f, offset, &rh, &payload) != 0) break;
+        if (rh.back > f->count) break;
+
+        uint32_t base = rh.back ? f->count - rh.back : HISTORY_KEYFRAME;
+        HistoryEntry e = { rh.time, offset, base, rh.window_count };
+        if (add_entry(f, &e) != 0) break;
+        offset += sizeof(rh) + rh.length;
+    }
+    free(payload.data);
+
+    if (!writable) return 0;
+    if (offset < f->log_size) {
+        fprintf(stderr, "sessionsnap: dropping %llu damaged bytes at the end of %s\n",
+            (unsigned long long)(f->log_size - offset), f->log_path);
+        if (ftruncate(f->log_fd, (off_t)offset) != 0) return -1;
+        f->log_size = offset;
+    }
+    return write_index(f);
+}
+
+/* loads the index if it belongs to this log and ends where the log ends, else rebuilds it */
+static int load_index(HistoryFiles *f, int writable) {
+    struct stat st;
+    FileHeader h;
+    if (fstat(f->idx_fd, &st) != 0 || (size_t)st.st_size < sizeof(h) ||
+        read_all(f->idx_fd, &h, sizeof(h), 0) != 0 || memcmp(h.magic, INDEX_MAGIC, 4) != 0 ||
+        h.log_id != f->header.log_id || (st.st_size - sizeof(h)) % sizeof(HistoryEntry) != 0) {
+        return rebuild_index(f, writable);
+    }
+
+    f->count = (uint32_t)((st.st_size - sizeof(h)) / sizeof(HistoryEntry));
+    if (f->count == 0) return f->log_size == sizeof(FileHeader) ? 0 : rebuild_index(f, writable);
+
+    if (reserve_entries(f, f->count) != 0) return -1;
+    if (read_all(f->idx_fd, f->entries, (size_t)f->count * sizeof(HistoryEntry), sizeof(h)) != 0) {
+        return rebuild_index(f, writable);
+    }
+
+    const HistoryEntry *last = &f->entries[f->count - 1];
+    RecordHeader rh;
+    if (last->offset + sizeof(rh) > f->log_size ||
+        read_all(f->log_fd, &rh, sizeof(rh), last->offset) != 0 ||
+        last->offset + sizeof(rh) + rh.length != f->log_size) {
+        return rebuild_index(f, writable);
+    }
+    return 0;
+}
+
+static void close_history(HistoryFiles *f) {
+    if (f->log_fd >= 0) close(f->log_fd);
+    if (f->idx_fd >= 0) close(f->idx_fd);
+    if (f->lock_fd >= 0) close(f->lock_fd);
+    free(f->entries);
+    f->entries = NULL;
+    f->cap = 0;
+    f->lock_fd = f->log_fd = f->idx_fd = -1;
+}
+
+/* f->entries and f->cap may hand in a buffer from an earlier open, the index is read into it */
+static int open_history(const char *profile_name, int writable, HistoryFiles *f) {
+    HistoryEntry *entries = f->entries;
+    uint32_t cap = f->cap;
+    memset(f, 0, sizeof(*f));
+    f->entries = entries;
+    f->cap = cap;
+    f->lock_fd = f->log_fd = f->idx_fd = -1;
+
+    char lock_path[512];
+    history_path(f->log_path, sizeof(f->log_path), profile_name, ".log");
+    history_path(f->idx_path, sizeof(f->idx_path), profile_name, ".idx");
+    history_path(lock_path, sizeof(lock_path), profile_name, ".lock");
+
+    if (writable) {
+        const char *home = get_session_home();
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s%s", home ? home : "/tmp", HISTORY_DIR);
+        char *parent = strrchr(dir, '/');
+        *parent = '\0';
+        mkdir(dir, 0755);
+        *parent = '/';
+        mkdir(dir, 0755);
+    } else if (access(f->log_path, F_OK) != 0) {
+        return -1;
+    }
+
+    /* a lock file of its own, so compaction can rename the log and index underneath */
+    int flags = writable ? O_RDWR | O_CREAT : O_RDONLY;
+    f->lock_fd = open(lock_path, flags | O_CLOEXEC, 0644);
+    if (f->lock_fd >= 0 && flock(f->lock_fd, writable ? LOCK_EX : LOCK_SH) != 0) goto fail;
+    if (f->lock_fd < 0 && writable) goto fail;
+
+    f->log_fd = open(f->log_path, flags | O_CLOEXEC, 0644);
+    f->idx_fd = open(f->idx_path, flags | O_CLOEXEC, 0644);
+    if (f->log_fd < 0 || (f->idx_fd < 0 && writable)) goto fail;
+
+    struct stat st;
+    if (fstat(f->log_fd, &st) != 0) goto fail;
+    f->log_size = (uint64_t)st.st_size;
+
+    if (f->log_size == 0) {
+        if (!writable) goto fail;
+        memcpy(f->header.magic, LOG_MAGIC, 4);
+        f->header.version = HISTORY_VERSION;
+        f->header.log_id = new_log_id();
+        if (write_all(f->log_fd, &f->header, sizeof(f->header), 0) != 0) goto fail;
+        f->log_size = sizeof(f->header);
+        if (write_index(f) != 0) goto fail;
+        return 0;
+    }
+
+    if (f->log_size < sizeof(f->header) || read_all(f->log_fd, &f->header, sizeof(f->header), 0) != 0 ||
+        memcmp(f->header.magic, LOG_MAGIC, 4) != 0 || f->header.version != HISTORY_VERSION) {
+        fprintf(stderr, "sessionsnap: %s is not a history log\n", f->log_path);
+        goto fail;
+    }
+
+    if (f->idx_fd < 0) {
+        if (rebuild_index(f, 0) != 0) goto fail;
+    } else if (load_index(f, writable) != 0) {
+        goto fail;
+    }
+    return 0;
+
+fail:
+    close_history(f);
+    return -1;
+}
+
+/*
+ * drops everything before the last keyframe at or before cutoff by copying the rest
+ * into a fresh log and index; skipped if a delta chain still reaches back past it
+ */
+static void compact_history(HistoryFiles *f, time_t cutoff) {
+    uint32_t k = 0;
+    for (uint32_t i = 0; i < f->count && f->entries[i].time <= cutoff; i++) {
+        if (f->entries[i].base == HISTORY_KEYFRAME) k = i;
+    }
+    if (k == 0) return;
+    for (uint32_t i = k; i < f->count; i++) {
+        if (f->entries[i].base != HISTORY_KEYFRAME && f->entries[i].base < k) return;
+    }
+
+    char tmp_log[520], tmp_idx[520];
+    snprintf(tmp_log, sizeof(tmp_log), "%s.tmp", f->log_path);
+    snprintf(tmp_idx, sizeof(tmp_idx), "%s.tmp", f->idx_path);
+
+    HistoryFiles out = *f;
+    out.header.log_id = new_log_id();
+    out.log_fd = open(tmp_log, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    out.idx_fd = open(tmp_idx, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+
+    uint64_t from = f->entries[k].offset;
+    uint64_t shift = from - sizeof(FileHeader);
+    int ok = out.log_fd >= 0 && out.idx_fd >= 0 &&
+        write_all(out.log_fd, &out.header, sizeof(out.header), 0) == 0;
+
+    char chunk[65536];
+    for (uint64_t at = from; ok && at < f->log_size; ) {
+        size_t n = f->log_size - at < sizeof(chunk) ? (size_t)(f->log_size - at) : sizeof(chunk);
+        ok = read_all(f->log_fd, chunk, n, at) == 0 && write_all(out.log_fd, chunk, n, at - shift) == 0;
+        at += n;
+    }
+
+    if (ok) {
+        memmove(f->entries, f->entries + k, (size_t)(f->count - k) * sizeof(HistoryEntry));
+        f->count -= k;
+        for (uint32_t i = 0; i < f->count; i++) {
+            f->entries[i].offset -= shift;
+            if (f->entries[i].base != HISTORY_KEYFRAME) f->entries[i].base -= k;
+        }
+        out.entries = f->entries;
+        out.count = f->count;
+        ok = write_index(&out) == 0 && fsync(out.log_fd) == 0 &&
+            rename(tmp_log, f->log_path) == 0 && rename(tmp_idx, f->idx_path) == 0;
+    }
+
+    if (!ok) {
+        if (out.log_fd >= 0) close(out.log_fd);
+        if (out.idx_fd >= 0) close(out.idx_fd);
+        unlink(tmp_log);
+        unlink(tmp_idx);
+        /* the in-memory index may already be shifted, reload it from the untouched files */
+        rebuild_index(f, 0);
+        fprintf(stderr, "sessionsnap: could not compact %s\n", f->log_path);
+        return;
+    }
+
+    close(f->log_fd);
+    close(f->idx_fd);
+    f->log_fd = out.log_fd;
+    f->idx_fd = out.idx_fd;
+    f->header = out.header;
+    f->log_size -= shift;
+}
+
+static HistoryWriter *writer_for(const char *profile_name) {
+    char log_path[512];
+    history_path(log_path, sizeof(log_path), profile_name, ".log");
+
+    for (HistoryWriter *hw = writers; hw; hw = hw->link) {
+        if (strcmp(hw->log_path, log_path) == 0) return hw;
+    }
+
+    HistoryWriter *hw = calloc(1, sizeof(HistoryWriter));
+    if (!hw) return NULL;
+    memcpy(hw->log_path, log_path, sizeof(log_path));
+    hw->link = writers;
+    writers = hw;
+    return hw;
+}
+
+/* appends list as the profile's newest history entry, a delta against what this process wrote last */
+int history_append(const WindowList *list, const char *profile_name, time_t when) {
+    if (!profile_name) profile_name = "default";
+    HistoryWriter *hw = writer_for(profile_name);
+    if (!hw) return -1;
+
+    HistoryFiles f = { .entries = hw->entries, .cap = hw->entries_cap };
+    int opened = open_history(profile_name, 1, &f) == 0;
+    /* a failed open has freed the buffer, a good one may have moved it */
+    hw->entries = f.entries;
+    hw->entries_cap = f.cap;
+    if (!opened) {
+        fprintf(stderr, "sessionsnap: cannot open history for profile '%s'\n", profile_name);
+        return -1;
+    }
+
+    /* a new log_id or fewer entries than our last means the log was rewritten or shrank under
+       us and our last entry is gone: start a fresh chain. entries other processes appended
+       since ours are fine, back skips over them and the delta stays against our own entry */
+    int keyframe = hw->log_id != f.header.log_id || hw->last_entry >= f.count ||
+        hw->since_keyframe >= HISTORY_KEYFRAME_INTERVAL;
+
+    time_t cutoff = when - (time_t)HISTORY_RETENTION_DAYS * 24 * 3600;
+    if (keyframe && f.count > 0 && f.entries[0].time < cutoff - HISTORY_COMPACT_SLACK) {
+        compact_history(&f, cutoff);
+    }
+
+    int result = -1;
+    if (encode_record(hw, list, keyframe) == 0) {
+        RecordHeader rh;
+        rh.length = (uint32_t)(hw->record.len - sizeof(rh));
+        rh.back = keyframe ? 0 : f.count - hw->last_entry;
+        rh.time = (int64_t)when;
+        rh.window_count = (uint32_t)list->count;
+        rh.checksum = crc32_update(0, hw->record.data + sizeof(rh), rh.length);
+        memcpy(hw->record.data, &rh, sizeof(rh));
+
+        HistoryEntry e = { rh.time, f.log_size, keyframe ? HISTORY_KEYFRAME : hw->last_entry, rh.window_count };
+        if (write_all(f.log_fd, hw->record.data, hw->record.len, f.log_size) == 0 &&
+            fdatasync(f.log_fd) == 0 &&
+            write_all(f.idx_fd, &e, sizeof(e), sizeof(FileHeader) + (uint64_t)f.count * sizeof(e)) == 0) {
+            result = 0;
+        } else if (ftruncate(f.log_fd, (off_t)f.log_size) != 0) {
+            fprintf(stderr, "sessionsnap: cannot cut the torn record off %s, the next index rebuild will\n",
+                f.log_path);
+        }
+    }
+
+    if (result == 0) {
+        HistState swap = hw->prev;
+        hw->prev = hw->next;
+        hw->next = swap;
+        hw->log_id = f.header.log_id;
+        hw->last_entry = f.count;
+        hw->since_keyframe = keyframe ? 0 : hw->since_keyframe + 1;
+    } else {
+        hw->log_id = 0;
+        fprintf(stderr, "sessionsnap: failed to append to %s\n", f.log_path);
+    }
+
+    hw->entries = f.entries;
+    hw->entries_cap = f.cap;
+    f.entries = NULL;
+    close_history(&f);
+    return result;
+}
+
+/* rebuilds the session as it was at the newest entry at or before at */
+WindowList *history_load_at(const char *profile_name, time_t at, time_t *found) {
+    HistoryFiles f = {0};
+    if (open_history(profile_name, 0, &f) != 0) {
+        fprintf(stderr, "sessionsnap: no history for profile '%s'\n", profile_name ? profile_name : "default");
+        return NULL;
+    }
+
+    /* newest entry with time <= at */
+    uint32_t lo = 0, hi = f.count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (f.entries[mid].time <= (int64_t)at) lo = mid + 1;
+        else hi = mid;
+    }
+    if (lo == 0) {
+        fprintf(stderr, "sessionsnap: no history entry at or before that time\n");
+        close_history(&f);
+        return NULL;
+    }
+
+    uint32_t *chain = malloc((size_t)f.count * sizeof(uint32_t));
+    int length = 0;
+    for (uint32_t i = lo - 1; chain; ) {
+        chain[length++] = i;
+        uint32_t base = f.entries[i].base;
+        if (base == HISTORY_KEYFRAME) break;
+        if (base >= i) {
+            length = 0;
+            break;
+        }
+        i = base;
+    }
+
+    HistState st = {0};
+    StringTable strings = {0};
+    ByteBuf payload = {0};
+    int ok = length > 0;
+
+    for (int c = length - 1; ok && c >= 0; c--) {
+        RecordHeader rh;
+        ok = read_record(&f, f.entries[chain[c]].offset, &rh, &payload) == 0 &&
+            apply_record(&st, &strings, payload.data, payload.len) == 0;
+    }
+
+    WindowList *list = NULL;
+    if (ok) {
+        list = state_to_list(&st, &strings);
+        if (found) *found = (time_t)f.entries[lo - 1].time;
+    } else {
+        fprintf(stderr, "sessionsnap: %s is damaged, cannot rebuild that entry\n", f.log_path);
+    }
+
+    free(chain);
+    free(st.items);
+    strings_free(&strings);
+    free(payload.data);
+    close_history(&f);
+    return list;
+}
+
+static void format_time(char *out, size_t size, time_t t) {
+    struct tm tm;
+    localtime_r(&t, &tm);
+    strftime(out, size, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+/* lists every entry from the index alone, the log itself is never read */
+int print_history(const char *profile_name, FILE *out) {
+    HistoryFiles f = {0};
+    if (open_history(profile_name, 0, &f) != 0) {
+        fprintf(stderr, "sessionsnap: no history for profile '%s'\n", profile_name ? profile_name : "default");
+        return -1;
+    }
+
+    char when[32];
+    for (uint32_t i = 0; i < f.count; i++) {
+        const HistoryEntry *e = &f.entries[i];
+        uint64_t end = i + 1 < f.count ? f.entries[i + 1].offset : f.log_size;
+        format_time(when, sizeof(when), (time_t)e->time);
+        fprintf(out, "%s  %-8s  %4u windows  %7llu bytes\n", when,
+            e->base == HISTORY_KEYFRAME ? "keyframe" : "delta", e->window_count,
+            (unsigned long long)(end - e->offset));
+    }
+    fprintf(out, "%u entries, %llu bytes in %s\n", f.count, (unsigned long long)f.log_size, f.log_path);
+
+    close_history(&f);
+    return 0;
+}
+
+/*
+ * accepts "@<unix seconds>", "-<n>s|m|h|d" relative to now, "YYYY-MM-DD[ HH:MM[:SS]]"
+ * (a T works as the separator too) and "HH:MM[:SS]", which means the last such time
+ */
+int parse_history_time(const char *s, time_t now, time_t *out) {
+    char *end;
+
+    if (s[0] == '@') {
+        long long v = strtoll(s + 1, &end, 10);
+        if (end == s + 1 || *end) return -1;
+        *out = (time_t)v;
+        return 0;
+    }
+
+    if (s[0] == '-') {
+        long long n = strtoll(s + 1, &end, 10);
+        long unit = end[0] == 's' ? 1 : end[0] == 'm' ? 60 : end[0] == 'h' ? 3600 : end[0] == 'd' ? 86400 : 0;
+        if (end == s + 1 || n < 0 || unit == 0 || end[1]) return -1;
+        *out = now - (time_t)(n * unit);
+        return 0;
+    }
+
+    static const char *const formats[] = {
+        "%Y-%m-%d %H:%M:%S", "%Y-%m-%dT%H:%M:%S", "%Y-%m-%d %H:%M", "%Y-%m-%dT%H:%M",
+        "%Y-%m-%d", "%H:%M:%S", "%H:%M", NULL
+    };
+    for (int i = 0; formats[i]; i++) {
+        struct tm tm;
+        localtime_r(&now, &tm);
+        tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+
+        end = strptime(s, formats[i], &tm);
+        if (!end || *end) continue;
+
+        tm.tm_isdst = -1;
+        time_t t = mktime(&tm);
+        if (t == (time_t)-1) return -1;
+        if (formats[i][1] == 'H' && t > now) t -= 24 * 3600;
+        *out = t;
+        return 0;
+    }
+    return -1;
+}
+
+void history_free(void) {
+    while (writers) {
+        HistoryWriter *hw = writers;
+        writers = hw->link;
+        strings_free(&hw->strings);
+        free(hw->prev.items);
+        free(hw->next.items);
+        free(hw->record.data);
+        free(hw->argv.data);
+        free(hw->ops.data);
+        free(hw->scratch.data);
+        free(hw->keys.data);
+        free(hw->entries);
+        free(hw);
+    }
+}
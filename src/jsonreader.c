@@ -0,0 +1,416 @@
+/*
+ * jsonreader.c — parses a session JSON document in one pass without building a DOM
+ * talks to: jsonreader.h, winlist.c (fills the list), session.c (hands over the mapped file)
+ * imports: stdio for error reports, stdlib/string, setjmp to unwind on the first error
+ * functions: parse_session_json(), parse_window(), parse_argv(), parse_string(), parse_int(), skip_value()
+ *
+ * schema: {"windows":[{"pid":N,"title":"..","exe_path":"..","wm_class":"..","x":N,
+ * "y":N,"width":N,"height":N,"desktop":N,"is_maximized":N,"is_minimized":N,
+ * "cmd":[".."],"cwd":"..","job":[".."],"maps":[".."]}],"count":N}
+ * keys may come in any order and unknown keys are skipped.
+ */
+
+#include "../include/jsonreader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+
+#define MAX_SKIP_DEPTH 64
+
+typedef struct {
+    const char *start;
+    const char *p;
+    const char *end;
+    const char *path;
+    WindowList *list;
+    char *scratch;          /* decoded strings that contained escapes */
+    size_t scratch_cap;
+    jmp_buf fail;
+} Reader;
+
+enum {
+    F_PID, F_TITLE, F_EXE_PATH, F_WM_CLASS, F_X, F_Y, F_WIDTH, F_HEIGHT,
+    F_DESKTOP, F_IS_MAXIMIZED, F_IS_MINIMIZED, F_CMD, F_CWD, F_JOB, F_MAPS, F_UNKNOWN
+};
+
+typedef struct {
+    const char *name;
+    int field;
+} KeySlot;
+
+/* window keys bucketed by length, at most four share a length */
+static const KeySlot key_table[13][4] = {
+    [1]  = { { "x", F_X }, { "y", F_Y } },
+    [3]  = { { "pid", F_PID }, { "cmd", F_CMD }, { "cwd", F_CWD }, { "job", F_JOB } },
+    [4]  = { { "maps", F_MAPS } },
+    [5]  = { { "title", F_TITLE }, { "width", F_WIDTH } },
+    [6]  = { { "height", F_HEIGHT } },
+    [7]  = { { "desktop", F_DESKTOP } },
+    [8]  = { { "exe_path", F_EXE_PATH }, { "wm_class", F_WM_CLASS } },
+    [12] = { { "is_maximized", F_IS_MAXIMIZED }, { "is_minimized", F_IS_MINIMIZED } },
+};
+
+static int lookup_key(const char *key, size_t len) {
+    if (len >= sizeof(key_table) / sizeof(key_table[0])) return F_UNKNOWN;
+    for (int i = 0; i < 4; i++) {
+        const KeySlot *slot = &key_table[len][i];
+        if (slot->name && memcmp(slot->name, key, len) == 0) return slot->field;
+    }
+    return F_UNKNOWN;
+}
+
+static void fail(Reader *r, const char *what) {
+    int line = 1, col = 1;
+    for (const char *q = r->start; q < r->p && q < r->end; q++) {
+        if (*q == '\n') { line++; col = 1; }
+        else col++;
+    }
+
+    if (r->p >= r->end) {
+        fprintf(stderr, "sessionsnap: %s:%d:%d: %s, got end of file\n", r->path, line, col, what);
+    } else {
+        fprintf(stderr, "sessionsnap: %s:%d:%d: %s, got '%c'\n", r->path, line, col, what, *r->p);
+    }
+    longjmp(r->fail, 1);
+}
+
+static void skip_ws(Reader *r) {
+    while (r->p < r->end && (*r->p == ' ' || *r->p == '\n' || *r->p == '\r' || *r->p == '\t')) r->p++;
+}
+
+static int peek(Reader *r) {
+    skip_ws(r);
+    return r->p < r->end ? (unsigned char)*r->p : -1;
+}
+
+static void expect(Reader *r, char c, const char *what) {
+    if (peek(r) != c) fail(r, what);
+    r->p++;
+}
+
+/* consumes a literal such as true/false/null */
+static void expect_word(Reader *r, const char *word) {
+    size_t len = strlen(word);
+    if ((size_t)(r->end - r->p) < len || memcmp(r->p, word, len) != 0) fail(r, "invalid literal");
+    r->p += len;
+}
+
+static int hex_value(Reader *r, char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    fail(r, "invalid \\u escape");
+    return 0;
+}
+
+static unsigned read_hex4(Reader *r) {
+    if (r->end - r->p < 4) fail(r, "truncated \\u escape");
+    unsigned v = 0;
+    for (int i = 0; i < 4; i++) v = (v << 4) | (unsigned)hex_value(r, *r->p++);
+    return v;
+}
+
+static void scratch_put(Reader *r, size_t *len, const char *s, size_t n) {
+    if (*len + n > r->scratch_cap) {
+        size_t cap = r->scratch_cap ? r->scratch_cap * 2 : 256;
+        while (cap < *len + n) cap *= 2;
+        char *grown = realloc(r->scratch, cap);
+        if (!grown) fail(r, "out of memory");
+        r->scratch = grown;
+        r->scratch_cap = cap;
+    }
+    memcpy(r->scratch + *len, s, n);
+    *len += n;
+}
+
+static size_t encode_utf8(unsigned cp, char *out) {
+    if (cp < 0x80) { out[0] = (char)cp; return 1; }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+/*
+ * parses a string and returns its bytes through out and len. strings without escapes are
+ * returned in place, the rest are decoded into the reader's scratch buffer.
+ */
+static void parse_string(Reader *r, const char **out, size_t *len) {
+    expect(r, '"', "expected string");
+
+    const char *begin = r->p;
+    while (r->p < r->end && *r->p != '"' && *r->p != '\\') {
+        if ((unsigned char)*r->p < 0x20) fail(r, "control character in string");
+        r->p++;
+    }
+    if (r->p >= r->end) fail(r, "unterminated string");
+
+    if (*r->p == '"') {
+        *out = begin;
+        *len = (size_t)(r->p - begin);
+        r->p++;
+        return;
+    }
+
+    size_t n = 0;
+    scratch_put(r, &n, begin, (size_t)(r->p - begin));
+
+    while (r->p < r->end && *r->p != '"') {
+        if (*r->p != '\\') {
+            const char *run = r->p;
+            while (r->p < r->end && *r->p != '"' && *r->p != '\\') {
+                if ((unsigned char)*r->p < 0x20) fail(r, "control character in string");
+                r->p++;
+            }
+            scratch_put(r, &n, run, (size_t)(r->p - run));
+            continue;
+        }
+
+        if (++r->p >= r->end) fail(r, "unterminated string");
+        char e = *r->p++;
+        char utf8[4];
+        switch (e) {
+        case '"':  scratch_put(r, &n, "\"", 1); break;
+        case '\\': scratch_put(r, &n, "\\", 1); break;
+        case '/':  scratch_put(r, &n, "/", 1); break;
+        case 'b':  scratch_put(r, &n, "\b", 1); break;
+        case 'f':  scratch_put(r, &n, "\f", 1); break;
+        case 'n':  scratch_put(r, &n, "\n", 1); break;
+        case 'r':  scratch_put(r, &n, "\r", 1); break;
+        case 't':  scratch_put(r, &n, "\t", 1); break;
+        case 'u': {
+            unsigned cp = read_hex4(r);
+            if (cp >= 0xD800 && cp <= 0xDBFF) {
+                if (r->end - r->p < 6 || r->p[0] != '\\' || r->p[1] != 'u') {
+                    fail(r, "unpaired surrogate in \\u escape");
+                }
+                r->p += 2;
+                unsigned lo = read_hex4(r);
+                if (lo < 0xDC00 || lo > 0xDFFF) fail(r, "invalid low surrogate");
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+            } else if (cp >= 0xDC00 && cp <= 0xDFFF) {
+                fail(r, "unpaired surrogate in \\u escape");
+            }
+            scratch_put(r, &n, utf8, encode_utf8(cp, utf8));
+            break;
+        }
+        default:
+            r->p--;
+            fail(r, "invalid escape");
+        }
+    }
+    if (r->p >= r->end) fail(r, "unterminated string");
+    r->p++;
+
+    *out = r->scratch;
+    *len = n;
+}
+
+static uint32_t parse_stored_string(Reader *r) {
+    const char *s;
+    size_t len;
+    parse_string(r, &s, &len);
+    return store_string(r->list, s, len);
+}
+
+/* integers take the fast path, fractions and exponents are truncated like the old loader did */
+static int parse_int(Reader *r) {
+    if (peek(r) < 0) fail(r, "expected number");
+
+    const char *begin = r->p;
+    int negative = 0;
+    if (*r->p == '-') { negative = 1; r->p++; }
+    if (r->p >= r->end || *r->p < '0' || *r->p > '9') fail(r, "expected number");
+
+    long long v = 0;
+    while (r->p < r->end && *r->p >= '0' && *r->p <= '9') {
+        if (v < 1000000000000LL) v = v * 10 + (*r->p - '0');
+        r->p++;
+    }
+
+    if (r->p < r->end && (*r->p == '.' || *r->p == 'e' || *r->p == 'E')) {
+        char num[64];
+        while (r->p < r->end && strchr("0123456789.eE+-", *r->p)) r->p++;
+        size_t n = (size_t)(r->p - begin);
+        if (n >= sizeof(num)) fail(r, "number too long");
+        memcpy(num, begin, n);
+        num[n] = '\0';
+        return (int)strtod(num, NULL);
+    }
+
+    if (negative) v = -v;
+    if (v > 2147483647LL) v = 2147483647LL;
+    if (v < -2147483647LL - 1) v = -2147483647LL - 1;
+    return (int)v;
+}
+
+static void skip_value(Reader *r, int depth) {
+    if (depth > MAX_SKIP_DEPTH) fail(r, "nesting too deep");
+
+    const char *s;
+    size_t len;
+    int c = peek(r);
+    switch (c) {
+    case '"':
+        parse_string(r, &s, &len);
+        return;
+    case '{':
+        r->p++;
+        if (peek(r) == '}') { r->p++; return; }
+        for (;;) {
+            parse_string(r, &s, &len);
+            expect(r, ':', "expected ':' after key");
+            skip_value(r, depth + 1);
+            if (peek(r) == ',') { r->p++; continue; }
+            expect(r, '}', "expected ',' or '}' in object");
+            return;
+        }
+    case '[':
+        r->p++;
+        if (peek(r) == ']') { r->p++; return; }
+        for (;;) {
+            skip_value(r, depth + 1);
+            if (peek(r) == ',') { r->p++; continue; }
+            expect(r, ']', "expected ',' or ']' in array");
+            return;
+        }
+    case 't': expect_word(r, "true"); return;
+    case 'f': expect_word(r, "false"); return;
+    case 'n': expect_word(r, "null"); return;
+    default:
+        parse_int(r);
+        return;
+    }
+}
+
+/* field is F_CMD, F_JOB or F_MAPS, the string arrays of a window */
+static void parse_argv(Reader *r, WindowInfo *w, int field) {
+    expect(r, '[', field == F_JOB ? "expected '[' for \"job\"" :
+        field == F_MAPS ? "expected '[' for \"maps\"" : "expected '[' for \"cmd\"");
+    if (peek(r) == ']') { r->p++; return; }
+
+    for (;;) {
+        const char *s;
+        size_t len;
+        parse_string(r, &s, &len);
+        int added = field == F_JOB ? add_window_job_arg(r->list, w, s, len) :
+            field == F_MAPS ? add_window_map(r->list, w, s, len) : add_window_arg(r->list, w, s, len);
+        if (added != 0) fail(r, "out of memory");
+
+        if (peek(r) == ',') { r->p++; continue; }
+        expect(r, ']', field == F_JOB ? "expected ',' or ']' in \"job\"" :
+            field == F_MAPS ? "expected ',' or ']' in \"maps\"" : "expected ',' or ']' in \"cmd\"");
+        return;
+    }
+}
+
+static void parse_window(Reader *r) {
+    WindowInfo *w = add_window(r->list);
+    if (!w) fail(r, "out of memory");
+
+    expect(r, '{', "expected '{' for window");
+    if (peek(r) == '}') { r->p++; return; }
+
+    for (;;) {
+        const char *key;
+        size_t key_len;
+        parse_string(r, &key, &key_len);
+        expect(r, ':', "expected ':' after key");
+
+        switch (lookup_key(key, key_len)) {
+        case F_PID:          w->pid = parse_int(r); break;
+        case F_TITLE:        w->title = parse_stored_string(r); break;
+        case F_EXE_PATH:     w->exe_path = parse_stored_string(r); break;
+        case F_WM_CLASS:     w->wm_class = parse_stored_string(r); break;
+        case F_X:            w->x = parse_int(r); break;
+        case F_Y:            w->y = parse_int(r); break;
+        case F_WIDTH:        w->width = parse_int(r); break;
+        case F_HEIGHT:       w->height = parse_int(r); break;
+        case F_DESKTOP:      w->desktop = parse_int(r); break;
+        case F_IS_MAXIMIZED: w->is_maximized = parse_int(r); break;
+        case F_IS_MINIMIZED: w->is_minimized = parse_int(r); break;
+        case F_CMD:          parse_argv(r, w, F_CMD); break;
+        case F_CWD:          w->cwd = parse_stored_string(r); break;
+        case F_JOB:          parse_argv(r, w, F_JOB); break;
+        case F_MAPS:         parse_argv(r, w, F_MAPS); break;
+        default:             skip_value(r, 0); break;
+        }
+
+        if (peek(r) == ',') { r->p++; continue; }
+        expect(r, '}', "expected ',' or '}' in window");
+        return;
+    }
+}
+
+static void parse_windows(Reader *r) {
+    expect(r, '[', "expected '[' for \"windows\"");
+    if (peek(r) == ']') { r->p++; return; }
+
+    for (;;) {
+        parse_window(r);
+        if (peek(r) == ',') { r->p++; continue; }
+        expect(r, ']', "expected ',' or ']' in \"windows\"");
+        return;
+    }
+}
+
+static void parse_document(Reader *r) {
+    expect(r, '{', "expected '{' at start of session");
+
+    if (peek(r) != '}') {
+        for (;;) {
+            const char *key;
+            size_t key_len;
+            parse_string(r, &key, &key_len);
+            expect(r, ':', "expected ':' after key");
+
+            if (key_len == 7 && memcmp(key, "windows", 7) == 0) parse_windows(r);
+            else skip_value(r, 0);
+
+            if (peek(r) == ',') { r->p++; continue; }
+            break;
+        }
+    }
+    expect(r, '}', "expected ',' or '}' at top level");
+
+    if (peek(r) >= 0) fail(r, "unexpected data after session");
+}
+
+/* parses data (not NUL-terminated) into a new list, path is only used in error messages */
+WindowList *parse_session_json(const char *data, size_t len, const char *path) {
+    Reader r;
+    memset(&r, 0, sizeof(r));
+    r.start = r.p = data;
+    r.end = data + len;
+    r.path = path;
+
+    r.list = new_window_list();
+    if (!r.list) return NULL;
+
+    /* decoded strings never outgrow the document, so one reservation covers the arena */
+    reserve_strings(r.list, len);
+
+    if (setjmp(r.fail) != 0) {
+        free(r.scratch);
+        free_window_list(r.list);
+        return NULL;
+    }
+
+    parse_document(&r);
+
+    free(r.scratch);
+    return r.list;
+}
@@ -0,0 +1,94 @@
+/*
+ * jsonwriter.c — appends JSON tokens to a growable buffer without building a DOM
+ * talks to: jsonwriter.h, session.c (save_session_json)
+ * imports: stdio for number formatting, stdlib/string for the buffer
+ * functions: json_reset(), json_raw(), json_string(), json_int(), json_reserve()
+ */
+
+#include "../include/jsonwriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static char *json_reserve(JsonBuf *buf, size_t extra) {
+    if (buf->failed) return NULL;
+
+    if (buf->len + extra > buf->cap) {
+        size_t cap = buf->cap ? buf->cap : 4096;
+        while (cap < buf->len + extra) cap *= 2;
+
+        char *grown = realloc(buf->data, cap);
+        if (!grown) {
+            buf->failed = 1;
+            return NULL;
+        }
+        buf->data = grown;
+        buf->cap = cap;
+    }
+    return buf->data + buf->len;
+}
+
+/* empties the buffer but keeps its memory for the next document */
+void json_reset(JsonBuf *buf) {
+    buf->len = 0;
+    buf->failed = 0;
+}
+
+void json_free(JsonBuf *buf) {
+    free(buf->data);
+    memset(buf, 0, sizeof(*buf));
+}
+
+void json_raw(JsonBuf *buf, const char *s, size_t len) {
+    char *out = json_reserve(buf, len);
+    if (!out) return;
+    memcpy(out, s, len);
+    buf->len += len;
+}
+
+/* escapes like cJSON: the short forms for " \ \b \f \n \r \t, \u00XX for other control bytes */
+void json_string(JsonBuf *buf, const char *s) {
+    const unsigned char *p = (const unsigned char *)s;
+
+    size_t extra = 2;
+    for (const unsigned char *q = p; *q; q++) {
+        if (*q == '"' || *q == '\\' || *q == '\b' || *q == '\f' ||
+            *q == '\n' || *q == '\r' || *q == '\t') extra += 2;
+        else if (*q < 32) extra += 6;
+        else extra += 1;
+    }
+
+    char *out = json_reserve(buf, extra);
+    if (!out) return;
+
+    *out++ = '"';
+    for (; *p; p++) {
+        if (*p > 31 && *p != '"' && *p != '\\') {
+            *out++ = (char)*p;
+            continue;
+        }
+
+        *out++ = '\\';
+        switch (*p) {
+        case '\\': *out++ = '\\'; break;
+        case '"':  *out++ = '"'; break;
+        case '\b': *out++ = 'b'; break;
+        case '\f': *out++ = 'f'; break;
+        case '\n': *out++ = 'n'; break;
+        case '\r': *out++ = 'r'; break;
+        case '\t': *out++ = 't'; break;
+        default:
+            snprintf(out, 6, "u%04x", *p);
+            out += 5;
+            break;
+        }
+    }
+    *out++ = '"';
+    buf->len += extra;
+}
+
+void json_int(JsonBuf *buf, long long v) {
+    char num[24];
+    int len = snprintf(num, sizeof(num), "%lld", v);
+    json_raw(buf, num, (size_t)len);
+}
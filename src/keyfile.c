@@ -0,0 +1,49 @@
+/*
+ * keyfile.c — reads one "key value" setting per line for the launch policy and launch hints
+ * talks to: keyfile.h, scheduler.c, planner.c
+ * imports: stdio for the file and the per-line warnings
+ * functions: read_key_file(), trim()
+ */
+
+#include "../include/keyfile.h"
+#include <stdio.h>
+#include <string.h>
+
+static char *trim(char *s) {
+    while (*s == ' ' || *s == '\t') s++;
+    char *end = s + strlen(s);
+    while (end > s && (end[-1] == ' ' || end[-1] == '\t')) end--;
+    *end = '\0';
+    return s;
+}
+
+/*
+ * hands each key and value of path to apply, both trimmed. a line without the separator
+ * or a value, or one apply refuses, is reported with what was expected and skipped.
+ * a missing file is not an error
+ */
+void read_key_file(const char *path, char separator, const char *expected, KeyLineFn apply, void *data) {
+    FILE *f = fopen(path, "r");
+    if (!f) return;
+
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f)) {
+        lineno++;
+        line[strcspn(line, "#\r\n")] = '\0';
+        char *key = trim(line);
+        if (key[0] == '\0') continue;
+
+        char *split = separator == KEY_SPACE ? key + strcspn(key, " \t") : strchr(key, separator);
+        char *value = "";
+        if (split && *split) {
+            *split = '\0';
+            value = trim(split + 1);
+            key = trim(key);
+        }
+        if (key[0] == '\0' || value[0] == '\0' || apply(data, key, value) != 0) {
+            fprintf(stderr, "sessionsnap: %s:%d: bad line, expected %s\n", path, lineno, expected);
+        }
+    }
+    fclose(f);
+}
@@ -1,9 +1,10 @@
 /*
  * main.c — entry point, parses CLI args and routes to the correct mode
- * talks to: monitor.h, restore.h, session.h, gui.h — orchestrates all modules
+ * talks to: monitor.h, restore.h, session.h, gui.h, control.h (asks a running daemon first), catalog.h — orchestrates all modules
  * imports: all project headers, X11 for display init check
- * functions: main(), print_usage()
- * usage: ./sessionsnap [--snapshot] [--restore] [--daemon] [--gui] [--list]
+ * functions: main(), print_usage(), print_stats(), load_profile()
+ * usage: ./sessionsnap [--snapshot] [--restore] [--daemon [--seats]] [--gui] [--list] [--export] [--import] [--stats] [--pause] [--resume] [--history]
+ * [--list-profiles]
  */
 
 #include "../include/monitor.h"
@@ -11,20 +12,37 @@
 #include "../include/session.h"
 #include "../include/restore.h"
 #include "../include/gui.h"
+#include "../include/stats.h"
+#include "../include/control.h"
+#include "../include/history.h"
+#include "../include/catalog.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
+#include <time.h>
+#include <sys/stat.h>
 #include <X11/Xlib.h>
 
 static void print_usage(void) {
     printf("SessionSnap — Linux session restoration manager\n\n");
     printf("Usage: sessionsnap [option]\n\n");
-    printf("  --snapshot              capture current windows and save to session.json\n");
+    printf("  --snapshot              capture current windows and save to session.snap\n");
     printf("  --restore               restore apps from last saved session\n");
-    printf("  --daemon                run in background, auto-snapshot every 60s\n");
-    printf("  --gui                   show restore dialog on startup\n");
+    printf("  --daemon                run in background, auto-snapshot on window changes\n");
+    printf("  --seats                 with --daemon, watch every local X display and save each\n");
+    printf("                          to the profiles of the user who owns it\n");
+    printf("  --gui                   show restore dialog on startup, with a picker if there are several profiles\n");
     printf("  --list                  list all windows currently open\n");
+    printf("  --list-profiles         list saved profiles with their window count, apps and save time\n");
+    printf("  --export [file]         write the saved session as JSON (stdout by default)\n");
+    printf("  --import <file>         load a JSON session and save it as the profile\n");
+    printf("  --stats                 print the daemon's latest stats (Prometheus text format)\n");
+    printf("  --pause / --resume      stop and restart the daemon's automatic saves\n");
+    printf("  --history               list the saved history of the profile\n");
+    printf("  --at <time>             with --restore/--export, use the session as it was then\n");
+    printf("                          (\"2026-05-01 09:30\", \"09:30\", \"-2h\", \"@<unix time>\")\n");
     printf("  --profile <name>        use a named session profile\n");
+    printf("  --stats-file <path>     where the daemon writes its stats, e.g. a node_exporter textfile dir\n");
     printf("  --help                  show this help\n\n");
     printf("Examples:\n");
     printf("  sessionsnap --snapshot\n");
@@ -32,6 +50,55 @@ static void print_usage(void) {
     printf("  sessionsnap --snapshot --profile deep-work\n");
     printf("  sessionsnap --restore  --profile deep-work\n");
     printf("  sessionsnap --daemon\n");
+    printf("  sessionsnap --daemon --seats\n");
+    printf("  sessionsnap --restore --at -30m\n");
+    printf("  sessionsnap --daemon --stats-file /var/lib/node_exporter/textfile/sessionsnap.prom\n");
+    printf("  sessionsnap --export --profile deep-work > deep-work.json\n");
+}
+
+/* live numbers from a running daemon, else the file it last wrote */
+static int print_stats(void) {
+    int asked = control_request("stats", stdout);
+    if (asked != CONTROL_NO_DAEMON) return asked;
+
+    const char *path = get_stats_path();
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        fprintf(stderr, "sessionsnap: no stats at %s, is the daemon running?\n", path);
+        return 1;
+    }
+
+    struct stat st;
+    if (fstat(fileno(f), &st) == 0 &&
+        difftime(time(NULL), st.st_mtime) * 1000 > 2 * STATS_WRITE_INTERVAL_MS) {
+        fprintf(stderr, "sessionsnap: %s was last written %.0f s ago, the daemon may have stopped\n",
+            path, difftime(time(NULL), st.st_mtime));
+    }
+
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) fwrite(buf, 1, n, stdout);
+    fclose(f);
+    return 0;
+}
+
+/* the saved session, or with --at the one from history closest before that time */
+static WindowList *load_profile(const char *profile, const char *at) {
+    if (!at) return load_session(profile);
+
+    time_t when, found;
+    if (parse_history_time(at, time(NULL), &when) != 0) {
+        fprintf(stderr, "sessionsnap: cannot parse time '%s'\n", at);
+        return NULL;
+    }
+
+    WindowList *list = history_load_at(profile, when, &found);
+    if (list) {
+        char stamp[32];
+        strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&found));
+        fprintf(stderr, "sessionsnap: using the session saved at %s\n", stamp);
+    }
+    return list;
 }
 
 int main(int argc, char *argv[]) {
@@ -41,13 +108,27 @@ int main(int argc, char *argv[]) {
     }
 
     const char *profile = "default";
+    const char *at = NULL;
+    int all_displays = 0;
 
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
             profile = argv[++i];
+        } else if (strcmp(argv[i], "--stats-file") == 0 && i + 1 < argc) {
+            set_stats_path(argv[++i]);
+        } else if (strcmp(argv[i], "--at") == 0 && i + 1 < argc) {
+            at = argv[++i];
+        } else if (strcmp(argv[i], "--seats") == 0) {
+            all_displays = 1;
         }
     }
 
+    /* profile names become file names, refused here so no path writes outside the sessions dir */
+    if (!valid_profile_name(profile)) {
+        fprintf(stderr, "sessionsnap: invalid profile name '%s'\n", profile);
+        return 1;
+    }
+
     for (int i = 1; i < argc; i++) {
         if (strcmp(argv[i], "--help") == 0) {
             print_usage();
@@ -55,6 +136,9 @@ int main(int argc, char *argv[]) {
         }
 
         if (strcmp(argv[i], "--list") == 0) {
+            int asked = control_request("list", stdout);
+            if (asked != CONTROL_NO_DAEMON) return asked;
+
             Display *display = XOpenDisplay(NULL);
             if (!display) {
                 fprintf(stderr, "sessionsnap: cannot open X display\n");
@@ -63,14 +147,7 @@ int main(int argc, char *argv[]) {
             WindowList *list = capture_windows(display);
             if (!list) { XCloseDisplay(display); return 1; }
 
-            printf("Found %d user windows:\n\n", list->count);
-            for (int j = 0; j < list->count; j++) {
-                WindowInfo *w = &list->windows[j];
-                printf("[%d] %s\n", j + 1, w->title[0] ? w->title : "(no title)");
-                printf("    PID: %d  |  pos: %d,%d  |  size: %dx%d  |  desktop: %d\n",
-                    w->pid, w->x, w->y, w->width, w->height, w->desktop);
-                printf("    cmd: %s\n\n", w->cmd_argc > 0 ? w->cmd[0] : "(unknown)");
-            }
+            write_window_list(stdout, list);
 
             free_window_list(list);
             XCloseDisplay(display);
@@ -78,6 +155,11 @@ int main(int argc, char *argv[]) {
         }
 
         if (strcmp(argv[i], "--snapshot") == 0) {
+            char request[CONTROL_REQUEST_MAX];
+            snprintf(request, sizeof(request), "snapshot %s", profile);
+            int asked = control_request(request, stdout);
+            if (asked != CONTROL_NO_DAEMON) return asked;
+
             Display *display = XOpenDisplay(NULL);
             if (!display) {
                 fprintf(stderr, "sessionsnap: cannot open X display\n");
@@ -92,25 +174,74 @@ int main(int argc, char *argv[]) {
             return result == 0 ? 0 : 1;
         }
 
+        if (strcmp(argv[i], "--export") == 0) {
+            const char *path = "-";
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) path = argv[i + 1];
+
+            WindowList *list = load_profile(profile, at);
+            if (!list) return 1;
+
+            int result = save_session_json(list, path);
+            free_window_list(list);
+            return result == 0 ? 0 : 1;
+        }
+
+        if (strcmp(argv[i], "--import") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "sessionsnap: --import needs a file\n");
+                return 1;
+            }
+
+            WindowList *list = load_session_json(argv[i + 1]);
+            if (!list) return 1;
+
+            int result = save_session(list, profile);
+            free_window_list(list);
+            return result == 0 ? 0 : 1;
+        }
+
         if (strcmp(argv[i], "--restore") == 0) {
-            return restore_session(profile) == 0 ? 0 : 1;
+            WindowList *list = load_profile(profile, at);
+            if (!list) return 1;
+            return restore_window_list(list, profile, NULL) == 0 ? 0 : 1;
         }
 
         if (strcmp(argv[i], "--daemon") == 0) {
-            start_monitor();
+            start_monitor(all_displays);
             return 0;
         }
 
         if (strcmp(argv[i], "--gui") == 0) {
-            run_gui();
+            run_gui(profile);
             return 0;
         }
 
-        if (strcmp(argv[i], "--profile") == 0) {
+        if (strcmp(argv[i], "--list-profiles") == 0) {
+            return print_profiles(stdout) == 0 ? 0 : 1;
+        }
+
+        if (strcmp(argv[i], "--stats") == 0) {
+            return print_stats();
+        }
+
+        if (strcmp(argv[i], "--pause") == 0 || strcmp(argv[i], "--resume") == 0) {
+            int asked = control_request(argv[i] + 2, stdout);
+            if (asked == CONTROL_NO_DAEMON) fprintf(stderr, "sessionsnap: no daemon is running\n");
+            return asked == 0 ? 0 : 1;
+        }
+
+        if (strcmp(argv[i], "--history") == 0) {
+            return print_history(profile, stdout) == 0 ? 0 : 1;
+        }
+
+        if (strcmp(argv[i], "--profile") == 0 || strcmp(argv[i], "--stats-file") == 0 ||
+            strcmp(argv[i], "--at") == 0) {
             i++;
             continue;
         }
 
+        if (strcmp(argv[i], "--seats") == 0) continue;
+
         fprintf(stderr, "sessionsnap: unknown option '%s'\n", argv[i]);
         print_usage();
         return 1;
@@ -0,0 +1,348 @@
+/*
+ * matcher.c — index of candidate windows that restore assigns to saved windows
+ * talks to: matcher.h, capture.c (capture_window_set, get_client_list), restore.c
+ * imports: time.h to account matching cost, procinfo.h for parent pids
+ * functions: new_match_index(), index_client_list(), index_mark_dirty(), assign_matches(),
+ * refresh_index(), score_pair()
+ *
+ * every candidate is queried once when it appears and again only when its title
+ * changes, all dirty windows in one pipelined batch. assignment scores every
+ * (waiting saved window, unclaimed candidate) pair and hands out the best pairs
+ * first, so two terminals with the same title still land on distinct windows.
+ */
+
+#include "../include/matcher.h"
+#include "../include/capture.h"
+#include "../include/procinfo.h"
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+
+/* how far up the process tree a window's pid is followed looking for the launched pid */
+#define MAX_ANCESTORS 16
+
+#define SCORE_PID 100
+#define SCORE_CLASS 40
+#define SCORE_EXE 30
+#define SCORE_TITLE 40
+/* a class match or an exact title alone is enough, a fuzzy title alone is not */
+#define MIN_SCORE 40
+
+typedef struct {
+    Window window;
+    int dirty;
+    int claimed;        /* assigned, or already open before the restore began */
+    int row;            /* index into MatchIndex.windows, -1 if not a user app window */
+    pid_t ancestors[MAX_ANCESTORS];  /* the window's pid followed by its parents */
+    int ancestor_count;
+} IndexEntry;
+
+struct MatchIndex {
+    Display *display;
+    const WindowList *saved;
+    IndexEntry *entries;
+    int count;
+    int cap;
+    int dirty_count;
+    WindowList *windows;    /* captured properties of every unclaimed entry */
+    MatchStats stats;
+};
+
+typedef struct {
+    int score;
+    int target;
+    int entry;
+    MatchKind kind;
+} Pair;
+
+static double elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)(now.tv_sec - since->tv_sec) * 1000.0 +
+        (double)(now.tv_nsec - since->tv_nsec) / 1e6;
+}
+
+static void load_ancestors(IndexEntry *e, pid_t pid) {
+    e->ancestor_count = 0;
+    while (pid > 1 && e->ancestor_count < MAX_ANCESTORS) {
+        e->ancestors[e->ancestor_count++] = pid;
+        ProcStat st;
+        pid = read_proc_stat(pid, &st) == 0 ? st.ppid : 0;
+    }
+}
+
+static IndexEntry *find_entry(MatchIndex *index, Window window) {
+    for (int i = 0; i < index->count; i++) {
+        if (index->entries[i].window == window) return &index->entries[i];
+    }
+    return NULL;
+}
+
+static IndexEntry *add_entry(MatchIndex *index, Window window, int claimed) {
+    if (index->count == index->cap) {
+        int cap = index->cap ? index->cap * 2 : 64;
+        IndexEntry *grown = realloc(index->entries, (size_t)cap * sizeof(IndexEntry));
+        if (!grown) return NULL;
+        index->entries = grown;
+        index->cap = cap;
+    }
+
+    IndexEntry *e = &index->entries[index->count++];
+    memset(e, 0, sizeof(*e));
+    e->window = window;
+    e->claimed = claimed;
+    e->row = -1;
+    if (!claimed) {
+        /* apps often map before naming their window, so follow title changes */
+        XSelectInput(index->display, window, PropertyChangeMask);
+        e->dirty = 1;
+        index->dirty_count++;
+    }
+    return e;
+}
+
+/*
+ * windows already open before the restore are never candidates, otherwise the
+ * terminal restore was started from could be taken for a saved terminal
+ */
+MatchIndex *new_match_index(Display *display, const WindowList *saved) {
+    MatchIndex *index = calloc(1, sizeof(MatchIndex));
+    if (!index) return NULL;
+
+    index->display = display;
+    index->saved = saved;
+    index->windows = new_window_list();
+    if (!index->windows) {
+        free(index);
+        return NULL;
+    }
+
+    unsigned long nitems;
+    Window *clients = get_client_list(display, &nitems);
+    for (unsigned long i = 0; i < nitems; i++) add_entry(index, clients[i], 1);
+    if (clients) XFree(clients);
+    return index;
+}
+
+void free_match_index(MatchIndex *index) {
+    if (!index) return;
+    free(index->entries);
+    free_window_list(index->windows);
+    free(index);
+}
+
+/* picks up clients that appeared since the last call, each is queried on the next assign */
+void index_client_list(MatchIndex *index) {
+    unsigned long nitems;
+    Window *clients = get_client_list(index->display, &nitems);
+
+    for (unsigned long i = 0; i < nitems; i++) {
+        if (!find_entry(index, clients[i])) add_entry(index, clients[i], 0);
+    }
+    if (clients) XFree(clients);
+}
+
+/* re-queries a window whose title changed, or adds one seen mapping before it is listed */
+void index_mark_dirty(MatchIndex *index, Window window) {
+    IndexEntry *e = find_entry(index, window);
+    if (!e) {
+        add_entry(index, window, 0);
+        return;
+    }
+    if (e->claimed || e->dirty) return;
+
+    e->dirty = 1;
+    index->dirty_count++;
+}
+
+static const WindowInfo *find_window(const WindowList *list, Window window) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->windows[i].window_id == window) return &list->windows[i];
+    }
+    return NULL;
+}
+
+/* queries all dirty entries in one batch and rebuilds the candidate list around them */
+static void refresh_index(MatchIndex *index) {
+    Window *batch = malloc((size_t)index->dirty_count * sizeof(Window));
+    WindowList *rebuilt = new_window_list();
+    if (!batch || !rebuilt) {
+        free(batch);
+        free_window_list(rebuilt);
+        return;
+    }
+
+    int n = 0;
+    for (int i = 0; i < index->count; i++) {
+        if (index->entries[i].dirty) batch[n++] = index->entries[i].window;
+    }
+
+    WindowList *fresh = capture_window_set(index->display, batch, (unsigned long)n);
+    free(batch);
+    if (!fresh) {
+        free_window_list(rebuilt);
+        return;
+    }
+    index->stats.refreshes++;
+    index->stats.windows_queried += (unsigned long)n;
+
+    for (int i = 0; i < index->count; i++) {
+        IndexEntry *e = &index->entries[i];
+        const WindowList *src = index->windows;
+        const WindowInfo *w = NULL;
+
+        if (e->dirty) {
+            src = fresh;
+            w = find_window(fresh, e->window);
+            load_ancestors(e, w ? w->pid : 0);
+            e->dirty = 0;
+        } else if (!e->claimed && e->row >= 0) {
+            w = &index->windows->windows[e->row];
+        }
+
+        e->row = -1;
+        if (w && !e->claimed && copy_window(rebuilt, src, w)) e->row = rebuilt->count - 1;
+    }
+    index->dirty_count = 0;
+
+    free_window_list(fresh);
+    free_window_list(index->windows);
+    index->windows = rebuilt;
+}
+
+static int is_descendant(const IndexEntry *e, pid_t pid) {
+    for (int i = 0; i < e->ancestor_count; i++) {
+        if (e->ancestors[i] == pid) return 1;
+    }
+    return 0;
+}
+
+/*
+ * shared prefix plus shared suffix over the longer title, so "(3) Inbox - Mail"
+ * still resembles "Inbox - Mail" and "notes.txt - Editor" resembles "todo.txt - Editor"
+ */
+static int title_score(const char *saved, const char *title) {
+    size_t ls = strlen(saved), lt = strlen(title);
+    if (ls == 0 || lt == 0) return 0;
+    if (strstr(title, saved)) return SCORE_TITLE;
+
+    size_t shorter = ls < lt ? ls : lt;
+    size_t longer = ls < lt ? lt : ls;
+    size_t prefix = 0, suffix = 0;
+    while (prefix < shorter && saved[prefix] == title[prefix]) prefix++;
+    while (suffix < shorter - prefix && saved[ls - 1 - suffix] == title[lt - 1 - suffix]) suffix++;
+
+    return (int)((SCORE_TITLE - 1) * (prefix + suffix) / longer);
+}
+
+static int score_pair(const MatchIndex *index, const MatchTarget *t,
+    const IndexEntry *e, const WindowInfo *c, MatchKind *kind) {
+    const WindowList *saved = index->saved;
+    const WindowList *found = index->windows;
+    int score = 0;
+    *kind = MATCH_NONE;
+
+    if (t->launched_pid > 0 && is_descendant(e, t->launched_pid)) {
+        score += SCORE_PID;
+        *kind = MATCH_PID;
+    }
+
+    const char *saved_class = window_wm_class(saved, t->saved);
+    if (saved_class[0] && strcasecmp(saved_class, window_wm_class(found, c)) == 0) {
+        score += SCORE_CLASS;
+        if (*kind == MATCH_NONE) *kind = MATCH_CLASS;
+    }
+
+    const char *saved_exe = window_exe_path(saved, t->saved);
+    if (saved_exe[0] && strcmp(saved_exe, window_exe_path(found, c)) == 0) {
+        score += SCORE_EXE;
+        if (*kind == MATCH_NONE) *kind = MATCH_EXE;
+    }
+
+    int title = title_score(window_title(saved, t->saved), window_title(found, c));
+    score += title;
+    if (*kind == MATCH_NONE && title > 0) *kind = MATCH_TITLE;
+
+    return score;
+}
+
+static int cmp_pairs(const void *a, const void *b) {
+    const Pair *x = a, *y = b;
+    if (x->score != y->score) return y->score - x->score;
+    if (x->target != y->target) return x->target - y->target;
+    return x->entry - y->entry;
+}
+
+/*
+ * refreshes the index if anything changed, then assigns waiting targets to unclaimed
+ * windows best pair first. writes the indices of newly assigned targets to assigned
+ * (room for count entries) and returns how many there are.
+ */
+int assign_matches(MatchIndex *index, MatchTarget *targets, int count, int *assigned) {
+    if (index->dirty_count == 0) return 0;
+
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    refresh_index(index);
+
+    Pair *pairs = NULL;
+    int npairs = 0, cap = 0;
+    for (int i = 0; i < index->count; i++) {
+        const IndexEntry *e = &index->entries[i];
+        if (e->claimed || e->row < 0) continue;
+        const WindowInfo *c = &index->windows->windows[e->row];
+
+        for (int j = 0; j < count; j++) {
+            if (!targets[j].waiting || targets[j].window != None) continue;
+
+            MatchKind kind;
+            int score = score_pair(index, &targets[j], e, c, &kind);
+            index->stats.pairs_scored++;
+            if (score < MIN_SCORE) continue;
+
+            if (npairs == cap) {
+                cap = cap ? cap * 2 : 64;
+                Pair *grown = realloc(pairs, (size_t)cap * sizeof(Pair));
+                if (!grown) break;
+                pairs = grown;
+            }
+            pairs[npairs++] = (Pair){ score, j, i, kind };
+        }
+    }
+
+    qsort(pairs, (size_t)npairs, sizeof(Pair), cmp_pairs);
+
+    int n = 0;
+    for (int i = 0; i < npairs; i++) {
+        MatchTarget *t = &targets[pairs[i].target];
+        IndexEntry *e = &index->entries[pairs[i].entry];
+        if (t->window != None || e->claimed) continue;
+
+        t->window = e->window;
+        t->kind = pairs[i].kind;
+        t->waiting = 0;
+        e->claimed = 1;
+        index->stats.by_kind[t->kind]++;
+        assigned[n++] = pairs[i].target;
+    }
+    free(pairs);
+
+    index->stats.total_ms += elapsed_ms(&started);
+    return n;
+}
+
+void get_match_stats(const MatchIndex *index, MatchStats *stats) {
+    *stats = index->stats;
+}
+
+const char *match_kind_name(MatchKind kind) {
+    switch (kind) {
+    case MATCH_PID:   return "pid";
+    case MATCH_CLASS: return "class";
+    case MATCH_EXE:   return "exe";
+    case MATCH_TITLE: return "title";
+    default:          return "none";
+    }
+}
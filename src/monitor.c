@@ -1,30 +1,739 @@
 /*
- * monitor.c — runs a continuous background loop that captures and saves windows every 60s
- * talks to: capture.c (capture_windows), session.c (save_session), monitor.h
- * imports: signal.h for SIGTERM/SIGINT handling, unistd.h for sleep()
- * functions: start_monitor(), stop_monitor(), snapshot_once(), signal_handler()
+ * monitor.c — keeps an in-memory model of all windows up to date from X events and saves it on change
+ * talks to: capture.c (capture_window_set_into, get_client_list), atoms.c, writer.c (writer_publish), monitor.h,
+ *           stats.c (snapshot timings, rewrites the stats file every STATS_WRITE_INTERVAL_MS),
+ *           control.c (answers CLI requests from the live model), seat.c (finds displays for --seats)
+ * imports: signal.h for SIGTERM/SIGINT handling, sys/epoll.h to wait on every X connection at once
+ * functions: start_monitor(), stop_monitor(), snapshot_once(), signal_handler(), publish_stats(), serve_control(),
+ * open_seat(), close_seat(), rescan_seats(), run_timers()
+ *
+ * each X display is a Seat with its own model, saved to its owner's profiles. all seats
+ * share one thread, one epoll set and one writer. only seats with changes waiting are
+ * on the pending list the timers walk, so an idle seat costs its memory and nothing else.
  */
 
 #include "../include/monitor.h"
 #include "../include/capture.h"
 #include "../include/session.h"
+#include "../include/atoms.h"
+#include "../include/writer.h"
+#include "../include/procinfo.h"
+#include "../include/stats.h"
+#include "../include/control.h"
+#include "../include/history.h"
+#include "../include/seat.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
 #include <signal.h>
+#include <time.h>
 #include <unistd.h>
+#include <sys/epoll.h>
 #include <X11/Xlib.h>
+#include <X11/Xatom.h>
 
-static volatile int running = 1;
-static Display *display = NULL;
+typedef struct {
+    Window window;
+    int dirty;
+    int seen;
+} TrackedWindow;
+
+typedef struct Seat {
+    char name[32];              /* ":3", or $DISPLAY when monitoring just one */
+    int number;                 /* display number for --seats, -1 otherwise */
+    Display *display;
+    Window root;
+    const AtomTable *atoms;
+    SessionOwner owner;
+    int has_owner;              /* else the seat is saved to our own $HOME */
+    int suffixed;               /* saves into "<profile>@<number>", kept once set */
+
+    WindowList *model;
+    WindowList *spare;
+    WindowList *fresh;          /* re-queried windows, refilled by every flush */
+    Window *batch;              /* ids of the windows being re-queried, tracked_cap long */
+    TrackedWindow *tracked;
+    int tracked_count;
+    int tracked_cap;
+
+    int client_list_dirty;
+    int windows_dirty;
+    int model_changed;
+    int unsaved;                /* the model changed while paused */
+    int dead;                   /* the X connection failed, the seat is dropped after this pass */
+    struct timespec first_pending;
+    struct timespec last_event;
+
+    struct Seat *next;
+    struct Seat *next_pending;
+    int queued;                 /* on the pending list */
+} Seat;
+
+static volatile sig_atomic_t running = 1;
+
+static Seat *seats = NULL;
+static Seat *pending = NULL;    /* seats with changes waiting to settle */
+static int seat_count = 0;
+static int multi_seat = 0;
+
+static int epoll_fd = -1;
+static int control_fd = -1;
+static int watch_fd = -1;       /* inotify on X11_SOCKET_DIR, --seats only */
+static ControlClient clients[CONTROL_MAX_CLIENTS];  /* in the epoll set until their request line is in */
+
+static struct timespec last_stats;
+static struct timespec last_rescan;
+
+static int paused = 0;          /* automatic saves held back by a "pause" request */
 
 static void signal_handler(int sig) {
     (void)sig;
-    printf("\nsessionsnap: signal received, saving final snapshot...\n");
-    snapshot_once();
     running = 0;
 }
 
+/* windows can vanish between an event and our query, so BadWindow is routine here */
+static int ignore_x_errors(Display *d, XErrorEvent *e) {
+    (void)d;
+    (void)e;
+    return 0;
+}
+
+/* the exit handler below decides what a lost connection means, this only keeps Xlib quiet */
+static int ignore_io_errors(Display *d) {
+    (void)d;
+    return 0;
+}
+
+/* a seat's X server went away; returning instead of exiting leaves the Display inert until we close it */
+static void seat_lost(Display *d, void *data) {
+    (void)d;
+    ((Seat *)data)->dead = 1;
+}
+
+static long elapsed_ms(const struct timespec *since) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - since->tv_sec) * 1000 + (now.tv_nsec - since->tv_nsec) / 1000000;
+}
+
+static int has_pending(const Seat *seat) {
+    return seat->client_list_dirty || seat->windows_dirty;
+}
+
+static void note_pending(Seat *seat) {
+    if (has_pending(seat)) return;
+
+    clock_gettime(CLOCK_MONOTONIC, &seat->first_pending);
+    seat->last_event = seat->first_pending;
+    if (!seat->queued) {
+        seat->queued = 1;
+        seat->next_pending = pending;
+        pending = seat;
+    }
+}
+
+static TrackedWindow *find_tracked(Seat *seat, Window window) {
+    for (int i = 0; i < seat->tracked_count; i++) {
+        if (seat->tracked[i].window == window) return &seat->tracked[i];
+    }
+    return NULL;
+}
+
+static const WindowInfo *find_window(const WindowList *list, Window window) {
+    for (int i = 0; i < list->count; i++) {
+        if (list->windows[i].window_id == window) return &list->windows[i];
+    }
+    return NULL;
+}
+
+/*
+ * rebuilds the model in client-list order into the spare buffer, taking re-queried
+ * windows from fresh and everything else from the current model, then swaps buffers
+ */
+static void rebuild_model(Seat *seat, const WindowList *fresh) {
+    clear_window_list(seat->spare);
+
+    for (int i = 0; i < seat->tracked_count; i++) {
+        TrackedWindow *t = &seat->tracked[i];
+        const WindowList *src = seat->model;
+        const WindowInfo *w = find_window(seat->model, t->window);
+
+        if (t->dirty && fresh) {
+            const WindowInfo *fw = find_window(fresh, t->window);
+            if ((fw == NULL) != (w == NULL) || (fw && !windows_equal(seat->model, w, fresh, fw))) {
+                seat->model_changed = 1;
+            }
+            src = fresh;
+            w = fw;
+        }
+        t->dirty = 0;
+
+        if (w) copy_window(seat->spare, src, w);
+    }
+
+    WindowList *swap = seat->model;
+    seat->model = seat->spare;
+    seat->spare = swap;
+}
+
+static int track_window(Seat *seat, Window window) {
+    if (seat->tracked_count == seat->tracked_cap) {
+        int cap = seat->tracked_cap ? seat->tracked_cap * 2 : 64;
+        TrackedWindow *grown = realloc(seat->tracked, (size_t)cap * sizeof(TrackedWindow));
+        if (!grown) return -1;
+        seat->tracked = grown;
+
+        Window *batch = realloc(seat->batch, (size_t)cap * sizeof(Window));
+        if (!batch) return -1;
+        seat->batch = batch;
+        seat->tracked_cap = cap;
+    }
+
+    XSelectInput(seat->display, window, PropertyChangeMask | StructureNotifyMask);
+
+    TrackedWindow *t = &seat->tracked[seat->tracked_count++];
+    t->window = window;
+    t->dirty = 1;
+    t->seen = 1;
+    seat->windows_dirty = 1;
+    return 0;
+}
+
+/* diffs _NET_CLIENT_LIST against the tracked set, subscribing to new clients and dropping gone ones */
+static void sync_client_list(Seat *seat) {
+    unsigned long nitems;
+    Window *clients = get_client_list(seat->display, &nitems);
+
+    for (int i = 0; i < seat->tracked_count; i++) seat->tracked[i].seen = 0;
+
+    for (unsigned long i = 0; i < nitems; i++) {
+        TrackedWindow *t = find_tracked(seat, clients[i]);
+        if (t) t->seen = 1;
+        else track_window(seat, clients[i]);
+    }
+    if (clients) XFree(clients);
+
+    int kept = 0;
+    for (int i = 0; i < seat->tracked_count; i++) {
+        if (seat->tracked[i].seen) {
+            seat->tracked[kept++] = seat->tracked[i];
+        } else if (find_window(seat->model, seat->tracked[i].window)) {
+            seat->model_changed = 1;
+        }
+    }
+    seat->tracked_count = kept;
+}
+
+static int same_home(const Seat *a, const Seat *b) {
+    if (a->has_owner != b->has_owner) return 0;
+    return !a->has_owner || strcmp(a->owner.home, b->owner.home) == 0;
+}
+
+/*
+ * the profile a seat saves into. when one home has several seats, the lowest display keeps
+ * the plain name and every other one gets "@<display>", so they never share a file. the
+ * suffix stays after the lower seat exits, or this one would overwrite what it left behind
+ */
+static void seat_profile(Seat *seat, const char *profile, char *out, size_t size) {
+    snprintf(out, size, "%s", profile);
+    if (!multi_seat) return;
+    for (const Seat *other = seats; other && !seat->suffixed; other = other->next) {
+        if (other != seat && !other->dead && other->number < seat->number && same_home(other, seat)) {
+            seat->suffixed = 1;
+        }
+    }
+    if (!seat->suffixed) return;
+
+    /* cut the name rather than the suffix, a 127 byte profile still gets its own file */
+    char suffix[16];
+    int len = snprintf(suffix, sizeof(suffix), "@%d", seat->number);
+    snprintf(out, size, "%.*s%s", (int)(size - 1) - len, profile, suffix);
+}
+
+/* publishes an immutable copy of the model, the writer thread serializes and saves it */
+static int save_model(Seat *seat, const char *profile) {
+    const WindowList *model = seat->model;
+    if (model->count == 0) {
+        if (!multi_seat) printf("sessionsnap: no user windows found to snapshot\n");
+        return -1;
+    }
+
+    WindowList *snapshot = writer_acquire();
+    if (!snapshot) return -1;
+
+    for (int i = 0; i < model->count; i++) {
+        if (!copy_window(snapshot, model, &model->windows[i])) {
+            free_window_list(snapshot);
+            return -1;
+        }
+    }
+    char name[128];
+    seat_profile(seat, profile, name, sizeof(name));
+    writer_publish(snapshot, name, seat->has_owner ? &seat->owner : NULL);
+    return 0;
+}
+
+static void autosave(Seat *seat) {
+    if (paused) seat->unsaved = 1;
+    else save_model(seat, "default");
+}
+
+static void handle_event(Seat *seat, const XEvent *ev);
+
+/* handles whatever the seat's connection has buffered or ready, without blocking */
+static void drain_events(Seat *seat) {
+    int got = 0;
+    while (!seat->dead && XPending(seat->display)) {
+        XEvent ev;
+        XNextEvent(seat->display, &ev);
+        handle_event(seat, &ev);
+        got = 1;
+    }
+    if (got && has_pending(seat)) clock_gettime(CLOCK_MONOTONIC, &seat->last_event);
+}
+
+/* re-queries only the windows that changed since the last flush, then saves if the model moved */
+static void flush_changes(Seat *seat) {
+    if (seat->dead) return;
+
+    int was_pending = has_pending(seat);
+    uint64_t start = stats_now_ns();
+
+    if (seat->client_list_dirty) {
+        seat->client_list_dirty = 0;
+        sync_client_list(seat);
+    }
+
+    /* every buffer here belongs to the seat and is reused, a warm flush doesn't touch the heap */
+    const WindowList *fresh = NULL;
+    if (seat->windows_dirty) {
+        seat->windows_dirty = 0;
+        int n = 0;
+        for (int i = 0; i < seat->tracked_count; i++) {
+            if (seat->tracked[i].dirty) seat->batch[n++] = seat->tracked[i].window;
+        }
+        /* the seat owner's filter rules decide what is kept */
+        if (n > 0) {
+            set_session_owner(seat->has_owner ? &seat->owner : NULL);
+            capture_window_set_into(seat->display, seat->batch, (unsigned long)n, seat->fresh);
+            set_session_owner(NULL);
+            fresh = seat->fresh;
+        }
+    }
+
+    if (fresh || seat->model_changed) rebuild_model(seat, fresh);
+
+    if (seat->model_changed && !seat->dead) {
+        seat->model_changed = 0;
+        autosave(seat);
+    }
+
+    if (was_pending) stats_record(STAT_SNAPSHOT, stats_now_ns() - start);
+
+    /* replies read during the capture may have carried events in with them */
+    drain_events(seat);
+}
+
+static void flush_all(void) {
+    for (Seat *seat = seats; seat; seat = seat->next) flush_changes(seat);
+}
+
+/* rewrites the stats file for node_exporter's textfile collector */
+static void publish_stats(void) {
+    static int warned = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &last_stats);
+    if (write_stats_file(get_stats_path()) != 0 && !warned) {
+        fprintf(stderr, "sessionsnap: cannot write stats to %s\n", get_stats_path());
+        warned = 1;
+    }
+}
+
+static void mark_dirty(Seat *seat, Window window) {
+    TrackedWindow *t = find_tracked(seat, window);
+    if (!t || t->dirty) return;
+
+    note_pending(seat);
+    t->dirty = 1;
+    seat->windows_dirty = 1;
+}
+
+static void handle_event(Seat *seat, const XEvent *ev) {
+    const AtomTable *atoms = seat->atoms;
+
+    switch (ev->type) {
+    case PropertyNotify:
+        if (ev->xproperty.window == seat->root) {
+            if (ev->xproperty.atom == atoms->net_client_list && !seat->client_list_dirty) {
+                note_pending(seat);
+                seat->client_list_dirty = 1;
+            }
+        } else if (ev->xproperty.atom == atoms->net_wm_state ||
+                   ev->xproperty.atom == atoms->net_wm_desktop ||
+                   ev->xproperty.atom == atoms->net_wm_name ||
+                   ev->xproperty.atom == XA_WM_NAME) {
+            mark_dirty(seat, ev->xproperty.window);
+        }
+        break;
+    case ConfigureNotify:
+        mark_dirty(seat, ev->xconfigure.window);
+        break;
+    default:
+        break;
+    }
+}
+
+/* connects to one display and does the first full capture, returns NULL if it can't be used */
+static Seat *open_seat(const char *name, int number, const SessionOwner *owner) {
+    Seat *seat = calloc(1, sizeof(Seat));
+    if (!seat) return NULL;
+
+    seat->number = number;
+    if (owner) {
+        seat->owner = *owner;
+        seat->has_owner = 1;
+    }
+
+    seat->display = open_seat_display(name, owner);
+    if (!seat->display) {
+        free(seat);
+        return NULL;
+    }
+    snprintf(seat->name, sizeof(seat->name), "%s", DisplayString(seat->display));
+
+    seat->atoms = get_atoms(seat->display);
+    seat->model = new_window_list();
+    seat->spare = new_window_list();
+    seat->fresh = new_window_list();
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = seat };
+    if (!seat->atoms || !seat->model || !seat->spare || !seat->fresh ||
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, ConnectionNumber(seat->display), &ev) != 0) {
+        free_window_list(seat->model);
+        free_window_list(seat->spare);
+        free_window_list(seat->fresh);
+        release_atoms(seat->display);
+        XCloseDisplay(seat->display);
+        free(seat);
+        return NULL;
+    }
+
+    XSetIOErrorExitHandler(seat->display, seat_lost, seat);
+    seat->root = DefaultRootWindow(seat->display);
+    XSelectInput(seat->display, seat->root, PropertyChangeMask);
+
+    seat->next = seats;
+    seats = seat;
+    seat_count++;
+
+    note_pending(seat);
+    seat->client_list_dirty = 1;
+    flush_changes(seat);
+    return seat;
+}
+
+static void close_seat(Seat *seat) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ConnectionNumber(seat->display), NULL);
+    release_atoms(seat->display);
+    XCloseDisplay(seat->display);
+
+    free(seat->tracked);
+    free(seat->batch);
+    free_window_list(seat->model);
+    free_window_list(seat->spare);
+    free_window_list(seat->fresh);
+    free(seat);
+}
+
+/* drops seats whose X server went away, their last state is already saved */
+static void reap_seats(void) {
+    for (Seat **p = &seats; *p; ) {
+        Seat *seat = *p;
+        if (!seat->dead) {
+            p = &seat->next;
+            continue;
+        }
+        *p = seat->next;
+        seat_count--;
+
+        for (Seat **q = &pending; *q; q = &(*q)->next_pending) {
+            if (*q == seat) {
+                *q = seat->next_pending;
+                break;
+            }
+        }
+
+        printf("sessionsnap: display %s went away\n", seat->name);
+        close_seat(seat);
+
+        /* watching one display means running for as long as it does */
+        if (!multi_seat) running = 0;
+    }
+}
+
+static int seat_attached(int number) {
+    for (Seat *seat = seats; seat; seat = seat->next) {
+        if (seat->number == number) return 1;
+    }
+    return 0;
+}
+
+/*
+ * attaches every display in X11_SOCKET_DIR we aren't watching yet. as root that is
+ * every seat on the host, otherwise only the ones our own user started. a display
+ * that refuses us is retried on the next rescan and only reported the first time.
+ */
+static void rescan_seats(void) {
+    static int *refused = NULL;
+    static int refused_count = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &last_rescan);
+
+    DisplaySocket *found;
+    int count = find_displays(&found);
+    if (count < 0) return;
+
+    int *now_refused = calloc((size_t)count + 1, sizeof(int));
+    int now_count = 0;
+
+    for (int i = 0; i < count; i++) {
+        if (seat_attached(found[i].number)) continue;
+        if (geteuid() != 0 && found[i].uid != getuid()) continue;
+
+        SessionOwner owner;
+        char name[32];
+        snprintf(name, sizeof(name), ":%d", found[i].number);
+
+        Seat *seat = NULL;
+        if (get_seat_owner(found[i].uid, &owner) == 0) seat = open_seat(name, found[i].number, &owner);
+        if (seat) {
+            printf("sessionsnap: watching display %s for %s\n", seat->name, owner.home);
+            continue;
+        }
+
+        int known = 0;
+        for (int j = 0; j < refused_count; j++) known |= refused[j] == found[i].number;
+        if (!known) fprintf(stderr, "sessionsnap: cannot attach to display %s, will retry\n", name);
+        if (now_refused) now_refused[now_count++] = found[i].number;
+    }
+
+    free(found);
+    free(refused);
+    refused = now_refused;
+    refused_count = now_count;
+}
+
+/* saves every seat into profile and waits for the writer, so the files exist once we reply */
+static void handle_snapshot(FILE *out, const char *profile) {
+    if (!valid_profile_name(profile)) {
+        fprintf(out, "error invalid profile name '%s'\n", profile);
+        return;
+    }
+
+    flush_all();
+    WriterStats before, after;
+    get_writer_stats(&before);
+
+    int saved_seats = 0, windows = 0;
+    char where[1024] = "";
+    size_t used = 0;
+    for (Seat *seat = seats; seat; seat = seat->next) {
+        if (save_model(seat, profile) != 0) continue;
+        saved_seats++;
+        windows += seat->model->count;
+
+        char name[128];
+        seat_profile(seat, profile, name, sizeof(name));
+        if (used < sizeof(where)) {
+            int n = snprintf(where + used, sizeof(where) - used, "\nsessionsnap:   %s: %d windows to '%s'",
+                seat->name, seat->model->count, name);
+            if (n > 0) used += (size_t)n;
+        }
+    }
+    if (saved_seats == 0) {
+        fprintf(out, "error no user windows found to snapshot\n");
+        return;
+    }
+    writer_wait_idle();
+    get_writer_stats(&after);
+
+    if (after.failed != before.failed) {
+        fprintf(out, "error failed to save profile '%s'\n", profile);
+        return;
+    }
+    if (multi_seat) {
+        fprintf(out, "ok\nsessionsnap: saved %d windows from %d displays%s\n", windows, saved_seats, where);
+    } else {
+        fprintf(out, "ok\nsessionsnap: saved %d windows to profile '%s'\n", windows, profile);
+    }
+}
+
+static void handle_request(FILE *out, char *request) {
+    char *arg = strchr(request, ' ');
+    if (arg) *arg++ = '\0';
+
+    if (strcmp(request, "list") == 0) {
+        flush_all();
+        fprintf(out, "ok\n");
+        for (Seat *seat = seats; seat; seat = seat->next) {
+            if (multi_seat) fprintf(out, "Display %s (%s)\n", seat->name, seat->owner.home);
+            write_window_list(out, seat->model);
+        }
+    } else if (strcmp(request, "snapshot") == 0) {
+        handle_snapshot(out, arg && arg[0] ? arg : "default");
+    } else if (strcmp(request, "stats") == 0) {
+        fprintf(out, "ok\n");
+        write_stats_text(out);
+    } else if (strcmp(request, "pause") == 0) {
+        paused = 1;
+        fprintf(out, "ok\nsessionsnap: automatic saves paused\n");
+    } else if (strcmp(request, "resume") == 0) {
+        paused = 0;
+        for (Seat *seat = seats; seat; seat = seat->next) {
+            if (!seat->unsaved) continue;
+            seat->unsaved = 0;
+            save_model(seat, "default");
+        }
+        fprintf(out, "ok\nsessionsnap: automatic saves resumed\n");
+    } else {
+        fprintf(out, "error unknown request '%s'\n", request);
+    }
+}
+
+static int watch_fd_add(int fd, void *tag) {
+    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = tag };
+    return fd >= 0 ? epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) : -1;
+}
+
+static void drop_client(ControlClient *client) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+}
+
+/* reads what a client has sent so far, and answers once its request line is complete */
+static void serve_client(ControlClient *client) {
+    int got = control_read(client);
+    if (got == 0) return;
+
+    int fd = client->fd;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    client->fd = -1;
+
+    FILE *out = got > 0 ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        close(fd);
+        return;
+    }
+    handle_request(out, client->request);
+    fclose(out);
+}
+
+/* takes every connection waiting on the control socket, one request per connection */
+static void serve_control(void) {
+    int fd;
+    while ((fd = control_accept(control_fd)) != -1) {
+        if (fd < 0) continue;
+
+        ControlClient *client = NULL;
+        for (int i = 0; i < CONTROL_MAX_CLIENTS && !client; i++) {
+            if (clients[i].fd < 0) client = &clients[i];
+        }
+        if (!client || watch_fd_add(fd, client) != 0) {
+            close(fd);
+            continue;
+        }
+        client->fd = fd;
+        client->used = 0;
+        clock_gettime(CLOCK_MONOTONIC, &client->accepted);
+        /* the line usually arrives with the connection */
+        serve_client(client);
+    }
+}
+
+static int is_client(const void *tag) {
+    return (const char *)tag >= (const char *)clients && (const char *)tag < (const char *)(clients + CONTROL_MAX_CLIENTS);
+}
+
+/*
+ * flushes the seats whose changes have settled (or waited MONITOR_MAX_DELAY_MS),
+ * writes stats and rescans when due, and returns how long until the next deadline
+ */
+static long run_timers(void) {
+    long stats_in = STATS_WRITE_INTERVAL_MS - elapsed_ms(&last_stats);
+    if (stats_in <= 0) {
+        publish_stats();
+        stats_in = STATS_WRITE_INTERVAL_MS;
+    }
+    long wait_ms = stats_in;
+
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (clients[i].fd < 0) continue;
+        long left = CONTROL_IO_TIMEOUT_MS - elapsed_ms(&clients[i].accepted);
+        if (left <= 0) drop_client(&clients[i]);
+        else if (left < wait_ms) wait_ms = left;
+    }
+
+    if (multi_seat) {
+        long rescan_in = MONITOR_RESCAN_MS - elapsed_ms(&last_rescan);
+        if (rescan_in <= 0) {
+            rescan_seats();
+            rescan_in = MONITOR_RESCAN_MS;
+        }
+        if (rescan_in < wait_ms) wait_ms = rescan_in;
+    }
+
+    /* flushing can queue a seat again, so work from a detached list */
+    Seat *due = pending;
+    pending = NULL;
+    while (due) {
+        Seat *seat = due;
+        due = seat->next_pending;
+        seat->queued = 0;
+        if (!has_pending(seat) || seat->dead) continue;
+
+        long settle_in = MONITOR_SETTLE_MS - elapsed_ms(&seat->last_event);
+        long deadline_in = MONITOR_MAX_DELAY_MS - elapsed_ms(&seat->first_pending);
+        long left = settle_in < deadline_in ? settle_in : deadline_in;
+
+        if (left <= 0) {
+            flush_changes(seat);
+            if (!seat->queued) continue;
+            left = MONITOR_SETTLE_MS;
+        } else if (!seat->queued) {
+            seat->queued = 1;
+            seat->next_pending = pending;
+            pending = seat;
+        }
+        if (left < wait_ms) wait_ms = left;
+    }
+    return wait_ms;
+}
+
+static void report_write_rate(void) {
+    SessionWriteStats stats;
+    get_session_write_stats(&stats);
+
+    double hours = difftime(time(NULL), stats.since) / 3600.0;
+    printf("sessionsnap: %lu writes, %lu skipped as unchanged (%.1f writes/hour)\n",
+        stats.writes, stats.skipped, hours > 0 ? (double)stats.writes / hours : 0.0);
+
+    WriterStats ws;
+    get_writer_stats(&ws);
+    printf("sessionsnap: writer saved %lu of %lu snapshots (%lu coalesced, max queue %d), "
+        "write latency avg %.1f ms, max %.1f ms\n",
+        ws.saved, ws.published, ws.coalesced, ws.max_queue_depth,
+        ws.saved ? ws.total_write_ms / (double)ws.saved : 0.0, ws.max_write_ms);
+
+    ProcCacheStats ps;
+    get_proc_cache_stats(&ps);
+    printf("sessionsnap: /proc cache %lu hits, %lu misses, %lu evicted, %lu stat reads\n",
+        ps.hits, ps.misses, ps.evictions, ps.stat_reads);
+}
+
 void snapshot_once(void) {
+    static Display *display = NULL;
     if (!display) {
         display = XOpenDisplay(NULL);
         if (!display) {
@@ -33,6 +742,7 @@ void snapshot_once(void) {
         }
     }
 
+    uint64_t start = stats_now_ns();
     WindowList *list = capture_windows(display);
     if (!list) return;
 
@@ -44,33 +754,119 @@ void snapshot_once(void) {
 
     save_session(list, "default");
     free_window_list(list);
+    stats_record(STAT_SNAPSHOT, stats_now_ns() - start);
 }
 
-void start_monitor(void) {
+/* watches $DISPLAY, or with all_displays every X server on the host, until SIGTERM/SIGINT */
+void start_monitor(int all_displays) {
     signal(SIGTERM, signal_handler);
     signal(SIGINT, signal_handler);
+    /* a control client that hangs up mid-reply must not take the daemon down */
+    signal(SIGPIPE, SIG_IGN);
 
-    display = XOpenDisplay(NULL);
-    if (!display) {
+    multi_seat = all_displays;
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        fprintf(stderr, "sessionsnap: cannot create epoll set\n");
+        return;
+    }
+
+    XSetErrorHandler(ignore_x_errors);
+    XSetIOErrorHandler(ignore_io_errors);
+
+    /* signals stay blocked except while we sleep in epoll_pwait, so a SIGTERM can't slip past the check */
+    sigset_t blocked, orig;
+    sigemptyset(&blocked);
+    sigaddset(&blocked, SIGTERM);
+    sigaddset(&blocked, SIGINT);
+    sigprocmask(SIG_BLOCK, &blocked, &orig);
+
+    writer_start();
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) clients[i].fd = -1;
+    control_fd = control_listen();
+    watch_fd_add(control_fd, &control_fd);
+
+    if (multi_seat) {
+        watch_fd = watch_displays();
+        if (watch_fd < 0) {
+            fprintf(stderr, "sessionsnap: cannot watch %s, new displays are found every %d s\n",
+                X11_SOCKET_DIR, MONITOR_RESCAN_MS / 1000);
+        }
+        watch_fd_add(watch_fd, &watch_fd);
+        rescan_seats();
+    } else if (!open_seat(NULL, -1, NULL)) {
         fprintf(stderr, "sessionsnap: cannot open X display\n");
+        control_close(control_fd);
+        control_fd = -1;
+        writer_stop();
+        sigprocmask(SIG_SETMASK, &orig, NULL);
+        close(epoll_fd);
+        epoll_fd = -1;
         return;
     }
 
-    printf("sessionsnap: monitor started, snapshotting every %d seconds\n",
-           MONITOR_INTERVAL_SECONDS);
+    if (multi_seat) printf("sessionsnap: monitor started, watching %d displays\n", seat_count);
+    else printf("sessionsnap: monitor started, watching for window changes\n");
+    publish_stats();
 
     while (running) {
-        snapshot_once();
-        for (int i = 0; i < MONITOR_INTERVAL_SECONDS && running; i++) {
-            sleep(1);
+        long wait_ms = run_timers();
+
+        struct epoll_event events[MONITOR_MAX_EVENTS];
+        int n = epoll_pwait(epoll_fd, events, MONITOR_MAX_EVENTS, (int)wait_ms, &orig);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; i++) {
+            void *tag = events[i].data.ptr;
+            if (tag == &control_fd) serve_control();
+            else if (is_client(tag)) {
+                if (((ControlClient *)tag)->fd >= 0) serve_client(tag);
+            } else if (tag == &watch_fd) {
+                if (drain_display_watch(watch_fd)) rescan_seats();
+            } else {
+                drain_events(tag);
+            }
         }
+        reap_seats();
+    }
+
+    control_close(control_fd);
+    control_fd = -1;
+    for (int i = 0; i < CONTROL_MAX_CLIENTS; i++) {
+        if (clients[i].fd >= 0) drop_client(&clients[i]);
     }
+    if (watch_fd >= 0) close(watch_fd);
+    watch_fd = -1;
 
+    printf("\nsessionsnap: stopping, saving final snapshot...\n");
+    flush_all();
+    if (paused) {
+        printf("sessionsnap: saves are paused, keeping the last saved session\n");
+    } else {
+        for (Seat *seat = seats; seat; seat = seat->next) {
+            if (!seat->dead) save_model(seat, "default");
+        }
+    }
+    writer_stop();
+    publish_stats();
+
+    sigprocmask(SIG_SETMASK, &orig, NULL);
+
+    report_write_rate();
     printf("sessionsnap: monitor stopped\n");
-    XCloseDisplay(display);
-    display = NULL;
+    while (seats) {
+        Seat *seat = seats;
+        seats = seat->next;
+        close_seat(seat);
+    }
+    pending = NULL;
+    seat_count = 0;
+    close(epoll_fd);
+    epoll_fd = -1;
+    proc_cache_free();
+    history_free();
 }
 
 void stop_monitor(void) {
     running = 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,203 @@
+/*
+ * planner.c — groups saved windows by the process they came from so restore launches it once
+ * talks to: planner.h, restore.c, session.c (get_session_home), keyfile.c (reads launch-hints)
+ * imports: stdlib qsort to bring windows of one pid together
+ * functions: build_launch_plan(), free_launch_plan(), same_process(), find_hint(), add_hint(), load_hints()
+ *
+ * launch-hints holds one "<app> <how>" per line, '#' starts a comment. app is the basename
+ * of argv[0], how is a flag to append when asking the running app for one more window,
+ * "self" if it reopens all its windows when started, or "relaunch" to run the saved
+ * command again unchanged. the file's hints come before the built-in ones, and an app
+ * no hint names is relaunched:
+ *
+ *   firefox   --new-window
+ *   emacs     self
+ */
+
+#include "../include/planner.h"
+#include "../include/session.h"
+#include "../include/keyfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+    char app[64];
+    char flag[64];
+    ExtraWindowMode mode;
+} LaunchHint;
+
+typedef struct {
+    LaunchHint *entries;
+    int count;
+    int cap;
+} HintSet;
+
+static const LaunchHint builtin_hints[] = {
+    { "firefox", "--new-window", EXTRA_FLAG },
+    { "firefox-esr", "--new-window", EXTRA_FLAG },
+    { "chrome", "--new-window", EXTRA_FLAG },
+    { "google-chrome", "--new-window", EXTRA_FLAG },
+    { "google-chrome-stable", "--new-window", EXTRA_FLAG },
+    { "chromium", "--new-window", EXTRA_FLAG },
+    { "chromium-browser", "--new-window", EXTRA_FLAG },
+    { "brave", "--new-window", EXTRA_FLAG },
+    { "brave-browser", "--new-window", EXTRA_FLAG },
+    { "code", "--new-window", EXTRA_FLAG },
+    { "codium", "--new-window", EXTRA_FLAG },
+    { "nautilus", "--new-window", EXTRA_FLAG },
+    { "gnome-terminal", "--window", EXTRA_FLAG },
+};
+
+typedef struct {
+    int32_t pid;
+    int index;
+} PidIndex;
+
+static int cmp_pid_index(const void *a, const void *b) {
+    const PidIndex *x = a;
+    const PidIndex *y = b;
+    if (x->pid != y->pid) return x->pid < y->pid ? -1 : 1;
+    return x->index - y->index;
+}
+
+/* a pid can only be one process within a snapshot, exe and argv guard against merged lists */
+static int same_process(const WindowList *list, const WindowInfo *a, const WindowInfo *b) {
+    if (a->pid != b->pid || a->cmd_argc != b->cmd_argc) return 0;
+    if (strcmp(window_exe_path(list, a), window_exe_path(list, b)) != 0) return 0;
+    for (int i = 0; i < a->cmd_argc; i++) {
+        if (strcmp(window_arg(list, a, i), window_arg(list, b, i)) != 0) return 0;
+    }
+    return 1;
+}
+
+static int add_hint(void *data, const char *app, const char *how) {
+    HintSet *set = data;
+    if (strlen(app) >= sizeof(set->entries->app) || strlen(how) >= sizeof(set->entries->flag)) return -1;
+
+    if (set->count == set->cap) {
+        int cap = set->cap ? set->cap * 2 : 16;
+        LaunchHint *grown = realloc(set->entries, (size_t)cap * sizeof(LaunchHint));
+        /* out of memory drops the hint, the app is just relaunched */
+        if (!grown) return 0;
+        set->entries = grown;
+        set->cap = cap;
+    }
+
+    LaunchHint *h = &set->entries[set->count++];
+    memset(h, 0, sizeof(*h));
+    snprintf(h->app, sizeof(h->app), "%s", app);
+    if (strcmp(how, "self") == 0) {
+        h->mode = EXTRA_SELF;
+    } else if (strcmp(how, "relaunch") == 0) {
+        h->mode = EXTRA_RELAUNCH;
+    } else {
+        h->mode = EXTRA_FLAG;
+        snprintf(h->flag, sizeof(h->flag), "%s", how);
+    }
+    return 0;
+}
+
+/* reads launch-hints into set, a missing file is not an error */
+static void load_hints(HintSet *set) {
+    const char *home = get_session_home();
+    if (!home) return;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s%s", home, LAUNCH_HINTS_FILE);
+    read_key_file(path, KEY_SPACE, "<app> <flag|self|relaunch>", add_hint, set);
+}
+
+static const LaunchHint *find_hint(const HintSet *set, const char *argv0) {
+    const char *slash = strrchr(argv0, '/');
+    const char *app = slash ? slash + 1 : argv0;
+
+    for (int i = 0; i < set->count; i++) {
+        if (strcmp(set->entries[i].app, app) == 0) return &set->entries[i];
+    }
+    for (size_t i = 0; i < sizeof(builtin_hints) / sizeof(builtin_hints[0]); i++) {
+        if (strcmp(builtin_hints[i].app, app) == 0) return &builtin_hints[i];
+    }
+    return NULL;
+}
+
+/*
+ * fills plan with one group per saved process. windows without a pid or command line
+ * each stay on their own. returns -1 if out of memory, plan is then empty
+ */
+int build_launch_plan(const WindowList *list, LaunchPlan *plan) {
+    memset(plan, 0, sizeof(*plan));
+    int n = list->count;
+
+    PidIndex *sorted = malloc((size_t)(n ? n : 1) * sizeof(PidIndex));
+    plan->groups = malloc((size_t)(n ? n : 1) * sizeof(LaunchGroup));
+    plan->members = malloc((size_t)(n ? n : 1) * sizeof(int));
+    plan->group_of = malloc((size_t)(n ? n : 1) * sizeof(int));
+    if (!sorted || !plan->groups || !plan->members || !plan->group_of) {
+        free(sorted);
+        free_launch_plan(plan);
+        return -1;
+    }
+
+    for (int i = 0; i < n; i++) {
+        sorted[i].pid = list->windows[i].cmd_argc > 0 ? list->windows[i].pid : 0;
+        sorted[i].index = i;
+        plan->group_of[i] = -1;
+    }
+    qsort(sorted, (size_t)n, sizeof(PidIndex), cmp_pid_index);
+
+    HintSet hints = {0};
+    load_hints(&hints);
+
+    /* within a run of one pid, each window not yet grouped starts a group and collects the rest */
+    int members = 0;
+    for (int run = 0; run < n; ) {
+        int end = run + 1;
+        while (end < n && sorted[end].pid == sorted[run].pid) end++;
+
+        for (int i = run; i < end; i++) {
+            int idx = sorted[i].index;
+            if (plan->group_of[idx] >= 0) continue;
+
+            LaunchGroup *g = &plan->groups[plan->group_count];
+            g->first = members;
+            g->count = 0;
+            g->mode = EXTRA_RELAUNCH;
+            g->flag = NULL;
+
+            /* without a pid there is no telling which process a window came from */
+            int last = sorted[run].pid > 0 ? end : i + 1;
+            for (int j = i; j < last; j++) {
+                int other = sorted[j].index;
+                if (plan->group_of[other] >= 0) continue;
+                if (other != idx && !same_process(list, &list->windows[idx], &list->windows[other])) continue;
+
+                plan->group_of[other] = plan->group_count;
+                plan->members[members++] = other;
+                g->count++;
+            }
+
+            if (g->count > 1) {
+                const LaunchHint *h = find_hint(&hints, window_arg(list, &list->windows[idx], 0));
+                if (h) {
+                    g->mode = h->mode;
+                    g->flag = h->mode == EXTRA_FLAG ? h->flag : NULL;
+                }
+            }
+            plan->group_count++;
+        }
+        run = end;
+    }
+
+    free(sorted);
+    plan->hints = hints.entries;
+    return 0;
+}
+
+void free_launch_plan(LaunchPlan *plan) {
+    free(plan->groups);
+    free(plan->members);
+    free(plan->group_of);
+    free(plan->hints);
+    memset(plan, 0, sizeof(*plan));
+}
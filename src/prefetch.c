@@ -0,0 +1,177 @@
+/*
+ * prefetch.c — reads ahead the executables and libraries of a saved session while it relaunches
+ * talks to: prefetch.h, restore.c, winlist.c (window_map)
+ * imports: pthread for the worker threads, fcntl.h for posix_fadvise(WILLNEED)
+ * functions: start_prefetch(), finish_prefetch(), collect_paths(), prefetch_file(), prefetch_main()
+ *
+ * on a cold page cache every relaunched app faults its binary and libraries in one page
+ * cluster at a time, and apps launched together queue behind each other's misses. the
+ * files of the whole session are handed to the kernel up front instead, each path once,
+ * in launch order so the first wave's files are asked for first. WILLNEED only queues
+ * the reads, the threads are there because opening a file on a cold cache blocks on
+ * its directory and inode, and several lookups in flight keep the disk busy.
+ */
+
+#define _GNU_SOURCE
+#include "../include/prefetch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#define PREFETCH_MAX_THREADS 16
+
+struct Prefetch {
+    const char **paths;         /* point into the list's arena, which outlives the prefetch */
+    int count;
+    int next;                   /* next path to take, shared by the workers */
+    int stop;
+    int done;
+    int missing;
+    unsigned long long bytes;
+    struct timespec started;
+    struct timespec finished;   /* when the last worker ran out of paths */
+    pthread_t threads[PREFETCH_MAX_THREADS];
+    int thread_count;
+};
+
+static pthread_mutex_t stamp_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static double ms_since(const struct timespec *from, const struct timespec *to) {
+    return (double)(to->tv_sec - from->tv_sec) * 1000.0 + (double)(to->tv_nsec - from->tv_nsec) / 1e6;
+}
+
+/*
+ * every mapped file of the windows in order, each path once. paths are interned per
+ * list (see add_window_map), so the same file always has the same arena offset
+ */
+static int collect_paths(Prefetch *p, const WindowList *list, const int *order, int count) {
+    size_t total = 0;
+    for (int i = 0; i < count; i++) total += (size_t)list->windows[order[i]].map_count;
+    if (total == 0) return 0;
+
+    size_t cap = 64;
+    while (cap < total * 2) cap *= 2;
+    uint32_t *seen = calloc(cap, sizeof(uint32_t));
+    p->paths = malloc(total * sizeof(const char *));
+    if (!seen || !p->paths) {
+        free(seen);
+        return -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        const WindowInfo *w = &list->windows[order[i]];
+        for (int j = 0; j < w->map_count; j++) {
+            uint32_t off = list->args[w->maps + (uint32_t)j];
+            if (off == 0) continue;
+
+            size_t slot = (off * 2654435761u) & (cap - 1);
+            while (seen[slot] && seen[slot] != off) slot = (slot + 1) & (cap - 1);
+            if (seen[slot]) continue;
+
+            seen[slot] = off;
+            p->paths[p->count++] = list->strings + off;
+        }
+    }
+    free(seen);
+    return 0;
+}
+
+/* returns the bytes queued for readahead, or -1 if path can't be prefetched */
+static long prefetch_file(const char *path) {
+    /* O_NOATIME spares a metadata write per file, but only works on our own files */
+    int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOATIME);
+    if (fd < 0) fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    struct stat st;
+    long len = -1;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        len = st.st_size < PREFETCH_MAX_FILE_BYTES ? (long)st.st_size : PREFETCH_MAX_FILE_BYTES;
+        if (posix_fadvise(fd, 0, len, POSIX_FADV_WILLNEED) != 0) len = -1;
+    }
+    close(fd);
+    return len;
+}
+
+static void *prefetch_main(void *arg) {
+    Prefetch *p = arg;
+
+    for (;;) {
+        if (__atomic_load_n(&p->stop, __ATOMIC_RELAXED)) break;
+        int i = __atomic_fetch_add(&p->next, 1, __ATOMIC_RELAXED);
+        if (i >= p->count) break;
+
+        long len = prefetch_file(p->paths[i]);
+        if (len < 0) {
+            __atomic_add_fetch(&p->missing, 1, __ATOMIC_RELAXED);
+        } else {
+            __atomic_add_fetch(&p->bytes, (unsigned long long)len, __ATOMIC_RELAXED);
+            __atomic_add_fetch(&p->done, 1, __ATOMIC_RELAXED);
+        }
+    }
+
+    /* the workers finish in any order, the last one out stamps the time */
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    pthread_mutex_lock(&stamp_lock);
+    if (ms_since(&p->finished, &now) > 0) p->finished = now;
+    pthread_mutex_unlock(&stamp_lock);
+    return NULL;
+}
+
+/*
+ * queues the mapped files of the first count windows of list, taken in order, on threads
+ * workers. returns NULL if there is nothing to prefetch or no thread could start
+ */
+Prefetch *start_prefetch(const WindowList *list, const int *order, int count, int threads) {
+    if (threads <= 0) return NULL;
+    if (threads > PREFETCH_MAX_THREADS) threads = PREFETCH_MAX_THREADS;
+
+    Prefetch *p = calloc(1, sizeof(Prefetch));
+    if (!p) return NULL;
+
+    if (collect_paths(p, list, order, count) != 0 || p->count == 0) {
+        free(p->paths);
+        free(p);
+        return NULL;
+    }
+    if (threads > p->count) threads = p->count;
+
+    clock_gettime(CLOCK_MONOTONIC, &p->started);
+    p->finished = p->started;
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&p->threads[p->thread_count], NULL, prefetch_main, p) != 0) break;
+        p->thread_count++;
+    }
+
+    if (p->thread_count == 0) {
+        free(p->paths);
+        free(p);
+        return NULL;
+    }
+    return p;
+}
+
+/* skips whatever hasn't been read ahead yet, waits for the workers and frees p */
+void finish_prefetch(Prefetch *p, PrefetchStats *stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+    if (!p) return;
+
+    __atomic_store_n(&p->stop, 1, __ATOMIC_RELAXED);
+    for (int i = 0; i < p->thread_count; i++) pthread_join(p->threads[i], NULL);
+
+    if (stats) {
+        stats->files = p->count;
+        stats->done = p->done;
+        stats->missing = p->missing;
+        stats->bytes = p->bytes;
+        stats->ms = ms_since(&p->started, &p->finished);
+    }
+    free(p->paths);
+    free(p);
+}
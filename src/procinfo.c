@@ -0,0 +1,571 @@
+/*
+ * procinfo.c — caches argv, exe path and mapped files of window-owning processes across captures
+ * talks to: procinfo.h, capture.c, matcher.c
+ * imports: fcntl/unistd for openat()/readlinkat() against a /proc dirfd held for the process lifetime,
+ * sys/epoll.h and pidfd_open() to learn about exits without polling /proc
+ * functions: proc_cache_begin(), proc_cache_lookup(), proc_foreground(), read_proc_cwd(), read_proc_stat(),
+ * reap_exited(), sweep_entries(), build_tree(), sort_tree(), read_maps()
+ *
+ * a long-lived process is read once, including its mapped files: by the time it owns a
+ * window its toolkit and libraries are loaded, so later plugins are all that's missed. each cached process holds a pidfd registered
+ * with one epoll set, so a capture pass only asks that set which processes exited
+ * and every other lookup is a hash hit with no syscall. where pidfds aren't
+ * available (old kernel, fd limit) an entry falls back to one /proc/<pid>/stat
+ * read per pass to confirm the starttime still matches.
+ *
+ * the process tree is not cached: a shell's foreground job changes without any
+ * event we could watch. the first proc_foreground() call of a pass reads every
+ * /proc/<pid>/stat once into a table sorted by parent, later calls in the same
+ * pass walk that table.
+ */
+
+#include "../include/procinfo.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+
+#define PROC_CACHE_BUCKETS 256
+/* entries idle for this many passes are re-checked, and dropped if the process is gone */
+#define PROC_SWEEP_INTERVAL 64
+
+typedef struct {
+    int pid;
+    unsigned long long starttime;
+    unsigned long validated;    /* pass in which the starttime was last confirmed */
+    int pidfd;                  /* readable once the process exits, -1 if we have none */
+    int next;                   /* next entry in the bucket chain, or in the free list */
+    ProcInfo info;
+    char *data;                 /* argv bytes, the exe path, then the mapped files, owned */
+} ProcEntry;
+
+static int proc_fd = -1;
+static int exit_fd = -1;        /* epoll set of every entry's pidfd */
+static ProcEntry *entries = NULL;
+static int entry_cap = 0;
+static int free_head = -1;
+static int buckets[PROC_CACHE_BUCKETS];
+static unsigned long generation = 0;
+static ProcCacheStats stats;
+
+typedef struct {
+    int pid;
+    int ppid;
+    int pgrp;
+    int tty;
+    int tpgid;
+} ProcNode;
+
+/* every process on the system as of tree_generation, sorted by ppid */
+static ProcNode *tree = NULL;
+static int tree_count = 0;
+static int tree_cap = 0;
+static unsigned long tree_generation = ~0UL;
+
+/* read buffer for cmdline and maps, reused across misses */
+static char *read_buf = NULL;
+static size_t read_cap = 0;
+
+static int open_proc(void) {
+    if (proc_fd >= 0) return 0;
+
+    proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (proc_fd < 0) return -1;
+    exit_fd = epoll_create1(EPOLL_CLOEXEC);
+
+    for (int i = 0; i < PROC_CACHE_BUCKETS; i++) buckets[i] = -1;
+    return 0;
+}
+
+/* reads a whole /proc/<pid>/<name> file into read_buf, returns its length or -1 */
+static ssize_t read_pid_file(int pid, const char *name) {
+    char path[64];
+    snprintf(path, sizeof(path), "%d/%s", pid, name);
+
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    size_t len = 0;
+    for (;;) {
+        if (len == read_cap) {
+            size_t n = read_cap ? read_cap * 2 : 4096;
+            char *grown = realloc(read_buf, n);
+            if (!grown) break;
+            read_buf = grown;
+            read_cap = n;
+        }
+        ssize_t r = read(fd, read_buf + len, read_cap - len);
+        if (r <= 0) break;
+        len += (size_t)r;
+    }
+
+    close(fd);
+    return (ssize_t)len;
+}
+
+static int parse_stat(int pid, ProcStat *out) {
+    char path[32];
+    snprintf(path, sizeof(path), "%d/stat", pid);
+    int fd = openat(proc_fd, path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+
+    char buf[1024];
+    ssize_t n = read(fd, buf, sizeof(buf) - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+
+    /* the command name can hold spaces and parens, fields resume after the last ')' */
+    char *p = strrchr(buf, ')');
+    if (!p) return -1;
+    p++;
+
+    for (int field = 3; field <= 22; field++) {
+        while (*p == ' ') p++;
+        if (!*p) return -1;
+        if (field == 4) out->ppid = (int)strtol(p, NULL, 10);
+        if (field == 5) out->pgrp = (int)strtol(p, NULL, 10);
+        if (field == 7) out->tty = (int)strtol(p, NULL, 10);
+        if (field == 8) out->tpgid = (int)strtol(p, NULL, 10);
+        if (field == 22) {
+            out->starttime = strtoull(p, NULL, 10);
+            return 0;
+        }
+        while (*p && *p != ' ') p++;
+    }
+    return -1;
+}
+
+/* parses ppid, pgrp, tty, tpgid and starttime (fields 4, 5, 7, 8 and 22) out of /proc/<pid>/stat */
+int read_proc_stat(int pid, ProcStat *out) {
+    if (open_proc() != 0) return -1;
+    stats.stat_reads++;
+    return parse_stat(pid, out);
+}
+
+static int find_entry(int pid) {
+    for (int i = buckets[(unsigned)pid % PROC_CACHE_BUCKETS]; i >= 0; i = entries[i].next) {
+        if (entries[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+static void evict_entry(int idx) {
+    int *link = &buckets[(unsigned)entries[idx].pid % PROC_CACHE_BUCKETS];
+    while (*link != idx) link = &entries[*link].next;
+    *link = entries[idx].next;
+
+    if (entries[idx].pidfd >= 0) close(entries[idx].pidfd);
+    free(entries[idx].data);
+    entries[idx].data = NULL;
+    entries[idx].pid = 0;
+    entries[idx].next = free_head;
+    free_head = idx;
+
+    stats.evictions++;
+    stats.entries--;
+}
+
+static int alloc_entry(void) {
+    if (free_head < 0) {
+        int cap = entry_cap ? entry_cap * 2 : 64;
+        ProcEntry *grown = realloc(entries, (size_t)cap * sizeof(ProcEntry));
+        if (!grown) return -1;
+        entries = grown;
+        for (int i = cap - 1; i >= entry_cap; i--) {
+            entries[i].pid = 0;
+            entries[i].data = NULL;
+            entries[i].next = free_head;
+            free_head = i;
+        }
+        entry_cap = cap;
+    }
+
+    int idx = free_head;
+    free_head = entries[idx].next;
+    return idx;
+}
+
+/*
+ * ties an entry to its process with a pidfd, then re-reads the starttime: if the pid
+ * was reused in between, the pidfd belongs to the new process and the entry is wrong
+ */
+static int watch_exit(ProcEntry *e, int idx) {
+    e->pidfd = -1;
+#ifdef SYS_pidfd_open
+    if (exit_fd < 0) return 0;
+
+    int fd = (int)syscall(SYS_pidfd_open, e->pid, 0);
+    if (fd < 0) return 0;
+
+    ProcStat st;
+    if (read_proc_stat(e->pid, &st) != 0 || st.starttime != e->starttime) {
+        close(fd);
+        return -1;
+    }
+
+    struct epoll_event ev = { .events = EPOLLIN, .data.u32 = (uint32_t)idx };
+    if (epoll_ctl(exit_fd, EPOLL_CTL_ADD, fd, &ev) != 0) {
+        close(fd);
+        return 0;
+    }
+    e->pidfd = fd;
+#else
+    (void)idx;
+#endif
+    return 0;
+}
+
+/* a mapping worth prefetching: a regular file that still exists, not a device or kernel file */
+static int is_file_mapping(const char *path, size_t len) {
+    static const char deleted[] = " (deleted)";
+    size_t n = sizeof(deleted) - 1;
+
+    if (len < 2 || path[0] != '/') return 0;
+    if (len > n && memcmp(path + len - n, deleted, n) == 0) return 0;
+    return strncmp(path, "/dev/", 5) != 0 && strncmp(path, "/proc/", 6) != 0 &&
+        strncmp(path, "/sys/", 5) != 0;
+}
+
+/*
+ * compacts /proc/<pid>/maps in read_buf down to its file paths, NUL-separated, and
+ * returns their length. a file's segments are adjacent, so comparing against the
+ * previous path drops the repeats
+ */
+static size_t read_maps(int pid) {
+    ssize_t len = read_pid_file(pid, "maps");
+    if (len <= 0) return 0;
+
+    size_t out = 0, prev = 0, prev_len = 0;
+    char *line = read_buf, *end = read_buf + len;
+
+    while (line < end) {
+        char *nl = memchr(line, '\n', (size_t)(end - line));
+        if (!nl) nl = end;
+
+        /* address perms offset dev inode, then the path padded with spaces */
+        char *p = line;
+        for (int field = 0; field < 5 && p < nl; field++) {
+            while (p < nl && *p != ' ') p++;
+            while (p < nl && *p == ' ') p++;
+        }
+        size_t path_len = (size_t)(nl - p);
+
+        if (is_file_mapping(p, path_len) &&
+            !(prev_len == path_len && memcmp(read_buf + prev, p, path_len) == 0)) {
+            /* the output never overtakes the line being read */
+            memmove(read_buf + out, p, path_len);
+            prev = out;
+            prev_len = path_len;
+            read_buf[out + path_len] = '\0';
+            out += path_len + 1;
+        }
+        line = nl + 1;
+    }
+    return out;
+}
+
+/* reads cmdline, exe and mapped files for a process the cache hasn't seen in this lifetime */
+static int fill_entry(int pid, const ProcStat *st) {
+    ssize_t argv_len = read_pid_file(pid, "cmdline");
+    if (argv_len < 0) return -1;
+
+    char exe[PATH_MAX];
+    char path[32];
+    snprintf(path, sizeof(path), "%d/exe", pid);
+    ssize_t exe_len = readlinkat(proc_fd, path, exe, sizeof(exe));
+    if (exe_len < 0) exe_len = 0;
+
+    size_t data_len = (size_t)argv_len + (size_t)exe_len + 1;
+    char *data = malloc(data_len);
+    int idx = data ? alloc_entry() : -1;
+    if (idx < 0) {
+        free(data);
+        return -1;
+    }
+
+    memcpy(data, read_buf, (size_t)argv_len);
+    memcpy(data + argv_len, exe, (size_t)exe_len);
+    data[argv_len + exe_len] = '\0';
+
+    /* read_buf is free again, maps goes through it too */
+    size_t maps_len = read_maps(pid);
+    char *grown = maps_len ? realloc(data, data_len + maps_len) : NULL;
+    if (grown) {
+        data = grown;
+        memcpy(data + data_len, read_buf, maps_len);
+    } else {
+        maps_len = 0;
+    }
+
+    ProcEntry *e = &entries[idx];
+    e->pid = pid;
+    e->starttime = st->starttime;
+    e->validated = generation;
+    e->data = data;
+    e->info.argv = data;
+    e->info.argv_len = (size_t)argv_len;
+    e->info.exe = data + argv_len;
+    e->info.exe_len = (size_t)exe_len;
+    e->info.maps = data + data_len;
+    e->info.maps_len = maps_len;
+
+    int *head = &buckets[(unsigned)pid % PROC_CACHE_BUCKETS];
+    e->next = *head;
+    *head = idx;
+    stats.entries++;
+
+    if (watch_exit(e, idx) != 0) {
+        evict_entry(idx);
+        return -1;
+    }
+    return idx;
+}
+
+/* re-checks entries nobody asked about for a while, so exited processes don't pile up */
+static void sweep_entries(void) {
+    for (int i = 0; i < entry_cap; i++) {
+        ProcEntry *e = &entries[i];
+        if (e->pid == 0 || e->pidfd >= 0 || generation - e->validated < PROC_SWEEP_INTERVAL) continue;
+
+        ProcStat st;
+        if (read_proc_stat(e->pid, &st) != 0 || st.starttime != e->starttime) evict_entry(i);
+        else e->validated = generation;
+    }
+}
+
+/* drops every entry whose pidfd reported an exit since the last pass */
+static void reap_exited(void) {
+    struct epoll_event events[64];
+    int n;
+
+    do {
+        n = epoll_wait(exit_fd, events, 64, 0);
+        for (int i = 0; i < n; i++) {
+            int idx = (int)events[i].data.u32;
+            if (idx < entry_cap && entries[idx].pid != 0) evict_entry(idx);
+        }
+    } while (n == 64);
+}
+
+/* starts a capture pass, entries confirmed during it are trusted until the next call */
+void proc_cache_begin(void) {
+    generation++;
+    if (exit_fd >= 0) reap_exited();
+    if (generation % PROC_SWEEP_INTERVAL == 0) sweep_entries();
+}
+
+/* returns argv and exe for pid, valid until the next lookup or pass, or NULL if the process is gone */
+const ProcInfo *proc_cache_lookup(int pid) {
+    if (pid <= 0 || open_proc() != 0) return NULL;
+
+    int idx = find_entry(pid);
+    if (idx >= 0 && (entries[idx].pidfd >= 0 || entries[idx].validated == generation)) {
+        stats.hits++;
+        return &entries[idx].info;
+    }
+
+    ProcStat st;
+    if (read_proc_stat(pid, &st) != 0) {
+        if (idx >= 0) evict_entry(idx);
+        return NULL;
+    }
+
+    if (idx >= 0) {
+        if (entries[idx].starttime == st.starttime) {
+            entries[idx].validated = generation;
+            stats.hits++;
+            return &entries[idx].info;
+        }
+        /* same pid, different process */
+        evict_entry(idx);
+    }
+
+    stats.misses++;
+    idx = fill_entry(pid, &st);
+    return idx >= 0 ? &entries[idx].info : NULL;
+}
+
+static int by_ppid(const ProcNode *x, const ProcNode *y) {
+    if (x->ppid != y->ppid) return x->ppid < y->ppid ? -1 : 1;
+    return (x->pid > y->pid) - (x->pid < y->pid);
+}
+
+static void sift_down(int root, int count) {
+    for (int child; (child = 2 * root + 1) < count; root = child) {
+        if (child + 1 < count && by_ppid(&tree[child], &tree[child + 1]) < 0) child++;
+        if (by_ppid(&tree[root], &tree[child]) >= 0) return;
+        ProcNode t = tree[root];
+        tree[root] = tree[child];
+        tree[child] = t;
+    }
+}
+
+/* heapsort by parent: glibc's qsort() may allocate a merge buffer, this runs every capture pass */
+static void sort_tree(void) {
+    for (int i = tree_count / 2 - 1; i >= 0; i--) sift_down(i, tree_count);
+    for (int end = tree_count - 1; end > 0; end--) {
+        ProcNode t = tree[0];
+        tree[0] = tree[end];
+        tree[end] = t;
+        sift_down(0, end);
+    }
+}
+
+/* the record getdents64 fills in, older glibc doesn't declare one */
+typedef struct {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} ProcDirent;
+
+static int add_node(int pid) {
+    ProcStat st;
+    if (parse_stat(pid, &st) != 0) return 0;
+
+    if (tree_count == tree_cap) {
+        int cap = tree_cap ? tree_cap * 2 : 512;
+        ProcNode *grown = realloc(tree, (size_t)cap * sizeof(ProcNode));
+        if (!grown) return -1;
+        tree = grown;
+        tree_cap = cap;
+    }
+    tree[tree_count++] = (ProcNode){ pid, st.ppid, st.pgrp, st.tty, st.tpgid };
+    return 0;
+}
+
+/*
+ * one pass over /proc into the tree table, returns -1 if /proc can't be listed.
+ * the directory is read with getdents64 into a static buffer, readdir() would
+ * allocate a DIR on every pass
+ */
+static int build_tree(void) {
+    static char buf[32768] __attribute__((aligned(8)));
+
+    int dir_fd = openat(proc_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return -1;
+
+    tree_count = 0;
+    long n;
+    int full = 0;
+    while (!full && (n = syscall(SYS_getdents64, dir_fd, buf, sizeof(buf))) > 0) {
+        for (long off = 0; off < n && !full; ) {
+            const ProcDirent *de = (const ProcDirent *)(buf + off);
+            off += de->d_reclen;
+            if (de->d_name[0] < '1' || de->d_name[0] > '9') continue;
+            full = add_node((int)strtol(de->d_name, NULL, 10)) != 0;
+        }
+    }
+    close(dir_fd);
+
+    sort_tree();
+    tree_generation = generation;
+    stats.tree_scans++;
+    return 0;
+}
+
+/* index of the first child of pid in the tree table, children are contiguous after it */
+static int first_child(int pid) {
+    int lo = 0, hi = tree_count;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (tree[mid].ppid < pid) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+/*
+ * the deepest descendant of pid that is in the foreground of its terminal: the
+ * command running in a terminal window, or its idle shell. ties go to the lowest
+ * pid, so a terminal with several tabs reports its first one. returns 0 if no
+ * descendant has a terminal, or if pid has one itself: that is an app started from
+ * a shell, and its helpers sit in its own foreground group.
+ */
+int proc_foreground(int pid) {
+    if (pid <= 0 || open_proc() != 0) return 0;
+    if (tree_generation != generation && build_tree() != 0) return 0;
+
+    /* the table is sorted by ppid, so finding pid itself is a scan */
+    for (int i = 0; i < tree_count; i++) {
+        if (tree[i].pid == pid) {
+            if (tree[i].tty != 0) return 0;
+            break;
+        }
+    }
+
+    int best = 0, best_depth = 0;
+
+    /* children of each level are found by binary search, the walk keeps its frontier on a small stack */
+    int stack[256][2];
+    int top = 0;
+    stack[top][0] = pid;
+    stack[top][1] = 0;
+    top++;
+
+    while (top > 0) {
+        top--;
+        int parent = stack[top][0], depth = stack[top][1];
+
+        for (int i = first_child(parent); i < tree_count && tree[i].ppid == parent; i++) {
+            const ProcNode *n = &tree[i];
+            if (n->tpgid > 0 && n->pgrp == n->tpgid &&
+                (depth + 1 > best_depth || (depth + 1 == best_depth && n->pid < best))) {
+                best = n->pid;
+                best_depth = depth + 1;
+            }
+            if (top < 256) {
+                stack[top][0] = n->pid;
+                stack[top][1] = depth + 1;
+                top++;
+            }
+        }
+    }
+    return best;
+}
+
+/* the target of /proc/<pid>/cwd, not cached since it changes with every cd */
+ssize_t read_proc_cwd(int pid, char *buf, size_t size) {
+    if (pid <= 0 || size == 0 || open_proc() != 0) return -1;
+
+    char path[32];
+    snprintf(path, sizeof(path), "%d/cwd", pid);
+    ssize_t n = readlinkat(proc_fd, path, buf, size - 1);
+    if (n < 0) return -1;
+    buf[n] = '\0';
+    return n;
+}
+
+void proc_cache_free(void) {
+    for (int i = 0; i < entry_cap; i++) {
+        if (entries[i].pid != 0 && entries[i].pidfd >= 0) close(entries[i].pidfd);
+        free(entries[i].data);
+    }
+    free(entries);
+    free(read_buf);
+    free(tree);
+    entries = NULL;
+    read_buf = NULL;
+    tree = NULL;
+    tree_count = tree_cap = 0;
+    tree_generation = ~0UL;
+    entry_cap = 0;
+    read_cap = 0;
+    free_head = -1;
+    stats.entries = 0;
+
+    if (exit_fd >= 0) close(exit_fd);
+    if (proc_fd >= 0) close(proc_fd);
+    exit_fd = proc_fd = -1;
+}
+
+void get_proc_cache_stats(ProcCacheStats *out) {
+    *out = stats;
+}
@@ -1,38 +1,130 @@
 /*
- * restore.c — reads session JSON and relaunches each app, then repositions its window
- * talks to: session.c (load_session), capture.h (WindowInfo), restore.h
- * imports: unistd.h (fork/execvp), X11 for window repositioning via wmctrl
- * functions: restore_session(), reposition_window(), wait_for_window()
+ * restore.c — reads a saved session, relaunches each app and places its window as soon as it maps
+ * talks to: session.c (load_session), matcher.c (assigns windows), scheduler.c (launch waves),
+ * planner.c (which windows share a process), prefetch.c (reads the session's files ahead of the launches),
+ * atoms.c, capture.h, restore.h
+ * imports: unistd.h (fork/execvp), sys/select.h to wait on the X connection, X11 for placement
+ * functions: restore_session(), restore_window_list(), reposition_window(), launch_app(), launch_wave(), wave_due(),
+ * place_window(), report_matches(), apply_control(), set_status(), release_desktop(), release_lazy(),
+ * join_group(), launch_extras()
+ *
+ * a process that had several windows is launched once, by whichever of its windows comes
+ * up first in launch order. its other windows join it and wait for its pid. the ones
+ * still missing PLAN_SETTLE_MS after its first window maps are asked for one at a time,
+ * as the group's hint says.
+ *
+ * with lazy_desktops set, only the current desktop's apps are admitted at first. the
+ * others stay at the end of the launch order until the user switches to their desktop
+ * (then they go next, at normal priority) or restore has sat idle for lazy_idle_ms
+ * (then one desktop at a time follows in background waves).
  */
 
 #include "../include/restore.h"
 #include "../include/session.h"
+#include "../include/atoms.h"
+#include "../include/matcher.h"
+#include "../include/scheduler.h"
+#include "../include/prefetch.h"
+#include "../include/planner.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/select.h>
 #include <X11/Xlib.h>
 #include <X11/Xatom.h>
 
-static Window find_window_by_title(Display *display, const char *title) {
-    Window root = DefaultRootWindow(display);
-    Atom net_client_list = XInternAtom(display, "_NET_CLIENT_LIST", True);
-    if (net_client_list == None) return None;
+/* a launch group as restore goes through it */
+typedef struct {
+    pid_t pid;
+    int started;
+    int placed;                 /* windows of the group placed so far */
+    int background;
+    struct timespec first_placed;
+} GroupState;
 
-    Atom actual_type;
-    int actual_format;
-    unsigned long nitems, bytes_after;
-    unsigned char *data = NULL;
+typedef struct {
+    Display *display;
+    const AtomTable *atoms;
+    const WindowList *list;
+    MatchIndex *index;
+    MatchTarget *targets;
+    struct timespec *deadlines;
+    int *assigned;
+    int target_count;
+    int waiting;            /* launched and neither placed nor timed out */
+    struct timespec started;
+
+    LaunchPolicy policy;
+    int *order;             /* target indices in launch order */
+    int foreground;         /* leading entries of order launched at normal priority */
+    int next_launch;        /* position in order of the next app to launch */
+    int admitted;           /* entries of order past this wait for their desktop (lazy restore) */
+    int *scratch;
+    int wave;
+    int wave_first;         /* position in order where the last wave started */
+    struct timespec last_wave;
+    int holding;            /* the next wave is being held back by system pressure */
+    struct timespec hold_since;
+    long held_ms;
+
+    RestoreControl *control;    /* NULL when nothing is watching, as on the command line */
+    int skipped;
+
+    int desktop_changed;        /* _NET_CURRENT_DESKTOP changed since the last look */
+    int idle;                   /* nothing launched is waiting and nothing admitted is left */
+    struct timespec idle_since;
+    int released_by_switch;
+    int released_by_idle;
+
+    LaunchPlan plan;
+    GroupState *groups;
+    unsigned char *launched;    /* per target: started or joined a running group */
+    unsigned char *extra;       /* per target: joined, still to be asked for its own window */
+    int processes;              /* apps actually started */
+    int joined;                 /* windows that waited for another window's process */
+    int extra_launches;         /* commands run to ask a running app for one more window */
+} RestoreState;
+
+/* windows can be destroyed between the event and our query, so BadWindow is routine here */
+static int ignore_x_errors(Display *d, XErrorEvent *e) {
+    (void)d;
+    (void)e;
+    return 0;
+}
 
-    if (XGetWindowProperty(display, root, net_client_list,
-        0, (~0L), False, XA_WINDOW,
-        &actual_type, &actual_format, &nitems, &bytes_after, &data) != Success) {
-        return None;
+static long ms_between(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) * 1000 + (to->tv_nsec - from->tv_nsec) / 1000000;
+}
+
+const char *restore_status_name(RestoreStatus status) {
+    switch (status) {
+    case RESTORE_WAITING: return "waiting";
+    case RESTORE_DEFERRED: return "deferred";
+    case RESTORE_LAUNCHING: return "launching";
+    case RESTORE_PLACED: return "placed";
+    case RESTORE_TIMED_OUT: return "timed out";
+    case RESTORE_SKIPPED: return "skipped";
     }
+    return "?";
+}
 
-    Window *windows = (Window *)data;
+static void set_status(RestoreState *st, int target, RestoreStatus status) {
+    if (st->control && st->control->progress) st->control->progress(st->control->data, target, status);
+}
+
+static int skip_requested(const RestoreState *st, int target) {
+    return st->control && st->control->skip &&
+        __atomic_load_n(&st->control->skip[target], __ATOMIC_RELAXED);
+}
+
+static Window find_window_by_title(Display *display, const char *title) {
+    unsigned long nitems;
+    Window *windows = get_client_list(display, &nitems);
     Window found = None;
 
     for (unsigned long i = 0; i < nitems; i++) {
@@ -46,20 +138,10 @@ static Window find_window_by_title(Display *display, const char *title) {
         if (name) XFree(name);
     }
 
-    XFree(data);
+    if (windows) XFree(windows);
     return found;
 }
 
-static Window wait_for_window(Display *display, const char *title, int timeout_sec) {
-    for (int i = 0; i < timeout_sec * 2; i++) {
-        usleep(500000);
-        XSync(display, False);
-        Window w = find_window_by_title(display, title);
-        if (w != None) return w;
-    }
-    return None;
-}
-
 int reposition_window(Display *display, const char *title, int x, int y, int w, int h) {
     Window win = find_window_by_title(display, title);
     if (win == None) return -1;
@@ -69,28 +151,516 @@ int reposition_window(Display *display, const char *title, int x, int y, int w,
     return 0;
 }
 
-static void launch_app(const WindowInfo *info) {
-    if (info->cmd_argc == 0) return;
+/*
+ * extra_arg is appended to the saved argv, or NULL. background is the policy to apply in
+ * the child, or NULL to launch at normal priority
+ */
+static pid_t launch_app(const WindowList *list, const WindowInfo *info, const char *extra_arg,
+                        const LaunchPolicy *background) {
+    if (info->cmd_argc == 0) return 0;
+
+    char **args = malloc((size_t)(info->cmd_argc + 2) * sizeof(char *));
+    if (!args) return 0;
+    int argc = 0;
+    for (int i = 0; i < info->cmd_argc; i++) {
+        args[argc++] = (char *)window_arg(list, info, i);
+    }
+    if (extra_arg) args[argc++] = (char *)extra_arg;
+    args[argc] = NULL;
+    const char *cwd = window_cwd(list, info);
 
     pid_t pid = fork();
     if (pid == 0) {
-        char *args[MAX_CMD_ARGS + 1];
-        for (int i = 0; i < info->cmd_argc; i++) {
-            args[i] = (char *)info->cmd[i];
-        }
-        args[info->cmd_argc] = NULL;
-
         setsid();
+        if (background) apply_background_priority(background);
+        /*
+         * terminals open their shell here; a directory that's gone just leaves ours. the
+         * child holds copies of the caller's stdio buffers and atexit handlers, GTK's under
+         * --gui, so it writes straight to fd 2 and leaves with _exit
+         */
+        if (cwd[0] && chdir(cwd) != 0) dprintf(2, "sessionsnap: %s no longer exists\n", cwd);
         execvp(args[0], args);
-        fprintf(stderr, "sessionsnap: failed to exec %s\n", args[0]);
-        exit(1);
+        dprintf(2, "sessionsnap: failed to exec %s\n", args[0]);
+        _exit(127);
+    }
+
+    free(args);
+    return pid > 0 ? pid : 0;
+}
+
+static void place_window(RestoreState *st, Window win, const WindowInfo *w) {
+    Display *display = st->display;
+
+    if (w->is_maximized) {
+        XEvent ev = {0};
+        ev.type = ClientMessage;
+        ev.xclient.window = win;
+        ev.xclient.message_type = st->atoms->net_wm_state;
+        ev.xclient.format = 32;
+        ev.xclient.data.l[0] = 1;
+        ev.xclient.data.l[1] = (long)st->atoms->net_wm_state_maximized_vert;
+        ev.xclient.data.l[2] = (long)st->atoms->net_wm_state_maximized_horz;
+
+        XSendEvent(display, DefaultRootWindow(display), False,
+            SubstructureNotifyMask | SubstructureRedirectMask, &ev);
+    } else {
+        XMoveResizeWindow(display, win, w->x, w->y,
+            (unsigned int)w->width, (unsigned int)w->height);
+    }
+
+    XFlush(display);
+}
+
+/* lets the index assign whatever changed since the last call and places each new match */
+static void place_matches(RestoreState *st) {
+    int n = assign_matches(st->index, st->targets, st->target_count, st->assigned);
+    if (n == 0) return;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    for (int i = 0; i < n; i++) {
+        const MatchTarget *t = &st->targets[st->assigned[i]];
+        printf("  placed: %s (by %s, %.1f s)\n", window_title(st->list, t->saved),
+            match_kind_name(t->kind), ms_between(&st->started, &now) / 1000.0);
+        place_window(st, t->window, t->saved);
+        set_status(st, st->assigned[i], RESTORE_PLACED);
+
+        GroupState *g = &st->groups[st->plan.group_of[st->assigned[i]]];
+        if (g->placed++ == 0) g->first_placed = now;
+    }
+    st->waiting -= n;
+}
+
+static int read_current_desktop(RestoreState *st) {
+    Atom actual_type;
+    int actual_format;
+    unsigned long nitems, bytes_after;
+    unsigned char *data = NULL;
+    int desktop = -1;
+
+    if (XGetWindowProperty(st->display, DefaultRootWindow(st->display),
+        st->atoms->net_current_desktop, 0, 1, False, XA_CARDINAL,
+        &actual_type, &actual_format, &nitems, &bytes_after, &data) == Success && data) {
+        if (nitems == 1 && actual_format == 32) desktop = (int)*(unsigned long *)data;
+        XFree(data);
     }
+    return desktop;
+}
+
+static void handle_event(RestoreState *st, const XEvent *ev) {
+    switch (ev->type) {
+    case PropertyNotify:
+        if (ev->xproperty.window == DefaultRootWindow(st->display)) {
+            if (ev->xproperty.atom == st->atoms->net_client_list) index_client_list(st->index);
+            else if (ev->xproperty.atom == st->atoms->net_current_desktop) st->desktop_changed = 1;
+        } else if (ev->xproperty.atom == XA_WM_NAME ||
+                   ev->xproperty.atom == st->atoms->net_wm_name ||
+                   ev->xproperty.atom == XA_WM_CLASS) {
+            index_mark_dirty(st->index, ev->xproperty.window);
+        }
+        break;
+    case MapNotify:
+        /* without a reparenting WM this is the client itself, ahead of _NET_CLIENT_LIST */
+        index_mark_dirty(st->index, ev->xmap.window);
+        break;
+    default:
+        break;
+    }
+}
+
+/* gives up on saved windows whose deadline passed, returns ms until the nearest remaining one */
+static long expire_targets(RestoreState *st) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long next = -1;
+
+    for (int i = 0; i < st->target_count; i++) {
+        MatchTarget *t = &st->targets[i];
+        if (!t->waiting) continue;
+
+        long left = ms_between(&now, &st->deadlines[i]);
+        if (left <= 0) {
+            printf("  warning: could not find window for '%s'\n", window_title(st->list, t->saved));
+            t->waiting = 0;
+            st->waiting--;
+            set_status(st, i, RESTORE_TIMED_OUT);
+        } else if (next < 0 || left < next) {
+            next = left;
+        }
+    }
+    return next;
+}
+
+static void set_deadline(struct timespec *deadline) {
+    clock_gettime(CLOCK_MONOTONIC, deadline);
+    deadline->tv_sec += RESTORE_WINDOW_TIMEOUT_MS / 1000;
+    deadline->tv_nsec += (RESTORE_WINDOW_TIMEOUT_MS % 1000) * 1000000L;
+    if (deadline->tv_nsec >= 1000000000L) {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000L;
+    }
+}
+
+static int is_admitted(const RestoreState *st, int target) {
+    for (int i = st->admitted; i < st->target_count; i++) {
+        if (st->order[i] == target) return 0;
+    }
+    return 1;
+}
+
+/* target's app is already running: wait for its pid, and ask it for the window later if need be */
+static void join_group(RestoreState *st, int target) {
+    MatchTarget *t = &st->targets[target];
+    int gi = st->plan.group_of[target];
+
+    t->launched_pid = st->groups[gi].pid;
+    t->waiting = 1;
+    st->launched[target] = 1;
+    st->extra[target] = st->plan.groups[gi].mode != EXTRA_SELF;
+    set_deadline(&st->deadlines[target]);
+    st->waiting++;
+    st->joined++;
+    set_status(st, target, RESTORE_LAUNCHING);
+}
+
+/*
+ * asks running apps for the windows they didn't bring back by themselves once they've
+ * had PLAN_SETTLE_MS since their first one. returns ms until the next one is due, -1 if none
+ */
+static long launch_extras(RestoreState *st) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    long next = -1;
+
+    for (int i = 0; i < st->target_count; i++) {
+        if (!st->extra[i] || !st->targets[i].waiting) continue;
+
+        const LaunchGroup *group = &st->plan.groups[st->plan.group_of[i]];
+        const GroupState *g = &st->groups[st->plan.group_of[i]];
+        if (g->placed == 0) continue;
+
+        long left = PLAN_SETTLE_MS - ms_between(&g->first_placed, &now);
+        if (left > 0) {
+            if (next < 0 || left < next) next = left;
+            continue;
+        }
+
+        const WindowInfo *w = st->targets[i].saved;
+        printf("  new window: %s%s%s\n", window_arg(st->list, w, 0), group->flag ? " " : "",
+            group->flag ? group->flag : "");
+        launch_app(st->list, w, group->flag, g->background ? &st->policy : NULL);
+        st->extra[i] = 0;
+        st->extra_launches++;
+        set_deadline(&st->deadlines[i]);
+    }
+    return next;
+}
+
+/* launches the next wave_size apps, never mixing current-desktop apps with background ones */
+static void launch_wave(RestoreState *st) {
+    int first = st->next_launch;
+    int end = first + st->policy.wave_size;
+    if (end > st->admitted) end = st->admitted;
+    if (first < st->foreground && end > st->foreground) end = st->foreground;
+
+    /* the first wave always runs at normal priority, even if nothing is on the current desktop */
+    const LaunchPolicy *background = st->wave > 0 && first >= st->foreground ? &st->policy : NULL;
+    printf("  wave %d: %d app%s%s\n", st->wave + 1, end - first, end - first == 1 ? "" : "s",
+        background ? " (background)" : "");
+
+    for (int i = first; i < end; i++) {
+        int idx = st->order[i];
+        MatchTarget *t = &st->targets[idx];
+        if (st->launched[idx]) continue;
+        if (skip_requested(st, idx)) {
+            printf("  skipped: %s\n", window_arg(st->list, t->saved, 0));
+            set_status(st, idx, RESTORE_SKIPPED);
+            st->skipped++;
+            continue;
+        }
+
+        int gi = st->plan.group_of[idx];
+        const LaunchGroup *group = &st->plan.groups[gi];
+        GroupState *g = &st->groups[gi];
+        if (g->started) {
+            join_group(st, idx);
+            continue;
+        }
+
+        if (group->count > 1) {
+            printf("  launching: %s (%d windows)\n", window_arg(st->list, t->saved, 0), group->count);
+        } else {
+            printf("  launching: %s\n", window_arg(st->list, t->saved, 0));
+        }
+
+        /* each app gets its own deadline from its launch, all of them run down together */
+        g->pid = launch_app(st->list, t->saved, NULL, background);
+        g->started = 1;
+        g->background = background != NULL;
+        if (g->pid > 0) st->processes++;
+
+        t->launched_pid = g->pid;
+        t->waiting = 1;
+        st->launched[idx] = 1;
+        set_deadline(&st->deadlines[idx]);
+        st->waiting++;
+        set_status(st, idx, RESTORE_LAUNCHING);
+
+        /* its other windows wait for it now, unless they're waiting for their desktop and
+           this app would have to be asked for them */
+        for (int m = 0; m < group->count; m++) {
+            int other = st->plan.members[group->first + m];
+            if (other == idx || st->launched[other] || skip_requested(st, other)) continue;
+            if (group->mode != EXTRA_SELF && !is_admitted(st, other)) continue;
+            join_group(st, other);
+        }
+    }
+
+    st->wave_first = first;
+    st->next_launch = end;
+    st->wave++;
+    clock_gettime(CLOCK_MONOTONIC, &st->last_wave);
+}
+
+static int last_wave_settled(const RestoreState *st) {
+    for (int i = st->wave_first; i < st->next_launch; i++) {
+        if (st->targets[st->order[i]].waiting) return 0;
+    }
+    return 1;
+}
+
+/*
+ * the next wave starts once the last one is placed or wave_gap_ms has passed, and only
+ * while memory and pressure are within policy. a wave held for max_hold_ms goes anyway,
+ * so a permanently busy machine still gets its session back.
+ */
+static int wave_due(RestoreState *st) {
+    if (st->wave == 0) return 1;
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (!last_wave_settled(st) && ms_between(&st->last_wave, &now) < st->policy.wave_gap_ms) return 0;
+
+    char reason[128];
+    if (check_pressure(&st->policy, reason, sizeof(reason)) == 0) {
+        if (st->holding) st->held_ms += ms_between(&st->hold_since, &now);
+        st->holding = 0;
+        return 1;
+    }
+
+    if (!st->holding) {
+        st->holding = 1;
+        st->hold_since = now;
+        printf("  holding wave %d: %s\n", st->wave + 1, reason);
+        return 0;
+    }
+
+    long held = ms_between(&st->hold_since, &now);
+    if (held < st->policy.max_hold_ms) return 0;
+
+    printf("  starting wave %d anyway after %.1f s: %s\n", st->wave + 1, held / 1000.0, reason);
+    st->held_ms += held;
+    st->holding = 0;
+    return 1;
+}
+
+/*
+ * stops waiting for windows skipped since the last pass. on cancel, stops waiting for
+ * all of them and drops the apps not launched yet. the launched ones keep running
+ */
+static void apply_control(RestoreState *st) {
+    if (!st->control) return;
+    int cancel = __atomic_load_n(&st->control->cancel, __ATOMIC_RELAXED);
+
+    for (int i = 0; i < st->target_count; i++) {
+        MatchTarget *t = &st->targets[i];
+        if (!t->waiting || (!cancel && !skip_requested(st, i))) continue;
+
+        t->waiting = 0;
+        st->waiting--;
+        st->skipped++;
+        set_status(st, i, RESTORE_SKIPPED);
+    }
+
+    if (!cancel || st->next_launch >= st->target_count) return;
+    st->admitted = st->target_count;
+    printf("  cancelled, %d app%s not launched\n", st->target_count - st->next_launch,
+        st->target_count - st->next_launch == 1 ? "" : "s");
+    for (int i = st->next_launch; i < st->target_count; i++) {
+        if (st->launched[st->order[i]]) continue;
+        set_status(st, st->order[i], RESTORE_SKIPPED);
+        st->skipped++;
+    }
+    st->next_launch = st->target_count;
+}
+
+/*
+ * moves the deferred windows of desktop to position at in order, ahead of whatever was
+ * admitted but not launched yet after it, and admits them. returns how many moved
+ */
+static int release_desktop(RestoreState *st, int desktop, int at) {
+    int k = 0;
+    int tail = st->target_count;
+    for (int i = st->target_count - 1; i >= st->admitted; i--) {
+        int idx = st->order[i];
+        if (st->list->windows[idx].desktop == desktop) st->scratch[k++] = idx;
+        else st->order[--tail] = idx;
+    }
+    if (k == 0) return 0;
+
+    memmove(&st->order[at + k], &st->order[at], (size_t)(st->admitted - at) * sizeof(int));
+    for (int i = 0; i < k; i++) {
+        st->order[at + i] = st->scratch[k - 1 - i];
+        if (!st->launched[st->order[at + i]]) set_status(st, st->order[at + i], RESTORE_WAITING);
+    }
+    st->admitted += k;
+    return k;
+}
+
+/*
+ * admits deferred desktops: the one the user just switched to goes next at normal
+ * priority, otherwise the next one in saved order once restore sat idle long enough.
+ * returns ms until the idle timer fires, -1 if it isn't running
+ */
+static long release_lazy(RestoreState *st) {
+    if (st->admitted >= st->target_count) return -1;
+
+    if (st->desktop_changed) {
+        st->desktop_changed = 0;
+        int desktop = read_current_desktop(st);
+        int at = st->next_launch > st->foreground ? st->next_launch : st->foreground;
+        int k = desktop >= 0 ? release_desktop(st, desktop, at) : 0;
+        if (k > 0) {
+            printf("  switched to desktop %d: %d app%s released\n", desktop + 1, k, k == 1 ? "" : "s");
+            st->foreground = at + k;
+            st->released_by_switch += k;
+        }
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if (st->waiting > 0 || st->next_launch < st->admitted) {
+        st->idle = 0;
+        return -1;
+    }
+    if (!st->idle) {
+        st->idle = 1;
+        st->idle_since = now;
+    }
+    if (st->policy.lazy_idle_ms <= 0) return -1;
+
+    long left = st->policy.lazy_idle_ms - ms_between(&st->idle_since, &now);
+    if (left > 0) return left;
+
+    int desktop = st->list->windows[st->order[st->admitted]].desktop;
+    int k = release_desktop(st, desktop, st->admitted);
+    printf("  idle for %.0f s: %d app%s of desktop %d released\n", st->policy.lazy_idle_ms / 1000.0,
+        k, k == 1 ? "" : "s", desktop + 1);
+    st->released_by_idle += k;
+    st->idle = 0;
+    return -1;
+}
+
+/* launches waves as the policy admits them and places windows as they map, until all are done */
+static void run_restore(RestoreState *st) {
+    int fd = ConnectionNumber(st->display);
+    index_client_list(st->index);
+
+    while (st->waiting > 0 || st->next_launch < st->target_count) {
+        apply_control(st);
+
+        while (XPending(st->display)) {
+            XEvent ev;
+            XNextEvent(st->display, &ev);
+            handle_event(st, &ev);
+        }
+
+        place_matches(st);
+        long idle_ms = release_lazy(st);
+
+        if (st->next_launch < st->admitted && wave_due(st)) launch_wave(st);
+
+        long extra_ms = launch_extras(st);
+        long wait_ms = expire_targets(st);
+        if (idle_ms >= 0 && (wait_ms < 0 || idle_ms < wait_ms)) wait_ms = idle_ms;
+        if (extra_ms >= 0 && (wait_ms < 0 || extra_ms < wait_ms)) wait_ms = extra_ms;
+
+        /* deferred desktops wait for an X event, or the idle timer, however long that takes */
+        int deferred = st->admitted < st->target_count;
+        int polling = st->next_launch < st->admitted || (st->control && (wait_ms >= 0 || deferred));
+        if (polling && (wait_ms < 0 || wait_ms > SCHEDULER_POLL_MS)) {
+            wait_ms = SCHEDULER_POLL_MS;
+        }
+        if (wait_ms < 0 && !deferred) break;
+
+        fd_set fds;
+        FD_ZERO(&fds);
+        FD_SET(fd, &fds);
+
+        struct timeval timeout = { wait_ms / 1000, (wait_ms % 1000) * 1000 };
+        if (select(fd + 1, &fds, NULL, NULL, wait_ms < 0 ? NULL : &timeout) < 0 && errno != EINTR) break;
+    }
+}
+
+/* how restore went: which evidence tied windows to their saved entries, and what matching cost */
+static void report_matches(RestoreState *st, const struct timespec *done, const PrefetchStats *ps) {
+    MatchStats ms;
+    get_match_stats(st->index, &ms);
+
+    int placed = 0;
+    for (int k = MATCH_PID; k < MATCH_KINDS; k++) placed += (int)ms.by_kind[k];
+
+    printf("sessionsnap: restore complete, placed %d of %d windows in %.1f s "
+        "(%lu by pid, %lu by class, %lu by exe, %lu by title, %d not found, %d skipped)\n",
+        placed, st->target_count, ms_between(&st->started, done) / 1000.0,
+        ms.by_kind[MATCH_PID], ms.by_kind[MATCH_CLASS], ms.by_kind[MATCH_EXE],
+        ms.by_kind[MATCH_TITLE], st->target_count - placed - st->skipped, st->skipped);
+    printf("sessionsnap: launched in %d waves, %.1f s held back by system pressure\n",
+        st->wave, st->held_ms / 1000.0);
+    int launched = 0;
+    for (int i = 0; i < st->target_count; i++) launched += st->launched[i];
+    printf("sessionsnap: started %d process%s for %d windows, %d waited for another window's "
+        "process, %d asked a running app for a new window\n", st->processes,
+        st->processes == 1 ? "" : "es", launched, st->joined, st->extra_launches);
+    if (st->policy.lazy_desktops) {
+        printf("sessionsnap: lazy restore released %d app%s on desktop switches, %d after idling\n",
+            st->released_by_switch, st->released_by_switch == 1 ? "" : "s", st->released_by_idle);
+    }
+    printf("sessionsnap: matching took %.2f ms: %lu query batches, %lu windows queried, "
+        "%lu pairs scored\n", ms.total_ms, ms.refreshes, ms.windows_queried, ms.pairs_scored);
+    if (ps->files > 0) {
+        printf("sessionsnap: prefetched %d of %d files (%.1f MB) in %.1f ms, %d missing\n",
+            ps->done, ps->files, (double)ps->bytes / (1024.0 * 1024.0), ps->ms, ps->missing);
+    }
+}
+
+static void free_restore_state(RestoreState *st) {
+    free_match_index(st->index);
+    free(st->targets);
+    free(st->deadlines);
+    free(st->assigned);
+    free(st->order);
+    free(st->scratch);
+    free(st->groups);
+    free(st->launched);
+    free(st->extra);
+    free_launch_plan(&st->plan);
 }
 
 int restore_session(const char *profile_name) {
     WindowList *list = load_session(profile_name);
     if (!list) return -1;
+    return restore_window_list(list, profile_name, NULL);
+}
 
+/*
+ * relaunches and places list, which is consumed; profile_name only picks the launch policy.
+ * control may be NULL, its window indices are positions in list. with a control we run on
+ * a thread of the GUI, whose GDK error handler is process-wide and already ignores errors
+ * on displays it didn't open, so it is left in place
+ */
+int restore_window_list(WindowList *list, const char *profile_name, RestoreControl *control) {
     if (list->count == 0) {
         printf("sessionsnap: no windows in saved session\n");
         free_window_list(list);
@@ -104,61 +674,73 @@ int restore_session(const char *profile_name) {
         return -1;
     }
 
-    printf("sessionsnap: restoring %d windows...\n", list->count);
+    XErrorHandler old_handler = control ? NULL : XSetErrorHandler(ignore_x_errors);
 
-    for (int i = 0; i < list->count; i++) {
-        const WindowInfo *w = &list->windows[i];
-        printf("  launching: %s\n", w->cmd[0]);
-        launch_app(w);
-        usleep(300000);
-    }
+    /* subscribe before launching anything, so no window can map between a launch and the select */
+    XSelectInput(display, DefaultRootWindow(display), PropertyChangeMask | SubstructureNotifyMask);
 
-    printf("sessionsnap: waiting for windows to open...\n");
-    sleep(2);
+    RestoreState st = {0};
+    st.display = display;
+    st.list = list;
+    st.atoms = get_atoms(display);
+    st.index = new_match_index(display, list);
+    st.targets = calloc((size_t)list->count, sizeof(MatchTarget));
+    st.deadlines = calloc((size_t)list->count, sizeof(struct timespec));
+    st.assigned = calloc((size_t)list->count, sizeof(int));
+    st.order = calloc((size_t)list->count, sizeof(int));
+    st.scratch = calloc((size_t)list->count, sizeof(int));
+    st.groups = calloc((size_t)list->count, sizeof(GroupState));
+    st.launched = calloc((size_t)list->count, 1);
+    st.extra = calloc((size_t)list->count, 1);
+    st.control = control;
+    if (!st.atoms || !st.index || !st.targets || !st.deadlines || !st.assigned || !st.order || !st.scratch ||
+        !st.groups || !st.launched || !st.extra || build_launch_plan(list, &st.plan) != 0) {
+        fprintf(stderr, "sessionsnap: out of memory\n");
+        free_restore_state(&st);
+        if (!control) XSetErrorHandler(old_handler);
+        release_atoms(display);
+        XCloseDisplay(display);
+        free_window_list(list);
+        return -1;
+    }
 
-    for (int i = 0; i < list->count; i++) {
-        const WindowInfo *w = &list->windows[i];
-        if (strlen(w->title) == 0) continue;
+    /* a target only starts waiting once its app is launched */
+    for (int i = 0; i < list->count; i++) st.targets[i].saved = &list->windows[i];
+    st.target_count = list->count;
 
-        printf("  repositioning: %s\n", w->title);
+    load_launch_policy(profile_name, &st.policy);
+    int current_desktop = read_current_desktop(&st);
+    st.foreground = plan_launch_order(list, current_desktop, st.order);
 
-        char short_title[64];
-        strncpy(short_title, w->title, sizeof(short_title) - 1);
-        short_title[sizeof(short_title) - 1] = '\0';
+    /* without a current desktop there's no switch to wait for */
+    if (current_desktop < 0) st.policy.lazy_desktops = 0;
+    st.admitted = st.policy.lazy_desktops ? st.foreground : list->count;
+    for (int i = st.admitted; i < list->count; i++) set_status(&st, st.order[i], RESTORE_DEFERRED);
 
-        Window win = wait_for_window(display, short_title, 5);
-        if (win == None) {
-            printf("  warning: could not find window for '%s'\n", short_title);
-            continue;
-        }
+    printf("sessionsnap: restoring %d windows of %d apps, %d on the current desktop...\n",
+        list->count, st.plan.group_count, st.foreground);
+    if (st.admitted < list->count) {
+        printf("sessionsnap: lazy restore, the other %d wait until their desktop is visited\n",
+            list->count - st.admitted);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &st.started);
 
-        if (w->is_maximized) {
-            Atom net_wm_state = XInternAtom(display, "_NET_WM_STATE", False);
-            Atom max_vert = XInternAtom(display, "_NET_WM_STATE_MAXIMIZED_VERT", False);
-            Atom max_horz = XInternAtom(display, "_NET_WM_STATE_MAXIMIZED_HORZ", False);
-
-            XEvent ev = {0};
-            ev.type = ClientMessage;
-            ev.xclient.window = win;
-            ev.xclient.message_type = net_wm_state;
-            ev.xclient.format = 32;
-            ev.xclient.data.l[0] = 1;
-            ev.xclient.data.l[1] = (long)max_vert;
-            ev.xclient.data.l[2] = (long)max_horz;
-
-            XSendEvent(display, DefaultRootWindow(display), False,
-                SubstructureNotifyMask | SubstructureRedirectMask, &ev);
-        } else {
-            XMoveResizeWindow(display, win, w->x, w->y,
-                (unsigned int)w->width, (unsigned int)w->height);
-        }
+    /* runs alongside the launches, ahead of them for as long as the disk keeps up.
+       a lazy restore only reads ahead what it launches now */
+    Prefetch *prefetch = start_prefetch(list, st.order, st.admitted, st.policy.prefetch_threads);
+    run_restore(&st);
 
-        XFlush(display);
-    }
+    struct timespec done;
+    clock_gettime(CLOCK_MONOTONIC, &done);
+    PrefetchStats ps;
+    finish_prefetch(prefetch, &ps);
+    report_matches(&st, &done, &ps);
 
+    XSync(display, False);
+    if (!control) XSetErrorHandler(old_handler);
+    free_restore_state(&st);
+    release_atoms(display);
     XCloseDisplay(display);
     free_window_list(list);
-
-    printf("sessionsnap: restore complete\n");
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,204 @@
+/*
+ * scheduler.c — decides the order restored apps launch in and when the next wave may start
+ * talks to: scheduler.h, session.c (get_session_policy_path), keyfile.c (reads the policy files), restore.c
+ * imports: stdio for /proc/pressure, /proc/meminfo, /proc/loadavg and policy files,
+ * sys/resource.h and the ioprio_set syscall for background waves
+ * functions: load_launch_policy(), plan_launch_order(), check_pressure(), apply_background_priority()
+ *
+ * policy files hold "key = value" lines, '#' starts a comment. ~/.sessionsnap/session.policy
+ * applies to every profile, ~/.sessionsnap/sessions/<name>.policy then overrides it for one:
+ *
+ *   wave_size = 3
+ *   min_mem_available_mb = 1024
+ *   max_memory_pressure = 10
+ *   background_ionice = idle
+ */
+
+#include "../include/scheduler.h"
+#include "../include/session.h"
+#include "../include/keyfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+#define IOPRIO_WHO_PROCESS 1
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_IDLE 3
+
+static const LaunchPolicy default_policy = {
+    .wave_size = 3,
+    .wave_gap_ms = 500,
+    .max_hold_ms = 8000,
+    .min_mem_available_mb = 512,
+    .max_cpu_pressure = 50.0,
+    .max_memory_pressure = 10.0,
+    .max_io_pressure = 40.0,
+    .max_load_per_cpu = 1.5,
+    .background_nice = 10,
+    .background_ionice = IOPRIO_CLASS_IDLE,
+    .prefetch_threads = 4,
+    .lazy_desktops = 0,
+    .lazy_idle_ms = 60000,
+};
+
+static int parse_ionice(const char *value) {
+    if (strcmp(value, "idle") == 0) return IOPRIO_CLASS_IDLE;
+    if (strcmp(value, "best-effort") == 0) return IOPRIO_CLASS_BE;
+    if (strcmp(value, "none") == 0) return 0;
+    return -1;
+}
+
+static int set_policy_key(void *data, const char *key, const char *value) {
+    LaunchPolicy *p = data;
+    if (strcmp(key, "background_ionice") == 0) {
+        int cls = parse_ionice(value);
+        if (cls < 0) return -1;
+        p->background_ionice = cls;
+        return 0;
+    }
+
+    char *end;
+    double v = strtod(value, &end);
+    if (end == value || *end != '\0') return -1;
+
+    if (strcmp(key, "wave_size") == 0) p->wave_size = v < 1 ? 1 : (int)v;
+    else if (strcmp(key, "wave_gap_ms") == 0) p->wave_gap_ms = (int)v;
+    else if (strcmp(key, "max_hold_ms") == 0) p->max_hold_ms = (int)v;
+    else if (strcmp(key, "min_mem_available_mb") == 0) p->min_mem_available_mb = (int)v;
+    else if (strcmp(key, "max_cpu_pressure") == 0) p->max_cpu_pressure = v;
+    else if (strcmp(key, "max_memory_pressure") == 0) p->max_memory_pressure = v;
+    else if (strcmp(key, "max_io_pressure") == 0) p->max_io_pressure = v;
+    else if (strcmp(key, "max_load_per_cpu") == 0) p->max_load_per_cpu = v;
+    else if (strcmp(key, "background_nice") == 0) p->background_nice = (int)v;
+    else if (strcmp(key, "prefetch_threads") == 0) p->prefetch_threads = v < 0 ? 0 : (int)v;
+    else if (strcmp(key, "lazy_desktops") == 0) p->lazy_desktops = v != 0;
+    else if (strcmp(key, "lazy_idle_ms") == 0) p->lazy_idle_ms = v < 0 ? 0 : (int)v;
+    else return -1;
+    return 0;
+}
+
+void load_launch_policy(const char *profile_name, LaunchPolicy *policy) {
+    *policy = default_policy;
+
+    char path[512];
+    get_session_policy_path(path, sizeof(path), "default");
+    read_key_file(path, '=', "key = value", set_policy_key, policy);
+
+    if (profile_name && strcmp(profile_name, "default") != 0) {
+        get_session_policy_path(path, sizeof(path), profile_name);
+        read_key_file(path, '=', "key = value", set_policy_key, policy);
+    }
+}
+
+/*
+ * fills order with list indices: windows on the current desktop (or sticky ones) first,
+ * then the rest, each group in saved order. returns how many are on the current desktop.
+ */
+int plan_launch_order(const WindowList *list, int current_desktop, int *order) {
+    int n = 0;
+    for (int i = 0; i < list->count; i++) {
+        int d = list->windows[i].desktop;
+        if (current_desktop >= 0 && (d == current_desktop || d < 0)) order[n++] = i;
+    }
+
+    int foreground = n;
+    for (int i = 0; i < list->count; i++) {
+        int d = list->windows[i].desktop;
+        if (!(current_desktop >= 0 && (d == current_desktop || d < 0))) order[n++] = i;
+    }
+    return foreground;
+}
+
+/* "some avg10" from a PSI file, -1 if the kernel doesn't expose it */
+static double read_psi(const char *resource) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/pressure/%s", resource);
+
+    FILE *f = fopen(path, "r");
+    if (!f) return -1.0;
+
+    double avg10 = -1.0;
+    if (fscanf(f, "some avg10=%lf", &avg10) != 1) avg10 = -1.0;
+    fclose(f);
+    return avg10;
+}
+
+static long read_mem_available_mb(void) {
+    FILE *f = fopen("/proc/meminfo", "r");
+    if (!f) return -1;
+
+    char line[128];
+    long kb = -1;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "MemAvailable: %ld kB", &kb) == 1) break;
+    }
+    fclose(f);
+    return kb < 0 ? -1 : kb / 1024;
+}
+
+static double read_load_per_cpu(void) {
+    FILE *f = fopen("/proc/loadavg", "r");
+    if (!f) return -1.0;
+
+    double load = -1.0;
+    if (fscanf(f, "%lf", &load) != 1) load = -1.0;
+    fclose(f);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return load < 0 ? -1.0 : load / (double)(cpus > 0 ? cpus : 1);
+}
+
+/* returns 0 if another wave may start now, otherwise 1 with the first limit exceeded in reason */
+int check_pressure(const LaunchPolicy *policy, char *reason, size_t reason_size) {
+    long mem = read_mem_available_mb();
+    if (mem >= 0 && mem < policy->min_mem_available_mb) {
+        snprintf(reason, reason_size, "%ld MB available < %d MB",
+            mem, policy->min_mem_available_mb);
+        return 1;
+    }
+
+    static const char *resources[] = { "memory", "io", "cpu" };
+    const double limits[] = {
+        policy->max_memory_pressure, policy->max_io_pressure, policy->max_cpu_pressure
+    };
+
+    int have_psi = 0;
+    for (int i = 0; i < 3; i++) {
+        double avg10 = read_psi(resources[i]);
+        if (avg10 < 0) continue;
+        have_psi = 1;
+        if (avg10 > limits[i]) {
+            snprintf(reason, reason_size, "%s pressure %.1f%% > %.1f%%",
+                resources[i], avg10, limits[i]);
+            return 1;
+        }
+    }
+
+    if (!have_psi) {
+        double load = read_load_per_cpu();
+        if (load > policy->max_load_per_cpu) {
+            snprintf(reason, reason_size, "load %.2f per cpu > %.2f", load, policy->max_load_per_cpu);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* runs in the forked child before exec, failures just leave the default priority */
+void apply_background_priority(const LaunchPolicy *policy) {
+    if (policy->background_nice != 0) {
+        setpriority(PRIO_PROCESS, 0, policy->background_nice);
+    }
+
+#ifdef SYS_ioprio_set
+    if (policy->background_ionice != 0) {
+        int level = policy->background_ionice == IOPRIO_CLASS_BE ? 7 : 0;
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+            (policy->background_ionice << IOPRIO_CLASS_SHIFT) | level);
+    }
+#endif
+}
@@ -0,0 +1,128 @@
+/*
+ * seat.c — finds the X servers running on this host and who each one belongs to
+ * talks to: seat.h, monitor.c (attaches and drops seats), session.h (SessionOwner)
+ * imports: dirent/sys/stat to list X11_SOCKET_DIR, sys/inotify.h to hear about servers
+ * starting and stopping, pwd.h for the owner's home
+ * functions: find_displays(), watch_displays(), drain_display_watch(), get_seat_owner(), open_seat_display()
+ */
+
+#define _GNU_SOURCE
+#include "../include/seat.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <pwd.h>
+#include <unistd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+static int display_number(const char *name) {
+    if (name[0] != 'X' || name[1] < '0' || name[1] > '9') return -1;
+
+    char *end;
+    long n = strtol(name + 1, &end, 10);
+    if (*end != '\0' || n > 65535) return -1;
+    return (int)n;
+}
+
+/* lists every X<n> socket in X11_SOCKET_DIR into a malloc'd array, returns the count or -1 */
+int find_displays(DisplaySocket **out) {
+    *out = NULL;
+
+    DIR *dir = opendir(X11_SOCKET_DIR);
+    if (!dir) return -1;
+
+    DisplaySocket *found = NULL;
+    int count = 0, cap = 0;
+    struct dirent *de;
+
+    while ((de = readdir(dir))) {
+        int number = display_number(de->d_name);
+        if (number < 0) continue;
+
+        struct stat st;
+        if (fstatat(dirfd(dir), de->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISSOCK(st.st_mode)) {
+            continue;
+        }
+
+        if (count == cap) {
+            cap = cap ? cap * 2 : 16;
+            DisplaySocket *grown = realloc(found, (size_t)cap * sizeof(DisplaySocket));
+            if (!grown) break;
+            found = grown;
+        }
+        found[count].number = number;
+        found[count].uid = st.st_uid;
+        count++;
+    }
+    closedir(dir);
+
+    *out = found;
+    return count;
+}
+
+/* returns a nonblocking inotify fd that becomes readable when a server starts or stops, or -1 */
+int watch_displays(void) {
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) return -1;
+
+    if (inotify_add_watch(fd, X11_SOCKET_DIR, IN_CREATE | IN_DELETE | IN_MOVED_TO) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* consumes pending inotify events, returns 1 if any of them was about a display socket */
+int drain_display_watch(int fd) {
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    int relevant = 0;
+    ssize_t n;
+
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            if (ev->len > 0 && display_number(ev->name) >= 0) relevant = 1;
+            p += sizeof(struct inotify_event) + ev->len;
+        }
+    }
+    return relevant;
+}
+
+int get_seat_owner(uid_t uid, SessionOwner *out) {
+    struct passwd pw, *found = NULL;
+    char buf[4096];
+
+    if (getpwuid_r(uid, &pw, buf, sizeof(buf), &found) != 0 || !found || !pw.pw_dir) return -1;
+
+    memset(out, 0, sizeof(*out));
+    snprintf(out->home, sizeof(out->home), "%s", pw.pw_dir);
+    out->uid = pw.pw_uid;
+    out->gid = pw.pw_gid;
+    return 0;
+}
+
+/*
+ * opens name with the owner's X authority. a daemon running as another user (root on
+ * a thin-client host) has no cookie of its own for the seat, so XAUTHORITY is pointed
+ * at the owner's ~/.Xauthority for the duration of the connect.
+ */
+Display *open_seat_display(const char *name, const SessionOwner *owner) {
+    if (!owner || owner->uid == getuid()) return XOpenDisplay(name);
+
+    const char *saved = getenv("XAUTHORITY");
+    char *restore = saved ? strdup(saved) : NULL;
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/.Xauthority", owner->home);
+    setenv("XAUTHORITY", path, 1);
+
+    Display *display = XOpenDisplay(name);
+
+    if (restore) setenv("XAUTHORITY", restore, 1);
+    else unsetenv("XAUTHORITY");
+    free(restore);
+    return display;
+}
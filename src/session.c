@@ -1,31 +1,91 @@
 /*
- * session.c — saves WindowList to JSON and loads it back into a WindowList
- * talks to: capture.h (WindowList struct), vendor/cJSON for serialization
- * imports: cJSON.h, capture.h, stdio, stdlib, string, sys/stat for mkdir
- * functions: save_session(), load_session(), get_session_path(), session_file_exists()
+ * session.c — saves WindowList as a binary .snap file and loads it back, plus JSON export/import
+ * talks to: capture.h (WindowList struct), snapfile.c (binary format), fingerprint.c (skip unchanged writes),
+ *           jsonwriter.c (JSON export), jsonreader.c (JSON import), stats.c (serialize/write/fsync timings),
+ *           history.c (every written session is also appended to the profile's history),
+ *           catalog.c (keeps the profile index current)
+ * imports: capture.h, stdio, stdlib, string, sys/stat for mkdir, sys/mman.h to map JSON files, sys/uio.h
+ * to write a .snap's parts with one writev(),
+ * sys/fsuid.h so a root daemon creates each user's files as that user
+ * functions: save_session(), load_session(), save_session_json(), load_session_json(), get_session_path(),
+ * set_session_owner(), get_session_home()
  */
 
+#define _GNU_SOURCE
+
 #include "../include/session.h"
-#include "../vendor/cJSON.h"
+#include "../include/fingerprint.h"
+#include "../include/snapfile.h"
+#include "../include/jsonwriter.h"
+#include "../include/jsonreader.h"
+#include "../include/stats.h"
+#include "../include/history.h"
+#include "../include/catalog.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/fsuid.h>
 #include <unistd.h>
 
-void get_session_path(char *out, size_t size, const char *profile_name) {
-    const char *home = getenv("HOME");
+/* set per thread, the writer switches owner for every job it saves */
+static __thread const SessionOwner *current_owner = NULL;
+
+/*
+ * points the calling thread's session paths at owner's home, NULL goes back to $HOME.
+ * fsuid/fsgid are per thread on Linux, so when running as root the writer creates and
+ * opens files with the owner's permissions and nothing else in the daemon is affected.
+ */
+void set_session_owner(const SessionOwner *owner) {
+    current_owner = owner;
+    if (geteuid() != 0) return;
+
+    setfsgid(owner ? owner->gid : getegid());
+    setfsuid(owner ? owner->uid : geteuid());
+}
+
+/* the home session files live under for this thread, NULL if there is none */
+const char *get_session_home(void) {
+    if (current_owner) return current_owner->home;
+    return getenv("HOME");
+}
+
+static void build_session_path(char *out, size_t size, const char *profile_name, const char *ext) {
+    const char *home = get_session_home();
     if (!home) home = "/tmp";
 
     if (!profile_name || strcmp(profile_name, "default") == 0) {
-        snprintf(out, size, "%s%s", home, SESSION_FILE);
+        snprintf(out, size, "%s%s%s", home, SESSION_BASE, ext);
     } else {
-        snprintf(out, size, "%s%s/%s.json", home, SESSIONS_DIR, profile_name);
+        snprintf(out, size, "%s%s/%s%s", home, SESSIONS_DIR, profile_name, ext);
     }
 }
 
+void get_session_path(char *out, size_t size, const char *profile_name) {
+    build_session_path(out, size, profile_name, ".snap");
+}
+
+void get_session_json_path(char *out, size_t size, const char *profile_name) {
+    build_session_path(out, size, profile_name, ".json");
+}
+
+/* launch policy lives next to the session it applies to, see scheduler.c */
+void get_session_policy_path(char *out, size_t size, const char *profile_name) {
+    build_session_path(out, size, profile_name, ".policy");
+}
+
+/* profile names become file names, so anything that could leave the sessions dir is refused */
+int valid_profile_name(const char *name) {
+    return name && name[0] && name[0] != '.' && !strchr(name, '/') && strlen(name) < 128;
+}
+
 static void ensure_dirs_exist(void) {
-    const char *home = getenv("HOME");
+    const char *home = get_session_home();
     if (!home) return;
 
     char path[512];
@@ -39,140 +99,254 @@ static void ensure_dirs_exist(void) {
 int session_file_exists(const char *profile_name) {
     char path[512];
     get_session_path(path, sizeof(path), profile_name);
+    if (access(path, F_OK) == 0) return 1;
+
+    get_session_json_path(path, sizeof(path), profile_name);
     return access(path, F_OK) == 0;
 }
 
-int save_session(const WindowList *list, const char *profile_name) {
-    ensure_dirs_exist();
+/* remembers the fingerprint last written to each session path in this process */
+typedef struct LastWrite {
+    char path[512];
+    uint64_t fingerprint;
+    struct LastWrite *next;
+} LastWrite;
 
-    cJSON *root = cJSON_CreateObject();
-    cJSON *windows_arr = cJSON_CreateArray();
+static LastWrite *last_writes = NULL;
+/* updated by the writer thread, read by the daemon's stats export, so every access is __atomic */
+static SessionWriteStats write_stats;
 
-    for (int i = 0; i < list->count; i++) {
-        const WindowInfo *w = &list->windows[i];
-        cJSON *win = cJSON_CreateObject();
-
-        cJSON_AddNumberToObject(win, "pid", w->pid);
-        cJSON_AddStringToObject(win, "title", w->title);
-        cJSON_AddStringToObject(win, "exe_path", w->exe_path);
-        cJSON_AddNumberToObject(win, "x", w->x);
-        cJSON_AddNumberToObject(win, "y", w->y);
-        cJSON_AddNumberToObject(win, "width", w->width);
-        cJSON_AddNumberToObject(win, "height", w->height);
-        cJSON_AddNumberToObject(win, "desktop", w->desktop);
-        cJSON_AddNumberToObject(win, "is_maximized", w->is_maximized);
-        cJSON_AddNumberToObject(win, "is_minimized", w->is_minimized);
-
-        cJSON *cmd_arr = cJSON_CreateArray();
-        for (int j = 0; j < w->cmd_argc; j++) {
-            cJSON_AddItemToArray(cmd_arr, cJSON_CreateString(w->cmd[j]));
-        }
-        cJSON_AddItemToObject(win, "cmd", cmd_arr);
+static LastWrite *last_write_for(const char *path) {
+    for (LastWrite *lw = last_writes; lw; lw = lw->next) {
+        if (strcmp(lw->path, path) == 0) return lw;
+    }
+
+    LastWrite *lw = calloc(1, sizeof(LastWrite));
+    if (!lw) return NULL;
+    snprintf(lw->path, sizeof(lw->path), "%s", path);
+    lw->next = last_writes;
+    last_writes = lw;
+    return lw;
+}
+
+/*
+ * writes parts to path.tmp, fsyncs it and renames it over path so readers never see a partial file.
+ * one writev() on a plain fd, a stdio stream would be allocated for every save the daemon makes
+ */
+static int write_file_atomic(const char *path, const SnapPart *parts, int count) {
+    char tmp_path[520];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    int fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) return -1;
+
+    struct iovec iov[SNAP_PARTS];
+    int n = 0;
+    for (int i = 0; i < count && n < SNAP_PARTS; i++) {
+        if (parts[i].len == 0) continue;
+        iov[n].iov_base = (void *)parts[i].data;
+        iov[n].iov_len = parts[i].len;
+        n++;
+    }
 
-        cJSON_AddItemToArray(windows_arr, win);
+    uint64_t start = stats_now_ns();
+    int ok = 1;
+    for (int i = 0; i < n; ) {
+        ssize_t w = writev(fd, iov + i, n - i);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) {
+            ok = 0;
+            break;
+        }
+        while (i < n && (size_t)w >= iov[i].iov_len) w -= (ssize_t)iov[i++].iov_len;
+        if (i < n) {
+            iov[i].iov_base = (char *)iov[i].iov_base + w;
+            iov[i].iov_len -= (size_t)w;
+        }
     }
 
-    cJSON_AddItemToObject(root, "windows", windows_arr);
-    cJSON_AddNumberToObject(root, "count", list->count);
+    uint64_t written = stats_now_ns();
+    stats_record(STAT_WRITE, written - start);
+
+    ok = fsync(fd) == 0 && ok;
+    ok = close(fd) == 0 && ok;
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    stats_record(STAT_FSYNC, stats_now_ns() - written);
+    return 0;
+}
 
-    char *json_str = cJSON_PrintUnformatted(root);
-    cJSON_Delete(root);
+void get_session_write_stats(SessionWriteStats *out) {
+    out->writes = __atomic_load_n(&write_stats.writes, __ATOMIC_RELAXED);
+    out->skipped = __atomic_load_n(&write_stats.skipped, __ATOMIC_RELAXED);
+    out->bytes_written = __atomic_load_n(&write_stats.bytes_written, __ATOMIC_RELAXED);
+    out->since = __atomic_load_n(&write_stats.since, __ATOMIC_RELAXED);
+    if (out->since == 0) out->since = time(NULL);
+}
 
-    if (!json_str) return -1;
+int save_session(const WindowList *list, const char *profile_name) {
+    time_t unset = 0;
+    __atomic_compare_exchange_n(&write_stats.since, &unset, time(NULL), 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
 
     char path[512];
     get_session_path(path, sizeof(path), profile_name);
 
-    FILE *f = fopen(path, "w");
-    if (!f) {
-        free(json_str);
+    uint64_t start = stats_now_ns();
+    uint64_t fingerprint = session_fingerprint(list);
+    LastWrite *last = last_write_for(path);
+    if (last && last->fingerprint == fingerprint && access(path, F_OK) == 0) {
+        stats_record(STAT_SERIALIZE, stats_now_ns() - start);
+        __atomic_add_fetch(&write_stats.skipped, 1, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    SnapHeader header;
+    SnapPart parts[SNAP_PARTS];
+    build_snapshot_header(list, &header, parts);
+    stats_record(STAT_SERIALIZE, stats_now_ns() - start);
+
+    ensure_dirs_exist();
+    CatalogStamp before;
+    catalog_stamp(profile_name, &before);
+
+    if (write_file_atomic(path, parts, SNAP_PARTS) != 0) {
+        fprintf(stderr, "sessionsnap: failed to write %s\n", path);
         return -1;
     }
 
-    fputs(json_str, f);
-    fclose(f);
-    free(json_str);
+    size_t len = 0;
+    for (int i = 0; i < SNAP_PARTS; i++) len += parts[i].len;
+
+    if (last) last->fingerprint = fingerprint;
+    __atomic_add_fetch(&write_stats.writes, 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&write_stats.bytes_written, len, __ATOMIC_RELAXED);
+
+    /* the session itself is already safe, a history failure is only reported */
+    history_append(list, profile_name, time(NULL));
+    catalog_update(profile_name, list, &before);
 
     printf("sessionsnap: saved %d windows to %s\n", list->count, path);
     return 0;
 }
 
-WindowList *load_session(const char *profile_name) {
-    char path[512];
-    get_session_path(path, sizeof(path), profile_name);
+/* emits the session schema straight into buf, in the order the old cJSON-based writer used plus cwd, job and maps */
+static void encode_session_json(const WindowList *list, JsonBuf *buf) {
+    json_lit(buf, "{\"windows\":[");
 
-    FILE *f = fopen(path, "r");
-    if (!f) {
-        fprintf(stderr, "sessionsnap: cannot open %s\n", path);
-        return NULL;
+    for (int i = 0; i < list->count; i++) {
+        const WindowInfo *w = &list->windows[i];
+        if (i > 0) json_lit(buf, ",");
+
+        json_lit(buf, "{\"pid\":");
+        json_int(buf, w->pid);
+        json_lit(buf, ",\"title\":");
+        json_string(buf, window_title(list, w));
+        json_lit(buf, ",\"exe_path\":");
+        json_string(buf, window_exe_path(list, w));
+        json_lit(buf, ",\"wm_class\":");
+        json_string(buf, window_wm_class(list, w));
+        json_lit(buf, ",\"x\":");
+        json_int(buf, w->x);
+        json_lit(buf, ",\"y\":");
+        json_int(buf, w->y);
+        json_lit(buf, ",\"width\":");
+        json_int(buf, w->width);
+        json_lit(buf, ",\"height\":");
+        json_int(buf, w->height);
+        json_lit(buf, ",\"desktop\":");
+        json_int(buf, w->desktop);
+        json_lit(buf, ",\"is_maximized\":");
+        json_int(buf, w->is_maximized);
+        json_lit(buf, ",\"is_minimized\":");
+        json_int(buf, w->is_minimized);
+
+        json_lit(buf, ",\"cmd\":[");
+        for (int j = 0; j < w->cmd_argc; j++) {
+            if (j > 0) json_lit(buf, ",");
+            json_string(buf, window_arg(list, w, j));
+        }
+        json_lit(buf, "],\"cwd\":");
+        json_string(buf, window_cwd(list, w));
+        json_lit(buf, ",\"job\":[");
+        for (int j = 0; j < w->job_argc; j++) {
+            if (j > 0) json_lit(buf, ",");
+            json_string(buf, window_job_arg(list, w, j));
+        }
+        json_lit(buf, "],\"maps\":[");
+        for (int j = 0; j < w->map_count; j++) {
+            if (j > 0) json_lit(buf, ",");
+            json_string(buf, window_map(list, w, j));
+        }
+        json_lit(buf, "]}");
     }
 
-    fseek(f, 0, SEEK_END);
-    long fsize = ftell(f);
-    rewind(f);
+    json_lit(buf, "],\"count\":");
+    json_int(buf, list->count);
+    json_lit(buf, "}");
+}
 
-    char *buf = malloc(fsize + 1);
-    if (!buf) { fclose(f); return NULL; }
+/* writes list as JSON to path, or to stdout when path is "-" */
+int save_session_json(const WindowList *list, const char *path) {
+    static JsonBuf buf;
 
-    fread(buf, 1, fsize, f);
-    buf[fsize] = '\0';
-    fclose(f);
+    json_reset(&buf);
+    encode_session_json(list, &buf);
+    if (buf.failed) return -1;
 
-    cJSON *root = cJSON_Parse(buf);
-    free(buf);
+    int result;
+    if (strcmp(path, "-") == 0) {
+        result = fwrite(buf.data, 1, buf.len, stdout) == buf.len ? 0 : -1;
+        putchar('\n');
+    } else {
+        SnapPart part = { buf.data, buf.len };
+        result = write_file_atomic(path, &part, 1);
+    }
+
+    if (result != 0) fprintf(stderr, "sessionsnap: failed to write %s\n", path);
+    return result;
+}
 
-    if (!root) {
-        fprintf(stderr, "sessionsnap: failed to parse JSON\n");
+/* maps a JSON session file, as written by --export or by versions before .snap files, and parses it */
+WindowList *load_session_json(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "sessionsnap: cannot open %s\n", path);
         return NULL;
     }
 
-    WindowList *list = calloc(1, sizeof(WindowList));
-    if (!list) { cJSON_Delete(root); return NULL; }
-
-    cJSON *windows_arr = cJSON_GetObjectItem(root, "windows");
-    int count = cJSON_GetArraySize(windows_arr);
-
-    for (int i = 0; i < count && i < MAX_WINDOWS; i++) {
-        cJSON *win = cJSON_GetArrayItem(windows_arr, i);
-        WindowInfo *w = &list->windows[i];
-
-        cJSON *pid = cJSON_GetObjectItem(win, "pid");
-        cJSON *title = cJSON_GetObjectItem(win, "title");
-        cJSON *exe = cJSON_GetObjectItem(win, "exe_path");
-        cJSON *x = cJSON_GetObjectItem(win, "x");
-        cJSON *y = cJSON_GetObjectItem(win, "y");
-        cJSON *width = cJSON_GetObjectItem(win, "width");
-        cJSON *height = cJSON_GetObjectItem(win, "height");
-        cJSON *desktop = cJSON_GetObjectItem(win, "desktop");
-        cJSON *is_max = cJSON_GetObjectItem(win, "is_maximized");
-        cJSON *is_min = cJSON_GetObjectItem(win, "is_minimized");
-        cJSON *cmd_arr = cJSON_GetObjectItem(win, "cmd");
-
-        if (pid) w->pid = (int)pid->valuedouble;
-        if (title) strncpy(w->title, title->valuestring, sizeof(w->title) - 1);
-        if (exe) strncpy(w->exe_path, exe->valuestring, sizeof(w->exe_path) - 1);
-        if (x) w->x = (int)x->valuedouble;
-        if (y) w->y = (int)y->valuedouble;
-        if (width) w->width = (int)width->valuedouble;
-        if (height) w->height = (int)height->valuedouble;
-        if (desktop) w->desktop = (int)desktop->valuedouble;
-        if (is_max) w->is_maximized = (int)is_max->valuedouble;
-        if (is_min) w->is_minimized = (int)is_min->valuedouble;
-
-        if (cmd_arr) {
-            int argc = cJSON_GetArraySize(cmd_arr);
-            for (int j = 0; j < argc && j < MAX_CMD_ARGS; j++) {
-                cJSON *arg = cJSON_GetArrayItem(cmd_arr, j);
-                if (arg && arg->valuestring) {
-                    strncpy(w->cmd[j], arg->valuestring, MAX_ARG_LEN - 1);
-                }
-            }
-            w->cmd_argc = argc;
-        }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        fprintf(stderr, "sessionsnap: %s is empty\n", path);
+        return NULL;
+    }
 
-        list->count++;
+    size_t size = (size_t)st.st_size;
+    void *data = mmap(NULL, size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "sessionsnap: cannot map %s\n", path);
+        return NULL;
     }
 
-    cJSON_Delete(root);
+    WindowList *list = parse_session_json(data, size, path);
+    munmap(data, size);
     return list;
-}
\ No newline at end of file
+}
+
+/*
+ * maps the profile's .snap file and uses it in place; profiles that were only ever
+ * saved as JSON are still read from their .json file
+ */
+WindowList *load_session(const char *profile_name) {
+    char path[512];
+    get_session_path(path, sizeof(path), profile_name);
+
+    if (access(path, F_OK) == 0) return map_snapshot(path);
+
+    get_session_json_path(path, sizeof(path), profile_name);
+    return load_session_json(path);
+}
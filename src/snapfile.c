@@ -0,0 +1,245 @@
+/*
+ * snapfile.c — encodes a WindowList as a .snap file and maps one back without parsing
+ * talks to: snapfile.h, session.c (save_session/load_session), winlist.c (list layout)
+ * imports: sys/mman.h for mmap, fcntl/sys/stat for opening and sizing the file
+ * functions: build_snapshot_header(), map_snapshot(), crc32_update(), validate_snapshot()
+ */
+
+#include "../include/snapfile.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const char zero_pad[8];
+
+/* slicing-by-8 CRC-32 tables, the checksum covers the whole file on every load */
+static uint32_t crc_table[8][256];
+static int crc_ready = 0;
+
+static void init_crc_table(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int t = 1; t < 8; t++) {
+            uint32_t prev = crc_table[t - 1][i];
+            crc_table[t][i] = (prev >> 8) ^ crc_table[0][prev & 0xff];
+        }
+    }
+    crc_ready = 1;
+}
+
+uint32_t crc32_update(uint32_t crc, const void *data, size_t len) {
+    if (!crc_ready) init_crc_table();
+
+    const unsigned char *p = data;
+    crc = ~crc;
+
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = crc_table[7][lo & 0xff] ^ crc_table[6][(lo >> 8) & 0xff] ^
+              crc_table[5][(lo >> 16) & 0xff] ^ crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xff] ^ crc_table[2][(hi >> 8) & 0xff] ^
+              crc_table[1][(hi >> 16) & 0xff] ^ crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = crc_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+static size_t pad8(size_t n) {
+    return (8 - (n & 7)) & 7;
+}
+
+/*
+ * fills header and the list of byte ranges that make up the file; the parts point
+ * into list and stay valid as long as it isn't modified
+ */
+void build_snapshot_header(const WindowList *list, SnapHeader *header, SnapPart parts[SNAP_PARTS]) {
+    memset(header, 0, sizeof(*header));
+    memcpy(header->magic, SNAP_MAGIC, 4);
+    header->version = SNAP_VERSION;
+    header->header_size = sizeof(SnapHeader);
+    header->endian_mark = SNAP_ENDIAN_MARK;
+    header->window_count = (uint32_t)list->count;
+    header->window_stride = sizeof(WindowInfo);
+    header->arg_count = (uint32_t)list->args_len;
+
+    size_t windows_len = (size_t)list->count * sizeof(WindowInfo);
+    size_t args_len = (size_t)list->args_len * sizeof(uint32_t);
+
+    header->windows_offset = sizeof(SnapHeader);
+    header->args_offset = header->windows_offset + windows_len + pad8(windows_len);
+    header->strings_offset = header->args_offset + args_len + pad8(args_len);
+    header->strings_size = list->strings_len;
+
+    parts[0] = (SnapPart){ header, sizeof(SnapHeader) };
+    parts[1] = (SnapPart){ list->windows, windows_len };
+    parts[2] = (SnapPart){ zero_pad, pad8(windows_len) };
+    parts[3] = (SnapPart){ list->args, args_len };
+    parts[4] = (SnapPart){ zero_pad, pad8(args_len) };
+    parts[5] = (SnapPart){ list->strings, list->strings_len };
+    parts[6] = (SnapPart){ zero_pad, pad8(list->strings_len) };
+
+    uint32_t crc = 0;
+    for (int i = 1; i < SNAP_PARTS; i++) {
+        if (parts[i].len) crc = crc32_update(crc, parts[i].data, parts[i].len);
+    }
+    header->checksum = crc;
+}
+
+static int section_fits(uint64_t offset, uint64_t len, size_t file_size) {
+    return offset <= file_size && len <= file_size - offset;
+}
+
+/* checks the header, section bounds, checksum and that every offset stays inside the file */
+static int validate_snapshot(const unsigned char *base, size_t size, const char *path) {
+    const SnapHeader *h = (const SnapHeader *)base;
+
+    if (size < sizeof(SnapHeader) || memcmp(h->magic, SNAP_MAGIC, 4) != 0) {
+        fprintf(stderr, "sessionsnap: %s is not a snapshot file\n", path);
+        return -1;
+    }
+    if (h->endian_mark != SNAP_ENDIAN_MARK || h->version == 0 || h->version > SNAP_VERSION) {
+        fprintf(stderr, "sessionsnap: %s has unsupported version %u\n", path, h->version);
+        return -1;
+    }
+    if (h->window_stride < offsetof(WindowInfo, cmd_argc) + sizeof(int32_t) ||
+        h->window_stride % 8 != 0 ||
+        !section_fits(h->windows_offset, (uint64_t)h->window_count * h->window_stride, size) ||
+        !section_fits(h->args_offset, (uint64_t)h->arg_count * sizeof(uint32_t), size) ||
+        !section_fits(h->strings_offset, h->strings_size, size) ||
+        h->strings_size == 0 || base[h->strings_offset + h->strings_size - 1] != '\0' ||
+        h->windows_offset % 8 != 0 || h->args_offset % 8 != 0) {
+        fprintf(stderr, "sessionsnap: %s is truncated or corrupt\n", path);
+        return -1;
+    }
+
+    uint32_t crc = crc32_update(0, base + sizeof(SnapHeader), size - sizeof(SnapHeader));
+    if (crc != h->checksum) {
+        fprintf(stderr, "sessionsnap: %s failed its checksum\n", path);
+        return -1;
+    }
+
+    const uint32_t *args = (const uint32_t *)(base + h->args_offset);
+    for (uint32_t i = 0; i < h->arg_count; i++) {
+        if (args[i] >= h->strings_size) goto corrupt;
+    }
+
+    for (uint32_t i = 0; i < h->window_count; i++) {
+        const WindowInfo *w = (const WindowInfo *)(base + h->windows_offset +
+            (uint64_t)i * h->window_stride);
+        if (w->title >= h->strings_size || w->exe_path >= h->strings_size) goto corrupt;
+        /* version 1 records end before wm_class */
+        if (h->window_stride >= offsetof(WindowInfo, wm_class) + sizeof(uint32_t) &&
+            w->wm_class >= h->strings_size) goto corrupt;
+        if (w->cmd_argc < 0 || (uint64_t)w->cmd + (uint64_t)w->cmd_argc > h->arg_count) goto corrupt;
+        /* and version 2 ones before the foreground job */
+        if (h->window_stride >= offsetof(WindowInfo, job_argc) + sizeof(int32_t) &&
+            (w->cwd >= h->strings_size || w->job_argc < 0 ||
+             (uint64_t)w->job + (uint64_t)w->job_argc > h->arg_count)) goto corrupt;
+        /* and version 3 ones before the mapped files */
+        if (h->window_stride >= offsetof(WindowInfo, map_count) + sizeof(int32_t) &&
+            (w->map_count < 0 || (uint64_t)w->maps + (uint64_t)w->map_count > h->arg_count)) goto corrupt;
+    }
+    return 0;
+
+corrupt:
+    fprintf(stderr, "sessionsnap: %s has out-of-range references\n", path);
+    return -1;
+}
+
+/* copies an older-layout file into a regular list, fields it predates stay zero */
+static WindowList *upgrade_snapshot(const unsigned char *base) {
+    const SnapHeader *h = (const SnapHeader *)base;
+    WindowList *list = new_window_list();
+    if (!list) return NULL;
+
+    size_t copy_len = h->window_stride < sizeof(WindowInfo) ? h->window_stride : sizeof(WindowInfo);
+
+    list->strings_len = 0;
+    if (store_string(list, (const char *)base + h->strings_offset, h->strings_size - 1) != 0 ||
+        list->strings_len != h->strings_size) {
+        free_window_list(list);
+        return NULL;
+    }
+
+    if (h->arg_count > 0) {
+        list->args = malloc((size_t)h->arg_count * sizeof(uint32_t));
+        if (!list->args) {
+            free_window_list(list);
+            return NULL;
+        }
+        memcpy(list->args, base + h->args_offset, (size_t)h->arg_count * sizeof(uint32_t));
+        list->args_len = list->args_cap = (int)h->arg_count;
+    }
+
+    for (uint32_t i = 0; i < h->window_count; i++) {
+        WindowInfo *w = add_window(list);
+        if (!w) break;
+        memcpy(w, base + h->windows_offset + (uint64_t)i * h->window_stride, copy_len);
+    }
+    return list;
+}
+
+/*
+ * maps a .snap file and returns a read-mostly WindowList that points straight into
+ * the mapping (private, so stray writes never reach the file). returns NULL if the
+ * file is missing or fails validation.
+ */
+WindowList *map_snapshot(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SnapHeader)) {
+        close(fd);
+        fprintf(stderr, "sessionsnap: %s is not a snapshot file\n", path);
+        return NULL;
+    }
+
+    size_t size = (size_t)st.st_size;
+    void *base = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return NULL;
+
+    if (validate_snapshot(base, size, path) != 0) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    const SnapHeader *h = base;
+    if (h->version != SNAP_VERSION || h->window_stride != sizeof(WindowInfo)) {
+        WindowList *upgraded = upgrade_snapshot(base);
+        munmap(base, size);
+        return upgraded;
+    }
+
+    WindowList *list = calloc(1, sizeof(WindowList));
+    if (!list) {
+        munmap(base, size);
+        return NULL;
+    }
+
+    unsigned char *bytes = base;
+    list->windows = (WindowInfo *)(bytes + h->windows_offset);
+    list->count = (int)h->window_count;
+    list->capacity = list->count;
+    list->args = (uint32_t *)(bytes + h->args_offset);
+    list->args_len = list->args_cap = (int)h->arg_count;
+    list->strings = (char *)(bytes + h->strings_offset);
+    list->strings_len = list->strings_cap = h->strings_size;
+    list->mapping = base;
+    list->mapping_size = size;
+    return list;
+}
@@ -0,0 +1,223 @@
+/*
+ * stats.c — per-phase latency histograms and window counters, exported in Prometheus textfile format
+ * talks to: stats.h, capture.c and session.c (record phases), monitor.c (periodic file), main.c (--stats),
+ *           session.c, writer.c, procinfo.c and filter.c (their own counters are folded into the export)
+ * imports: time.h for CLOCK_MONOTONIC, stdio for the export, fopencookie() so every rewrite of the
+ * stats file goes through one long-lived stream
+ * functions: stats_now_ns(), stats_record(), stats_count(), write_stats_text(), write_stats_file(), bucket_for()
+ *
+ * every slot is updated with relaxed atomic adds, capture runs on the main thread and
+ * saves on the writer thread, and an export only needs each number to be whole, not
+ * a consistent cut across all of them.
+ */
+
+#define _GNU_SOURCE
+
+#include "../include/stats.h"
+#include "../include/session.h"
+#include "../include/writer.h"
+#include "../include/procinfo.h"
+#include "../include/filter.h"
+#include <stdlib.h>
+#include <stdio_ext.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/* upper bounds in ns, from 100 µs (a warm capture of a few windows) to 5 s (fsync on a stalled disk) */
+static const uint64_t bucket_bounds[] = {
+    100000ULL, 250000ULL, 500000ULL,
+    1000000ULL, 2500000ULL, 5000000ULL,
+    10000000ULL, 25000000ULL, 50000000ULL,
+    100000000ULL, 250000000ULL, 500000000ULL,
+    1000000000ULL, 2500000000ULL, 5000000000ULL
+};
+#define STAT_BUCKETS (sizeof(bucket_bounds) / sizeof(bucket_bounds[0]))
+
+typedef struct {
+    uint64_t buckets[STAT_BUCKETS + 1];     /* the last one is +Inf */
+    uint64_t sum_ns;
+} Histogram;
+
+static const char *phase_names[STAT_PHASES] = {
+    "x_query", "proc", "serialize", "write", "fsync", "snapshot"
+};
+
+static const char *counter_names[STAT_COUNTERS] = {
+    "captured", "no_pid", "no_cmdline", "system_process"
+};
+
+static Histogram histograms[STAT_PHASES];
+static unsigned long counters[STAT_COUNTERS];
+static char stats_path[512];
+
+uint64_t stats_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t bucket_for(uint64_t ns) {
+    size_t i = 0;
+    while (i < STAT_BUCKETS && ns > bucket_bounds[i]) i++;
+    return i;
+}
+
+void stats_record(StatPhase phase, uint64_t ns) {
+    Histogram *h = &histograms[phase];
+    __atomic_add_fetch(&h->buckets[bucket_for(ns)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&h->sum_ns, ns, __ATOMIC_RELAXED);
+}
+
+void stats_count(StatCounter counter, unsigned long n) {
+    if (n) __atomic_add_fetch(&counters[counter], n, __ATOMIC_RELAXED);
+}
+
+void set_stats_path(const char *path) {
+    snprintf(stats_path, sizeof(stats_path), "%s", path);
+}
+
+const char *get_stats_path(void) {
+    if (!stats_path[0]) {
+        const char *home = getenv("HOME");
+        char dir[512];
+        snprintf(dir, sizeof(dir), "%s%s", home ? home : "/tmp", SESSION_DIR);
+        mkdir(dir, 0755);
+        snprintf(stats_path, sizeof(stats_path), "%s%s", home ? home : "/tmp", STATS_FILE);
+    }
+    return stats_path;
+}
+
+static uint64_t load(const uint64_t *slot) {
+    return __atomic_load_n(slot, __ATOMIC_RELAXED);
+}
+
+static void write_counter(FILE *out, const char *name, const char *help, unsigned long long value) {
+    fprintf(out, "# HELP sessionsnap_%s %s\n# TYPE sessionsnap_%s counter\nsessionsnap_%s %llu\n",
+        name, help, name, name, value);
+}
+
+static void write_gauge(FILE *out, const char *name, const char *help, double value) {
+    fprintf(out, "# HELP sessionsnap_%s %s\n# TYPE sessionsnap_%s gauge\nsessionsnap_%s %.17g\n",
+        name, help, name, name, value);
+}
+
+static void write_histograms(FILE *out) {
+    fprintf(out, "# HELP sessionsnap_phase_duration_seconds Time spent in each capture and save phase.\n");
+    fprintf(out, "# TYPE sessionsnap_phase_duration_seconds histogram\n");
+
+    for (int p = 0; p < STAT_PHASES; p++) {
+        const Histogram *h = &histograms[p];
+        uint64_t cumulative = 0;
+
+        for (size_t b = 0; b < STAT_BUCKETS; b++) {
+            cumulative += load(&h->buckets[b]);
+            fprintf(out, "sessionsnap_phase_duration_seconds_bucket{phase=\"%s\",le=\"%g\"} %llu\n",
+                phase_names[p], (double)bucket_bounds[b] / 1e9, (unsigned long long)cumulative);
+        }
+        cumulative += load(&h->buckets[STAT_BUCKETS]);
+        fprintf(out, "sessionsnap_phase_duration_seconds_bucket{phase=\"%s\",le=\"+Inf\"} %llu\n",
+            phase_names[p], (unsigned long long)cumulative);
+        fprintf(out, "sessionsnap_phase_duration_seconds_sum{phase=\"%s\"} %.9f\n",
+            phase_names[p], (double)load(&h->sum_ns) / 1e9);
+        fprintf(out, "sessionsnap_phase_duration_seconds_count{phase=\"%s\"} %llu\n",
+            phase_names[p], (unsigned long long)cumulative);
+    }
+}
+
+/* everything this process knows, in the Prometheus text exposition format */
+void write_stats_text(FILE *out) {
+    write_histograms(out);
+
+    fprintf(out, "# HELP sessionsnap_windows_total Client windows seen by capture, by outcome.\n");
+    fprintf(out, "# TYPE sessionsnap_windows_total counter\n");
+    for (int c = 0; c < STAT_COUNTERS; c++) {
+        fprintf(out, "sessionsnap_windows_total{result=\"%s\"} %lu\n",
+            counter_names[c], __atomic_load_n(&counters[c], __ATOMIC_RELAXED));
+    }
+
+    SessionWriteStats ss;
+    get_session_write_stats(&ss);
+    write_counter(out, "session_writes_total", "Session files rewritten.", ss.writes);
+    write_counter(out, "session_unchanged_total", "Saves skipped because the fingerprint was unchanged.",
+        ss.skipped);
+    write_counter(out, "session_written_bytes_total", "Bytes written to session files.", ss.bytes_written);
+
+    WriterStats ws;
+    get_writer_stats(&ws);
+    write_counter(out, "writer_published_total", "Snapshots handed to the writer thread.", ws.published);
+    write_counter(out, "writer_coalesced_total", "Snapshots replaced before they were written.", ws.coalesced);
+    write_counter(out, "writer_failed_total", "Writer saves that returned an error.", ws.failed);
+    write_gauge(out, "writer_queue_depth", "Snapshots waiting for the writer.", ws.queue_depth);
+
+    ProcCacheStats ps;
+    get_proc_cache_stats(&ps);
+    write_counter(out, "proc_cache_hits_total", "/proc cache lookups served from memory.", ps.hits);
+    write_counter(out, "proc_cache_misses_total", "/proc cache lookups that read /proc.", ps.misses);
+    write_counter(out, "proc_cache_evictions_total", "/proc cache entries dropped for exited processes.",
+        ps.evictions);
+    write_counter(out, "proc_tree_scans_total", "Full /proc scans made to find terminals' foreground processes.",
+        ps.tree_scans);
+    write_gauge(out, "proc_cache_entries", "Processes currently cached.", ps.entries);
+
+    write_filter_stats(out);
+
+    write_gauge(out, "last_update_timestamp_seconds", "When these stats were written.", (double)time(NULL));
+}
+
+/* the fd the stats stream currently writes to */
+static int stats_fd = -1;
+
+static ssize_t write_stats_fd(void *cookie, const char *buf, size_t size) {
+    (void)cookie;
+    size_t done = 0;
+    while (done < size) {
+        ssize_t n = write(stats_fd, buf + done, size - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return done ? (ssize_t)done : -1;
+        done += (size_t)n;
+    }
+    return (ssize_t)done;
+}
+
+/*
+ * a stream that is never closed, pointed at a fresh fd for each rewrite. fopen() would
+ * allocate a FILE and its buffer every STATS_WRITE_INTERVAL_MS for as long as the daemon runs
+ */
+static FILE *stats_stream(void) {
+    static FILE *stream = NULL;
+    if (!stream) {
+        cookie_io_functions_t io = { .write = write_stats_fd };
+        stream = fopencookie(NULL, "w", io);
+    }
+    return stream;
+}
+
+/* writes to path.tmp and renames it over path, so a scraper never reads half a file */
+int write_stats_file(const char *path) {
+    char tmp_path[520];
+    snprintf(tmp_path, sizeof(tmp_path), "%s.tmp", path);
+
+    FILE *f = stats_stream();
+    if (!f) return -1;
+
+    stats_fd = open(tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (stats_fd < 0) return -1;
+
+    clearerr(f);
+    write_stats_text(f);
+    int ok = fflush(f) == 0 && !ferror(f);
+    /* whatever a failed flush left behind must not end up in the next file */
+    if (!ok) __fpurge(f);
+    ok = close(stats_fd) == 0 && ok;
+    stats_fd = -1;
+
+    if (!ok || rename(tmp_path, path) != 0) {
+        unlink(tmp_path);
+        return -1;
+    }
+    return 0;
+}
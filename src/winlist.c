@@ -0,0 +1,274 @@
+/*
+ * winlist.c — growable window array plus string arena used for every snapshot
+ * talks to: winlist.h, capture.c (fills lists), session.c (loads lists), monitor.c (keeps a model)
+ * imports: stdlib/string, sys/mman.h to release lists mapped from a .snap file
+ * functions: new_window_list(), add_window(), copy_window(), store_string(), add_window_arg(), add_window_map(),
+ * intern_path(), windows_equal()
+ */
+
+#include "../include/winlist.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+static int grow(void **buf, size_t *cap, size_t need, size_t elem, size_t initial) {
+    if (need <= *cap) return 0;
+
+    size_t n = *cap ? *cap : initial;
+    while (n < need) n *= 2;
+
+    void *grown = realloc(*buf, n * elem);
+    if (!grown) return -1;
+    *buf = grown;
+    *cap = n;
+    return 0;
+}
+
+WindowList *new_window_list(void) {
+    WindowList *list = calloc(1, sizeof(WindowList));
+    if (!list) return NULL;
+
+    clear_window_list(list);
+    if (!list->strings) {
+        free(list);
+        return NULL;
+    }
+    return list;
+}
+
+/* forgets all windows and strings but keeps the allocations for reuse */
+void clear_window_list(WindowList *list) {
+    list->count = 0;
+    list->args_len = 0;
+    list->strings_len = 0;
+    if (list->paths) memset(list->paths, 0, list->paths_cap * sizeof(uint32_t));
+    list->paths_count = 0;
+    store_string(list, "", 0);
+}
+
+void free_window_list(WindowList *list) {
+    if (!list) return;
+    if (list->mapping) {
+        munmap(list->mapping, list->mapping_size);
+        free(list);
+        return;
+    }
+    free(list->windows);
+    free(list->strings);
+    free(list->args);
+    free(list->paths);
+    free(list);
+}
+
+WindowInfo *add_window(WindowList *list) {
+    size_t cap = (size_t)list->capacity;
+    if (grow((void **)&list->windows, &cap, (size_t)list->count + 1, sizeof(WindowInfo), 16) != 0) {
+        return NULL;
+    }
+    list->capacity = (int)cap;
+
+    WindowInfo *w = &list->windows[list->count++];
+    memset(w, 0, sizeof(*w));
+    w->cmd = (uint32_t)list->args_len;
+    w->job = (uint32_t)list->args_len;
+    w->maps = (uint32_t)list->args_len;
+    return w;
+}
+
+/* appends a copy of s to the arena and returns its offset, 0 ("") if out of memory */
+uint32_t store_string(WindowList *list, const char *s, size_t len) {
+    if (len == 0 && list->strings_len > 0) return 0;
+
+    if (grow((void **)&list->strings, &list->strings_cap,
+        list->strings_len + len + 1, 1, 4096) != 0) {
+        return 0;
+    }
+
+    uint32_t off = (uint32_t)list->strings_len;
+    memcpy(list->strings + off, s, len);
+    list->strings[off + len] = '\0';
+    list->strings_len += len + 1;
+    return off;
+}
+
+/* makes room for bytes more of string data up front, so a known-size load never reallocs */
+int reserve_strings(WindowList *list, size_t bytes) {
+    return grow((void **)&list->strings, &list->strings_cap, list->strings_len + bytes, 1, 4096);
+}
+
+static int append_offset(WindowList *list, uint32_t *first, int32_t *argc, uint32_t off) {
+    size_t cap = (size_t)list->args_cap;
+    if (grow((void **)&list->args, &cap, (size_t)list->args_len + 1, sizeof(uint32_t), 64) != 0) {
+        return -1;
+    }
+    list->args_cap = (int)cap;
+
+    if (*argc == 0) *first = (uint32_t)list->args_len;
+    list->args[list->args_len++] = off;
+    (*argc)++;
+    return 0;
+}
+
+static int append_arg(WindowList *list, uint32_t *first, int32_t *argc, const char *s, size_t len) {
+    return append_offset(list, first, argc, store_string(list, s, len));
+}
+
+static size_t path_slot(const char *s, size_t len, size_t cap) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h & (cap - 1);
+}
+
+/* returns the arena offset of path, storing it only if no earlier window mapped it too */
+static uint32_t intern_path(WindowList *list, const char *s, size_t len) {
+    if (list->paths_count * 2 >= list->paths_cap) {
+        size_t cap = list->paths_cap ? list->paths_cap * 2 : 256;
+        uint32_t *grown = calloc(cap, sizeof(uint32_t));
+        if (!grown) return store_string(list, s, len);
+
+        for (size_t i = 0; i < list->paths_cap; i++) {
+            uint32_t off = list->paths[i];
+            if (off == 0) continue;
+            const char *p = list->strings + off;
+            size_t slot = path_slot(p, strlen(p), cap);
+            while (grown[slot]) slot = (slot + 1) & (cap - 1);
+            grown[slot] = off;
+        }
+        free(list->paths);
+        list->paths = grown;
+        list->paths_cap = cap;
+    }
+
+    size_t slot = path_slot(s, len, list->paths_cap);
+    for (; list->paths[slot]; slot = (slot + 1) & (list->paths_cap - 1)) {
+        const char *p = list->strings + list->paths[slot];
+        if (strncmp(p, s, len) == 0 && p[len] == '\0') return list->paths[slot];
+    }
+
+    uint32_t off = store_string(list, s, len);
+    if (off != 0) {
+        list->paths[slot] = off;
+        list->paths_count++;
+    }
+    return off;
+}
+
+/* arguments must be added to the most recently added window, in order */
+int add_window_arg(WindowList *list, WindowInfo *w, const char *s, size_t len) {
+    return append_arg(list, &w->cmd, &w->cmd_argc, s, len);
+}
+
+/* same for the foreground job's argv, the two runs can't be interleaved */
+int add_window_job_arg(WindowList *list, WindowInfo *w, const char *s, size_t len) {
+    return append_arg(list, &w->job, &w->job_argc, s, len);
+}
+
+/* and for its mapped files, which go last */
+int add_window_map(WindowList *list, WindowInfo *w, const char *path, size_t len) {
+    if (len == 0) return 0;
+    uint32_t off = intern_path(list, path, len);
+    if (off == 0) return -1;
+    return append_offset(list, &w->maps, &w->map_count, off);
+}
+
+WindowInfo *copy_window(WindowList *dst, const WindowList *src, const WindowInfo *w) {
+    WindowInfo *copy = add_window(dst);
+    if (!copy) return NULL;
+
+    *copy = *w;
+    copy->cmd_argc = 0;
+    copy->cmd = (uint32_t)dst->args_len;
+    copy->job_argc = 0;
+    copy->job = (uint32_t)dst->args_len;
+    copy->map_count = 0;
+    copy->maps = (uint32_t)dst->args_len;
+
+    const char *title = window_title(src, w);
+    const char *exe = window_exe_path(src, w);
+    const char *wm_class = window_wm_class(src, w);
+    const char *cwd = window_cwd(src, w);
+    copy->title = store_string(dst, title, strlen(title));
+    copy->exe_path = store_string(dst, exe, strlen(exe));
+    copy->wm_class = store_string(dst, wm_class, strlen(wm_class));
+    copy->cwd = store_string(dst, cwd, strlen(cwd));
+
+    for (int i = 0; i < w->cmd_argc; i++) {
+        const char *arg = window_arg(src, w, i);
+        if (add_window_arg(dst, copy, arg, strlen(arg)) != 0) {
+            dst->count--;
+            return NULL;
+        }
+    }
+    for (int i = 0; i < w->job_argc; i++) {
+        const char *arg = window_job_arg(src, w, i);
+        if (add_window_job_arg(dst, copy, arg, strlen(arg)) != 0) {
+            dst->count--;
+            return NULL;
+        }
+    }
+    for (int i = 0; i < w->map_count; i++) {
+        const char *path = window_map(src, w, i);
+        if (add_window_map(dst, copy, path, strlen(path)) != 0) {
+            dst->count--;
+            return NULL;
+        }
+    }
+    return copy;
+}
+
+const char *window_title(const WindowList *list, const WindowInfo *w) {
+    return list->strings + w->title;
+}
+
+const char *window_exe_path(const WindowList *list, const WindowInfo *w) {
+    return list->strings + w->exe_path;
+}
+
+const char *window_wm_class(const WindowList *list, const WindowInfo *w) {
+    return list->strings + w->wm_class;
+}
+
+const char *window_cwd(const WindowList *list, const WindowInfo *w) {
+    return list->strings + w->cwd;
+}
+
+const char *window_arg(const WindowList *list, const WindowInfo *w, int i) {
+    if (i < 0 || i >= w->cmd_argc) return "";
+    return list->strings + list->args[w->cmd + (uint32_t)i];
+}
+
+const char *window_job_arg(const WindowList *list, const WindowInfo *w, int i) {
+    if (i < 0 || i >= w->job_argc) return "";
+    return list->strings + list->args[w->job + (uint32_t)i];
+}
+
+const char *window_map(const WindowList *list, const WindowInfo *w, int i) {
+    if (i < 0 || i >= w->map_count) return "";
+    return list->strings + list->args[w->maps + (uint32_t)i];
+}
+
+/*
+ * compares two windows field by field, following string offsets into each list's arena.
+ * mapped files are left out: a process loading a plugin is not a change worth a save
+ */
+int windows_equal(const WindowList *a_list, const WindowInfo *a,
+    const WindowList *b_list, const WindowInfo *b) {
+    if (a->window_id != b->window_id || a->pid != b->pid) return 0;
+    if (a->x != b->x || a->y != b->y) return 0;
+    if (a->width != b->width || a->height != b->height) return 0;
+    if (a->desktop != b->desktop) return 0;
+    if (a->is_maximized != b->is_maximized || a->is_minimized != b->is_minimized) return 0;
+    if (a->cmd_argc != b->cmd_argc || a->job_argc != b->job_argc) return 0;
+
+    if (strcmp(window_title(a_list, a), window_title(b_list, b)) != 0) return 0;
+    if (strcmp(window_cwd(a_list, a), window_cwd(b_list, b)) != 0) return 0;
+    if (strcmp(window_exe_path(a_list, a), window_exe_path(b_list, b)) != 0) return 0;
+    if (strcmp(window_wm_class(a_list, a), window_wm_class(b_list, b)) != 0) return 0;
+    for (int i = 0; i < a->cmd_argc; i++) {
+        if (strcmp(window_arg(a_list, a, i), window_arg(b_list, b, i)) != 0) return 0;
+    }
+    for (int i = 0; i < a->job_argc; i++) {
+        if (strcmp(window_job_arg(a_list, a, i), window_job_arg(b_list, b, i)) != 0) return 0;
+    }
+    return 1;
+}
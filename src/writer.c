@@ -0,0 +1,214 @@
+/*
+ * writer.c — single consumer thread that serializes and writes snapshots off the capture path
+ * talks to: writer.h, session.c (save_session), monitor.c (publishes snapshots)
+ * imports: pthread for the thread, mutex and condition variable
+ * functions: writer_start(), writer_acquire(), writer_publish(), writer_wait_idle(), writer_stop(), writer_main()
+ *
+ * pending snapshots are kept one per profile and owner: publishing a newer snapshot
+ * for a profile that is still waiting replaces it, so a slow disk only ever costs the
+ * latest state. written lists are cleared and handed back through writer_acquire(),
+ * and finished jobs are kept for the next publish, so once the daemon has published
+ * a couple of snapshots it doesn't allocate per snapshot at all.
+ */
+
+#include "../include/writer.h"
+#include "../include/session.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct Pending {
+    char profile[128];
+    SessionOwner owner;
+    int has_owner;          /* else the snapshot goes to our own $HOME */
+    WindowList *snapshot;
+    struct Pending *next;
+} Pending;
+
+static pthread_t thread;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t wake = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t idle = PTHREAD_COND_INITIALIZER;
+
+static Pending *queue = NULL;
+static Pending *spare_jobs = NULL;
+static WindowList *recycled[WRITER_SPARE_LISTS];
+static int recycled_count = 0;
+static int started = 0;
+static int stopping = 0;
+static int busy = 0;
+static WriterStats stats;
+
+static double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1000.0 + (double)ts.tv_nsec / 1e6;
+}
+
+/* keeps a few spare lists for writer_acquire(), caller holds the lock */
+static void recycle(WindowList *list) {
+    if (recycled_count < WRITER_SPARE_LISTS) {
+        clear_window_list(list);
+        recycled[recycled_count++] = list;
+    } else {
+        free_window_list(list);
+    }
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+
+    pthread_mutex_lock(&lock);
+    for (;;) {
+        while (!queue && !stopping) pthread_cond_wait(&wake, &lock);
+        if (!queue) break;
+
+        Pending *job = queue;
+        queue = job->next;
+        stats.queue_depth--;
+        busy = 1;
+        pthread_mutex_unlock(&lock);
+
+        double start = now_ms();
+        set_session_owner(job->has_owner ? &job->owner : NULL);
+        int result = save_session(job->snapshot, job->profile);
+        set_session_owner(NULL);
+        double elapsed = now_ms() - start;
+
+        if (elapsed >= WRITER_SLOW_WRITE_MS) {
+            fprintf(stderr, "sessionsnap: slow write for profile '%s' took %.0f ms\n",
+                job->profile, elapsed);
+        }
+
+        pthread_mutex_lock(&lock);
+        stats.saved++;
+        if (result != 0) stats.failed++;
+        stats.last_write_ms = elapsed;
+        stats.total_write_ms += elapsed;
+        if (elapsed > stats.max_write_ms) stats.max_write_ms = elapsed;
+        recycle(job->snapshot);
+        job->next = spare_jobs;
+        spare_jobs = job;
+        busy = 0;
+        if (!queue) pthread_cond_broadcast(&idle);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+int writer_start(void) {
+    if (started) return 0;
+
+    stopping = 0;
+    if (pthread_create(&thread, NULL, writer_main, NULL) != 0) {
+        fprintf(stderr, "sessionsnap: cannot start writer thread\n");
+        return -1;
+    }
+    started = 1;
+    return 0;
+}
+
+/* returns an empty list to fill and publish, reusing one the writer is done with */
+WindowList *writer_acquire(void) {
+    pthread_mutex_lock(&lock);
+    WindowList *list = recycled_count > 0 ? recycled[--recycled_count] : NULL;
+    pthread_mutex_unlock(&lock);
+
+    return list ? list : new_window_list();
+}
+
+static int same_owner(const Pending *job, const SessionOwner *owner) {
+    if (!owner) return !job->has_owner;
+    return job->has_owner && strcmp(job->owner.home, owner->home) == 0;
+}
+
+/* hands snapshot over to the writer, which owns it from here on; owner NULL means our own $HOME */
+void writer_publish(WindowList *snapshot, const char *profile_name, const SessionOwner *owner) {
+    if (!profile_name) profile_name = "default";
+
+    if (!started) {
+        set_session_owner(owner);
+        save_session(snapshot, profile_name);
+        set_session_owner(NULL);
+        free_window_list(snapshot);
+        return;
+    }
+
+    pthread_mutex_lock(&lock);
+    stats.published++;
+
+    /* a newer snapshot of the same file replaces the queued one, seats of one home save to different profiles */
+    Pending **tail = &queue;
+    for (; *tail; tail = &(*tail)->next) {
+        if (strcmp((*tail)->profile, profile_name) == 0 && same_owner(*tail, owner)) {
+            recycle((*tail)->snapshot);
+            (*tail)->snapshot = snapshot;
+            stats.coalesced++;
+            pthread_mutex_unlock(&lock);
+            return;
+        }
+    }
+
+    Pending *job = spare_jobs;
+    if (job) {
+        spare_jobs = job->next;
+        memset(job, 0, sizeof(*job));
+    } else {
+        job = calloc(1, sizeof(Pending));
+    }
+    if (!job) {
+        free_window_list(snapshot);
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    snprintf(job->profile, sizeof(job->profile), "%s", profile_name);
+    if (owner) {
+        job->owner = *owner;
+        job->has_owner = 1;
+    }
+    job->snapshot = snapshot;
+    *tail = job;
+
+    stats.queue_depth++;
+    if (stats.queue_depth > stats.max_queue_depth) stats.max_queue_depth = stats.queue_depth;
+
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+}
+
+/* blocks until every published snapshot has been written, for callers that promise a saved file */
+void writer_wait_idle(void) {
+    if (!started) return;
+
+    pthread_mutex_lock(&lock);
+    while (queue || busy) pthread_cond_wait(&idle, &lock);
+    pthread_mutex_unlock(&lock);
+}
+
+/* writes whatever is still queued, then joins the thread */
+void writer_stop(void) {
+    if (!started) return;
+
+    pthread_mutex_lock(&lock);
+    stopping = 1;
+    pthread_cond_signal(&wake);
+    pthread_mutex_unlock(&lock);
+
+    pthread_join(thread, NULL);
+    started = 0;
+
+    while (recycled_count > 0) free_window_list(recycled[--recycled_count]);
+    while (spare_jobs) {
+        Pending *job = spare_jobs;
+        spare_jobs = job->next;
+        free(job);
+    }
+}
+
+void get_writer_stats(WriterStats *out) {
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}